@@ -0,0 +1,126 @@
+#ifndef LRU_MEMORY_BASELINES__H
+#define LRU_MEMORY_BASELINES__H
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <list>
+#include <memory_resource>
+#include <type_traits>
+#include <unordered_map>
+
+#include "lrumemorymanager.h"
+
+// The caches we would use instead of LRUMemoryManager, behind the same access()
+// interface as the workload adapters. Both charge every buffer the footprint of
+// a manager hunk against the same byte budget, so their hit ratios differ from
+// the manager's only by fragmentation.
+
+namespace baselines {
+
+/**
+ * @brief std::list + std::unordered_map LRU over malloc/free, or over a pmr pool resource
+ */
+template<bool IsPmr>
+class ListLRUCache {
+public:
+    ListLRUCache(size_t budget, uint32_t key_count)
+        : budget_(budget)
+        , used_(0)
+        , pool_()
+        , lru_(make_allocator<Entry>())
+        , index_(key_count, std::hash<uint32_t>(), std::equal_to<uint32_t>(), make_allocator<typename Index::value_type>())
+    {}
+
+    ~ListLRUCache()
+    {
+        while (!lru_.empty()) {
+            evict();
+        }
+    }
+
+    ListLRUCache(const ListLRUCache&) = delete;
+    ListLRUCache& operator=(const ListLRUCache&) = delete;
+
+    bool access(uint32_t key, uint32_t size)
+    {
+        auto index_itr = index_.find(key);
+        if (index_itr != index_.end()) {
+            lru_.splice(lru_.begin(), lru_, index_itr->second);
+            benchmark::DoNotOptimize(index_itr->second->data_ptr);
+            return true;
+        }
+
+        size_t footprint = lrumm::LRUMemoryManager::get_hunk_footprint(size);
+        if (footprint > budget_) {
+            return false;
+        }
+        while (used_ + footprint > budget_) {
+            evict();
+        }
+
+        void* data_ptr = allocate(size);
+        benchmark::DoNotOptimize(data_ptr);
+        lru_.push_front({ key, size, data_ptr });
+        index_.emplace(key, lru_.begin());
+        used_ += footprint;
+        return false;
+    }
+
+private:
+    struct Entry {
+        uint32_t key;
+        uint32_t size;
+        void* data_ptr;
+    };
+
+    using List = std::conditional_t<IsPmr, std::pmr::list<Entry>, std::list<Entry>>;
+    using Index = std::conditional_t<IsPmr,
+        std::pmr::unordered_map<uint32_t, typename List::iterator>,
+        std::unordered_map<uint32_t, typename List::iterator>>;
+
+    template<typename T>
+    auto make_allocator()
+    {
+        if constexpr (IsPmr) {
+            return std::pmr::polymorphic_allocator<T>(&pool_);
+        } else {
+            return std::allocator<T>();
+        }
+    }
+
+    void* allocate(size_t size)
+    {
+        if constexpr (IsPmr) {
+            return pool_.allocate(size, 16);
+        } else {
+            return std::malloc(size);
+        }
+    }
+
+    void evict()
+    {
+        const Entry& entry = lru_.back();
+        if constexpr (IsPmr) {
+            pool_.deallocate(entry.data_ptr, entry.size, 16);
+        } else {
+            std::free(entry.data_ptr);
+        }
+        used_ -= lrumm::LRUMemoryManager::get_hunk_footprint(entry.size);
+        index_.erase(entry.key);
+        lru_.pop_back();
+    }
+
+    size_t budget_;
+    size_t used_;
+    std::pmr::unsynchronized_pool_resource pool_; ///< Used by the pmr variant only
+    List lru_;
+    Index index_;
+};
+
+using MallocLRUCache = ListLRUCache<false>;
+using PmrLRUCache = ListLRUCache<true>;
+
+}
+#endif // LRU_MEMORY_BASELINES__H
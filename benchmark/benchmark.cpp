@@ -1,20 +1,29 @@
 #include <benchmark/benchmark.h>
 
 #include "lrumemorymanager.h"
+#include "baselines.h"
+#include "perfcounters.h"
+#include "workloads.h"
+#include <algorithm>
 #include <vector>
 #include <random>
 
+#include <unistd.h>
+
 // Benchmark for allocating memory using 'alloc'
 static void BM_LRUAllocAllocation(benchmark::State& state) {
     lrumm::LRUMemoryManager manager(16 * 1024 * 1024);
     lrumm::LRUMemoryManager::LRUMemoryHandle handle;
 
     size_t size = state.range(0); // Get size from benchmark argument
+    perfcounters::PerfCounters perf_counters;
+    perf_counters.start();
     for ([[maybe_unused]] auto _ : state) {
         void* data = manager.alloc(&handle, size);
         benchmark::DoNotOptimize(data); // Prevent compiler from optimizing out allocation
         manager.free(&handle); // Deallocate memory
     }
+    perf_counters.stop(state);
     state.SetBytesProcessed(int64_t(state.iterations()) * size);
     state.SetLabel("alloc");
 
@@ -38,6 +47,8 @@ static void BM_LRUGetBufferAndRefresh(benchmark::State& state) {
     }
 
     size_t index = 0;
+    perfcounters::PerfCounters perf_counters;
+    perf_counters.start();
     for ([[maybe_unused]] auto _ : state) {
         // Access and refresh a buffer (moves it to front of LRU list)
         void* data = manager.get_buffer_and_refresh(&handles[index]);
@@ -45,6 +56,7 @@ static void BM_LRUGetBufferAndRefresh(benchmark::State& state) {
 
         index = (index + 1) % num_handles;
     }
+    perf_counters.stop(state);
 
     // Clean up
     for (size_t i = 0; i < num_handles; ++i) {
@@ -74,6 +86,8 @@ static void BM_LRUFree(benchmark::State& state) {
     }
 
     size_t index = 0;
+    perfcounters::PerfCounters perf_counters;
+    perf_counters.start();
     for ([[maybe_unused]] auto _ : state) {
         // Free a buffer
         manager.free(&handles[index]);
@@ -85,6 +99,7 @@ static void BM_LRUFree(benchmark::State& state) {
 
         index = (index + 1) % num_handles;
     }
+    perf_counters.stop(state);
 
     // Clean up
     for (size_t i = 0; i < num_handles; ++i) {
@@ -113,18 +128,26 @@ static void BM_LRUMixedWorkload(benchmark::State& state) {
         benchmark::DoNotOptimize(pointers[i]);
     }
 
-    // Random number generator for mixed workload
-    std::random_device rd;
-    std::mt19937 gen(rd());
+    // Precompute the random choices so the timed loop does not measure the generator
+    constexpr size_t kStreamLength = 1 << 16;
+    std::mt19937 gen(42);
     std::uniform_int_distribution<> dis(0, num_handles - 1);
+    std::vector<std::pair<int, size_t>> stream(kStreamLength);
+    for (auto& step : stream) {
+        step.first = dis(gen) % 2;
+        step.second = dis(gen);
+    }
 
     size_t alloc_count = 0;
     size_t free_count = 0;
+    size_t step_index = 0;
 
+    perfcounters::PerfCounters perf_counters;
+    perf_counters.start();
     for ([[maybe_unused]] auto _ : state) {
         // Randomly choose to allocate or free
-        int choice = dis(gen) % 2;
-        size_t index = dis(gen);
+        auto [choice, index] = stream[step_index];
+        step_index = (step_index + 1) % kStreamLength;
 
         if (choice == 0 && pointers[index] != nullptr) {
             // Free an existing allocation
@@ -143,6 +166,7 @@ static void BM_LRUMixedWorkload(benchmark::State& state) {
             benchmark::DoNotOptimize(data);
         }
     }
+    perf_counters.stop(state);
 
     // Clean up
     for (size_t i = 0; i < num_handles; ++i) {
@@ -172,6 +196,8 @@ static void BM_LRUEviction(benchmark::State& state) {
 
     size_t evicted_count = 0;
 
+    perfcounters::PerfCounters perf_counters;
+    perf_counters.start();
     for ([[maybe_unused]] auto _ : state) {
 
         // Allocate all memory
@@ -187,6 +213,7 @@ static void BM_LRUEviction(benchmark::State& state) {
         }
         benchmark::DoNotOptimize(pointer);
     }
+    perf_counters.stop(state);
 
     state.SetItemsProcessed(state.iterations() * num_allocations);
     state.SetLabel("eviction");
@@ -212,6 +239,8 @@ static void BM_LRUIterator(benchmark::State& state) {
     }
 
     size_t count = 0;
+    perfcounters::PerfCounters perf_counters;
+    perf_counters.start();
     for ([[maybe_unused]] auto _ : state) {
         // Iterate through all allocations in LRU order
         for (auto& handle : manager) {
@@ -219,6 +248,7 @@ static void BM_LRUIterator(benchmark::State& state) {
             count++;
         }
     }
+    perf_counters.stop(state);
 
     // Clean up
     for (size_t i = 0; i < num_handles; ++i) {
@@ -231,6 +261,208 @@ static void BM_LRUIterator(benchmark::State& state) {
     state.SetComplexityN(state.range(1));
 }
 
+namespace {
+
+// Keyed cache on top of LRUMemoryManager: one handle per key
+class LRUManagerCache {
+public:
+    LRUManagerCache(size_t pool_size, uint32_t key_count)
+        : manager_(pool_size)
+        , handles_(key_count)
+    {}
+
+    bool access(uint32_t key, uint32_t size)
+    {
+        auto& handle = handles_[key];
+        void* data = manager_.get_buffer_and_refresh(&handle);
+        if (data != nullptr) {
+            benchmark::DoNotOptimize(data);
+            return true;
+        }
+        data = manager_.alloc(&handle, size);
+        benchmark::DoNotOptimize(data);
+        return false;
+    }
+
+private:
+    lrumm::LRUMemoryManager manager_;
+    std::vector<lrumm::LRUMemoryManager::LRUMemoryHandle> handles_;
+};
+
+}
+
+// Benchmark for precomputed skewed workloads: refresh on hit, allocate on miss
+static void BM_LRUWorkload(benchmark::State& state) {
+    auto kind = static_cast<workloads::WorkloadKind>(state.range(0));
+    size_t pool_size = static_cast<size_t>(state.range(1)) * 1024 * 1024;
+
+    const workloads::Workload& workload = workloads::cached_workload(kind);
+    size_t rss_before = workloads::resident_set_bytes();
+    LRUManagerCache cache(pool_size, workload.key_count);
+
+    workloads::run_workload(state, cache, workload, rss_before);
+    state.SetLabel(workloads::workload_name(kind));
+}
+
+// Baseline for BM_LRUWorkload: malloc/free with a std::list + std::unordered_map LRU
+static void BM_MallocLRUWorkload(benchmark::State& state) {
+    auto kind = static_cast<workloads::WorkloadKind>(state.range(0));
+    size_t pool_size = static_cast<size_t>(state.range(1)) * 1024 * 1024;
+
+    const workloads::Workload& workload = workloads::cached_workload(kind);
+    size_t rss_before = workloads::resident_set_bytes();
+    baselines::MallocLRUCache cache(pool_size, workload.key_count);
+
+    workloads::run_workload(state, cache, workload, rss_before);
+    state.SetLabel(workloads::workload_name(kind));
+}
+
+// Baseline for BM_LRUWorkload: the same LRU with buffers and nodes from a pmr pool resource
+static void BM_PmrLRUWorkload(benchmark::State& state) {
+    auto kind = static_cast<workloads::WorkloadKind>(state.range(0));
+    size_t pool_size = static_cast<size_t>(state.range(1)) * 1024 * 1024;
+
+    const workloads::Workload& workload = workloads::cached_workload(kind);
+    size_t rss_before = workloads::resident_set_bytes();
+    baselines::PmrLRUCache cache(pool_size, workload.key_count);
+
+    workloads::run_workload(state, cache, workload, rss_before);
+    state.SetLabel(workloads::workload_name(kind));
+}
+
+namespace {
+
+constexpr size_t kColdAllocSize = 64;
+
+// Evicts the CPU caches by writing a buffer several times the size of the last level cache
+void flush_caches()
+{
+    long llc_size = sysconf(_SC_LEVEL3_CACHE_SIZE);
+    size_t flush_size = 4 * static_cast<size_t>(llc_size > 0 ? llc_size : 64L * 1024 * 1024);
+    static std::vector<uint8_t> flush_buffer;
+    flush_buffer.resize(flush_size);
+    for (size_t i = 0; i < flush_buffer.size(); i += 64) {
+        flush_buffer[i]++;
+    }
+    benchmark::ClobberMemory();
+}
+
+// Handles visited in a random order, so neither the handles nor the hunk headers are prefetched
+std::vector<uint32_t> make_permutation(size_t count)
+{
+    std::vector<uint32_t> permutation(count);
+    for (size_t i = 0; i < count; ++i) {
+        permutation[i] = static_cast<uint32_t>(i);
+    }
+    std::shuffle(permutation.begin(), permutation.end(), std::mt19937(42));
+    return permutation;
+}
+
+size_t cold_pool_size(size_t num_handles)
+{
+    return (num_handles + 1) * lrumm::LRUMemoryManager::get_hunk_footprint(kColdAllocSize);
+}
+
+}
+
+// Refresh in random order over far more hunks than fit in the LLC: three hunk headers per refresh miss the cache
+static void BM_LRUColdRefresh(benchmark::State& state) {
+    size_t num_handles = state.range(0);
+    lrumm::LRUMemoryManager manager(cold_pool_size(num_handles));
+    std::vector<lrumm::LRUMemoryManager::LRUMemoryHandle> handles(num_handles);
+    for (auto& handle : handles) {
+        manager.alloc(&handle, kColdAllocSize);
+    }
+    std::vector<uint32_t> permutation = make_permutation(num_handles);
+    if (state.range(1)) {
+        flush_caches();
+    }
+
+    size_t index = 0;
+    perfcounters::PerfCounters perf_counters;
+    perf_counters.start();
+    for ([[maybe_unused]] auto _ : state) {
+        void* data = manager.get_buffer_and_refresh(&handles[permutation[index]]);
+        benchmark::DoNotOptimize(data);
+        if (++index == num_handles) {
+            index = 0;
+        }
+    }
+    perf_counters.stop(state);
+
+    state.SetItemsProcessed(state.iterations());
+    state.SetLabel("cold_refresh");
+}
+
+// Free in random order; the pool is refilled outside the timed region once every handle is freed
+static void BM_LRUColdFree(benchmark::State& state) {
+    size_t num_handles = state.range(0);
+    lrumm::LRUMemoryManager manager(cold_pool_size(num_handles));
+    std::vector<lrumm::LRUMemoryManager::LRUMemoryHandle> handles(num_handles);
+    for (auto& handle : handles) {
+        manager.alloc(&handle, kColdAllocSize);
+    }
+    std::vector<uint32_t> permutation = make_permutation(num_handles);
+    if (state.range(1)) {
+        flush_caches();
+    }
+
+    size_t index = 0;
+    perfcounters::PerfCounters perf_counters;
+    perf_counters.start();
+    for ([[maybe_unused]] auto _ : state) {
+        manager.free(&handles[permutation[index]]);
+        if (++index == num_handles) {
+            state.PauseTiming();
+            perf_counters.pause(); // the refill and the cache flush are not part of free()
+            for (auto& handle : handles) {
+                manager.alloc(&handle, kColdAllocSize);
+            }
+            if (state.range(1)) {
+                flush_caches();
+            }
+            index = 0;
+            perf_counters.resume();
+            state.ResumeTiming();
+        }
+    }
+    perf_counters.stop(state);
+
+    state.SetItemsProcessed(state.iterations());
+    state.SetLabel("cold_free");
+}
+
+// Free and allocate a random handle again: the first fit scan walks the pool up to the freed hole
+static void BM_LRUColdAlloc(benchmark::State& state) {
+    size_t num_handles = state.range(0);
+    lrumm::LRUMemoryManager manager(cold_pool_size(num_handles));
+    std::vector<lrumm::LRUMemoryManager::LRUMemoryHandle> handles(num_handles);
+    for (auto& handle : handles) {
+        manager.alloc(&handle, kColdAllocSize);
+    }
+    std::vector<uint32_t> permutation = make_permutation(num_handles);
+    if (state.range(1)) {
+        flush_caches();
+    }
+
+    size_t index = 0;
+    perfcounters::PerfCounters perf_counters;
+    perf_counters.start();
+    for ([[maybe_unused]] auto _ : state) {
+        auto& handle = handles[permutation[index]];
+        manager.free(&handle);
+        void* data = manager.alloc(&handle, kColdAllocSize);
+        benchmark::DoNotOptimize(data);
+        if (++index == num_handles) {
+            index = 0;
+        }
+    }
+    perf_counters.stop(state);
+
+    state.SetItemsProcessed(state.iterations());
+    state.SetLabel("cold_alloc");
+}
+
 BENCHMARK(BM_LRUAllocAllocation)->Range(8, 8 << 20)->Complexity();
 BENCHMARK(BM_LRUGetBufferAndRefresh)->Ranges({{1, 1 << 10}, {64, 1 << 10}})->Complexity();
 BENCHMARK(BM_LRUFree)->Ranges({{1, 1 << 10}, {64, 1 << 10}})->Complexity();
@@ -238,4 +470,20 @@ BENCHMARK(BM_LRUMixedWorkload)->Ranges({{1, 1 << 10}, {64, 1 << 10}})->Complexit
 BENCHMARK(BM_LRUEviction)->Ranges({{1024, 16 * 1024}, {32, 128}, {10, 100}})->Complexity();
 BENCHMARK(BM_LRUIterator)->Ranges({{1, 1 << 10}, {64, 1 << 10}})->Complexity();
 
+// handle count x flush the caches before timing
+BENCHMARK(BM_LRUColdRefresh)->ArgsProduct({{1 << 14, 1 << 17, 1 << 20}, {0, 1}});
+BENCHMARK(BM_LRUColdFree)->ArgsProduct({{1 << 14, 1 << 17, 1 << 20}, {0, 1}});
+BENCHMARK(BM_LRUColdAlloc)->ArgsProduct({{1 << 14, 1 << 17, 1 << 20}, {0, 1}});
+
+// workload kind x pool size in MiB, the same grid for the manager and the baselines
+static void WorkloadArguments(benchmark::internal::Benchmark* benchmark) {
+    benchmark->ArgsProduct({
+        benchmark::CreateDenseRange(0, workloads::WORKLOAD_KIND_COUNT - 1, 1),
+        {1, 4, 16, 64}
+    });
+}
+BENCHMARK(BM_LRUWorkload)->Apply(WorkloadArguments);
+BENCHMARK(BM_MallocLRUWorkload)->Apply(WorkloadArguments);
+BENCHMARK(BM_PmrLRUWorkload)->Apply(WorkloadArguments);
+
 BENCHMARK_MAIN();
\ No newline at end of file
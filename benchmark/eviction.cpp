@@ -0,0 +1,98 @@
+#include <benchmark/benchmark.h>
+
+#include <random>
+#include <vector>
+
+#include "lrumemorymanager.h"
+#include "perfcounters.h"
+
+// Eviction cost at scale: a 1 GiB pool filled to 100% occupancy with 10^5-10^6
+// live hunks of mixed sizes, then steady churn where every allocation has to
+// evict. Built against the instrumented library, so the scan and eviction
+// counters of the manager are reported next to the timing.
+
+namespace {
+
+constexpr size_t kPoolSize = size_t(1) << 30;
+
+struct EvictionSetup {
+    size_t live_hunks;
+    size_t refreshes_per_alloc;
+};
+
+// Sizes vary between a quarter and 1.75x of the mean, so evictions leave gaps that do not fit exactly
+std::vector<uint32_t> make_sizes(size_t count, size_t mean_size, uint32_t seed)
+{
+    std::mt19937 gen(seed);
+    std::uniform_int_distribution<size_t> dis(mean_size / 4, mean_size * 7 / 4);
+    std::vector<uint32_t> sizes(count);
+    for (auto& size : sizes) {
+        size = static_cast<uint32_t>(dis(gen));
+    }
+    return sizes;
+}
+
+}
+
+// Steady churn at full occupancy: every iteration allocates a handle that was evicted long ago
+static void BM_LRUEvictionChurn(benchmark::State& state) {
+    EvictionSetup setup = { static_cast<size_t>(state.range(0)), static_cast<size_t>(state.range(1)) };
+    size_t mean_size = kPoolSize / setup.live_hunks - lrumm::LRUMemoryManager::get_hunk_footprint(0);
+
+    // Twice as many handles as fit, used round robin: a handle comes back after it was evicted
+    size_t handle_count = setup.live_hunks * 2;
+    std::vector<uint32_t> sizes = make_sizes(handle_count, mean_size, 42);
+    std::vector<uint32_t> refresh_stream(1 << 16);
+    std::mt19937 gen(7);
+    for (auto& index : refresh_stream) {
+        index = static_cast<uint32_t>(gen() % handle_count);
+    }
+
+    lrumm::LRUMemoryManager manager(kPoolSize);
+    manager.set_latency_sample_period(1); // iterations are few and slow, time all of them
+    std::vector<lrumm::LRUMemoryManager::LRUMemoryHandle> handles(handle_count);
+
+    // Fill up to the first eviction
+    size_t cursor = 0;
+    while (manager.get_stats().evictions == 0) {
+        manager.alloc(&handles[cursor], sizes[cursor]);
+        cursor = (cursor + 1) % handle_count;
+    }
+    manager.reset_stats();
+
+    size_t refresh_index = 0;
+    perfcounters::PerfCounters perf_counters;
+    perf_counters.start();
+    for ([[maybe_unused]] auto _ : state) {
+        for (size_t i = 0; i < setup.refreshes_per_alloc; ++i) {
+            void* data = manager.get_buffer_and_refresh(&handles[refresh_stream[refresh_index]]);
+            benchmark::DoNotOptimize(data);
+            refresh_index = (refresh_index + 1) % refresh_stream.size();
+        }
+
+        auto& handle = handles[cursor];
+        if (handle.hunk_ptr()) {
+            manager.free(&handle);
+        }
+        void* data = manager.alloc(&handle, sizes[cursor]);
+        benchmark::DoNotOptimize(data);
+        cursor = (cursor + 1) % handle_count;
+    }
+    perf_counters.stop(state);
+
+    auto stats = manager.get_stats();
+    state.SetItemsProcessed(state.iterations());
+    state.counters["EvictionsPerAlloc"] = benchmark::Counter(
+        stats.allocs ? static_cast<double>(stats.evictions) / static_cast<double>(stats.allocs) : 0.0);
+    state.counters["HunksScannedPerAlloc"] = benchmark::Counter(stats.hunks_scanned_per_alloc());
+    state.counters["FragmentationEvictions"] = benchmark::Counter(
+        stats.evictions ? static_cast<double>(stats.evictions_fragmentation) / static_cast<double>(stats.evictions) : 0.0);
+    state.counters["AllocP99ns"] = benchmark::Counter(static_cast<double>(stats.alloc_latency.p99));
+    state.SetLabel("eviction_churn");
+}
+
+BENCHMARK(BM_LRUEvictionChurn)
+    ->ArgsProduct({ { 100000, 300000, 1000000 }, { 0, 1 } }) // live hunks, refreshes per alloc
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,185 @@
+#ifndef LRU_MEMORY_PERFCOUNTERS__H
+#define LRU_MEMORY_PERFCOUNTERS__H
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Optional hardware counters for the benchmarks. Set LRUMM_PERF_COUNTERS=1 to
+// open them with perf_event_open; every counter that opens is reported per
+// iteration as a user counter. Counters the kernel, the hardware or the
+// perf_event_paranoid setting refuse are skipped, the benchmarks run either way.
+
+namespace perfcounters {
+
+#if defined(__linux__)
+struct PerfEvent {
+    const char* name;
+    uint32_t type;
+    uint64_t config;
+};
+
+constexpr uint64_t cache_miss_event(uint64_t cache)
+{
+    return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+}
+
+inline constexpr PerfEvent PERF_EVENTS[] = {
+    { "Instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+    { "BranchMisses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+    { "L1DMisses", PERF_TYPE_HW_CACHE, cache_miss_event(PERF_COUNT_HW_CACHE_L1D) },
+    { "LLCMisses", PERF_TYPE_HW_CACHE, cache_miss_event(PERF_COUNT_HW_CACHE_LL) },
+    { "DTLBMisses", PERF_TYPE_HW_CACHE, cache_miss_event(PERF_COUNT_HW_CACHE_DTLB) },
+};
+#endif
+
+class PerfCounters {
+public:
+    static constexpr int EVENT_COUNT = 5;
+
+    PerfCounters()
+    {
+        for (int& fd : fds_) {
+            fd = -1;
+        }
+        if (!is_requested()) {
+            return;
+        }
+#if defined(__linux__)
+        for (int i = 0; i < EVENT_COUNT; ++i) {
+            fds_[i] = open_event(PERF_EVENTS[i].type, PERF_EVENTS[i].config);
+        }
+        warn_unavailable();
+#endif
+    }
+
+    ~PerfCounters()
+    {
+#if defined(__linux__)
+        for (int fd : fds_) {
+            if (fd >= 0) {
+                close(fd);
+            }
+        }
+#endif
+    }
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    void start()
+    {
+#if defined(__linux__)
+        for (int fd : fds_) {
+            if (fd >= 0) {
+                ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+                ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+            }
+        }
+#endif
+    }
+
+    /**
+     * @brief Suspends counting without resetting, next to State::PauseTiming()
+     */
+    void pause()
+    {
+#if defined(__linux__)
+        for (int fd : fds_) {
+            if (fd >= 0) {
+                ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+            }
+        }
+#endif
+    }
+
+    /**
+     * @brief Continues counting after pause(), next to State::ResumeTiming()
+     */
+    void resume()
+    {
+#if defined(__linux__)
+        for (int fd : fds_) {
+            if (fd >= 0) {
+                ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+            }
+        }
+#endif
+    }
+
+    /**
+     * @brief Stops counting and adds the per-iteration counts to the benchmark counters
+     */
+    void stop(benchmark::State& state)
+    {
+#if defined(__linux__)
+        for (int i = 0; i < EVENT_COUNT; ++i) {
+            if (fds_[i] < 0) {
+                continue;
+            }
+            ioctl(fds_[i], PERF_EVENT_IOC_DISABLE, 0);
+
+            // Scale up when the kernel multiplexed the counter with others
+            uint64_t values[3] = {};
+            if (read(fds_[i], values, sizeof(values)) != static_cast<ssize_t>(sizeof(values)) || values[2] == 0) {
+                continue;
+            }
+            double count = static_cast<double>(values[0]) * static_cast<double>(values[1]) / static_cast<double>(values[2]);
+            state.counters[PERF_EVENTS[i].name] = benchmark::Counter(count, benchmark::Counter::kAvgIterations);
+        }
+#else
+        (void)state;
+#endif
+    }
+
+private:
+#if defined(__linux__)
+    static_assert(sizeof(PERF_EVENTS) / sizeof(PERF_EVENTS[0]) == EVENT_COUNT, "One file descriptor per event");
+
+    static int open_event(uint32_t type, uint64_t config)
+    {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        return static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+    }
+
+    void warn_unavailable() const
+    {
+        static bool is_warned = false;
+        for (int i = 0; i < EVENT_COUNT && !is_warned; ++i) {
+            if (fds_[i] < 0) {
+                std::fprintf(stderr, "perf counter %s is unavailable and is not reported.\n", PERF_EVENTS[i].name);
+            }
+        }
+        is_warned = true;
+    }
+#endif
+
+    static bool is_requested()
+    {
+        const char* value = std::getenv("LRUMM_PERF_COUNTERS");
+        return value && *value && std::strcmp(value, "0") != 0;
+    }
+
+    int fds_[EVENT_COUNT];
+};
+
+}
+#endif // LRU_MEMORY_PERFCOUNTERS__H
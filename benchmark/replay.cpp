@@ -0,0 +1,142 @@
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "lrumemorymanager.h"
+#include "lrumemoryreplay.h"
+#include "lrumemorytrace.h"
+
+// Replays a recorded operation trace (binary recorder format or CSV) against
+// LRUMemoryManager and reports throughput, latency percentiles, hit ratio and
+// the peak external fragmentation for every requested pool size and policy.
+
+namespace {
+
+struct ReplayOptions {
+    std::string trace_path;
+    std::vector<size_t> pool_sizes;
+    std::vector<const char*> policies;
+    uint32_t latency_sample_period = 16;
+    uint64_t fragmentation_interval = 4096;
+};
+
+void print_usage(const char* program)
+{
+    std::fprintf(stderr,
+        "Usage: %s --trace FILE [--pool-size SIZE]... [--policy NAME]...\n"
+        "          [--latency-sample N] [--fragmentation-interval N]\n"
+        "SIZE accepts K, M and G suffixes (default 16M); policies:", program);
+    for (const char* policy : lrumm::replay_policy_names()) {
+        std::fprintf(stderr, " %s", policy);
+    }
+    std::fprintf(stderr, "\n");
+}
+
+bool parse_options(int argc, char** argv, ReplayOptions& options)
+{
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        size_t number = 0;
+
+        if (std::strcmp(arg, "--trace") == 0 && value) {
+            options.trace_path = value;
+        } else if (std::strcmp(arg, "--pool-size") == 0 && value && lrumm::parse_size_argument(value, number)) {
+            options.pool_sizes.push_back(number);
+        } else if (std::strcmp(arg, "--policy") == 0 && value) {
+            options.policies.push_back(value);
+        } else if (std::strcmp(arg, "--latency-sample") == 0 && value && lrumm::parse_size_argument(value, number)) {
+            options.latency_sample_period = static_cast<uint32_t>(number);
+        } else if (std::strcmp(arg, "--fragmentation-interval") == 0 && value && lrumm::parse_size_argument(value, number)) {
+            options.fragmentation_interval = number;
+        } else {
+            return false;
+        }
+        ++i;
+    }
+
+    if (options.pool_sizes.empty()) {
+        options.pool_sizes.push_back(16 * 1024 * 1024);
+    }
+    if (options.policies.empty()) {
+        options.policies.push_back("lru");
+    }
+    return !options.trace_path.empty();
+}
+
+void print_latency(const char* name, const lrumm::LRULatencySummary& summary)
+{
+    std::printf("    %-8s samples %10llu  p50 %8llu ns  p99 %8llu ns  p999 %8llu ns  max %10llu ns\n", name,
+        static_cast<unsigned long long>(summary.samples), static_cast<unsigned long long>(summary.p50),
+        static_cast<unsigned long long>(summary.p99), static_cast<unsigned long long>(summary.p999),
+        static_cast<unsigned long long>(summary.max));
+}
+
+void replay(const lrumm::LRUTraceReplay& trace_replay, size_t pool_size, const char* policy, const ReplayOptions& options)
+{
+    lrumm::LRUMemoryManager manager(pool_size);
+    if (!lrumm::apply_replay_policy(manager, policy)) {
+        std::fprintf(stderr, "Unknown policy %s.\n", policy);
+        return;
+    }
+    manager.set_latency_sample_period(options.latency_sample_period);
+
+    double peak_fragmentation = 0.0;
+    auto observe_fragmentation = [&peak_fragmentation](const lrumm::LRUMemoryManager& observed, uint64_t) {
+        double fragmentation = observed.get_stats().external_fragmentation();
+        if (fragmentation > peak_fragmentation) {
+            peak_fragmentation = fragmentation;
+        }
+    };
+
+    lrumm::LRUReplayResult result = trace_replay.run(manager, options.fragmentation_interval, observe_fragmentation);
+
+    auto stats = manager.get_stats();
+    double seconds = static_cast<double>(result.elapsed_ns) / 1e9;
+
+    std::printf("pool %zu bytes, policy %s\n", pool_size, policy);
+    std::printf("    throughput %.0f ops/s (%.1f ns/op)\n",
+        seconds > 0 ? static_cast<double>(result.steps) / seconds : 0.0,
+        result.steps ? static_cast<double>(result.elapsed_ns) / static_cast<double>(result.steps) : 0.0);
+    std::printf("    hit ratio %.4f, byte hit ratio %.4f (%llu hits, %llu misses)\n", result.hit_ratio(),
+        result.byte_hit_ratio(), static_cast<unsigned long long>(result.hits),
+        static_cast<unsigned long long>(result.misses));
+    std::printf("    allocs %llu (%llu failed), evictions %llu (%llu fragmentation, %llu capacity)\n",
+        static_cast<unsigned long long>(result.allocs), static_cast<unsigned long long>(result.failed_allocs),
+        static_cast<unsigned long long>(stats.evictions), static_cast<unsigned long long>(stats.evictions_fragmentation),
+        static_cast<unsigned long long>(stats.evictions_capacity));
+    std::printf("    peak external fragmentation %.4f, peak usage %llu bytes\n", peak_fragmentation,
+        static_cast<unsigned long long>(stats.peak_allocated_size));
+    print_latency("alloc", stats.alloc_latency);
+    print_latency("refresh", stats.refresh_latency);
+    print_latency("free", stats.free_latency);
+    print_latency("eviction", stats.eviction_latency);
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    ReplayOptions options;
+    if (!parse_options(argc, argv, options)) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    std::vector<lrumm::LRUTraceRecord> records;
+    if (!lrumm::read_trace(options.trace_path.c_str(), records)) {
+        return 1;
+    }
+
+    lrumm::LRUTraceReplay trace_replay(records);
+    std::printf("trace %s: %zu steps, %zu handles\n", options.trace_path.c_str(), trace_replay.step_count(),
+        trace_replay.slot_count());
+
+    for (size_t pool_size : options.pool_sizes) {
+        for (const char* policy : options.policies) {
+            replay(trace_replay, pool_size, policy, options);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,143 @@
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "lrumemorymanager.h"
+#include "lrumemoryreplay.h"
+#include "workloads.h"
+
+// Fragmentation soak: runs millions of mixed-size cache operations against one
+// pool and prints a CSV time series of how usable the pool stays, so placement
+// strategies can be compared on how they degrade over time rather than on a
+// short benchmark run.
+
+namespace {
+
+struct SoakOptions {
+    size_t pool_size = 64 * 1024 * 1024;
+    uint64_t op_count = 10000000;
+    uint64_t sample_interval = 100000;
+    workloads::WorkloadKind kind = workloads::WorkloadKind::ZipfLognormal;
+    const char* policy = "lru";
+    uint32_t free_period = 8; ///< One out of free_period accesses to a live key frees it instead
+    uint32_t latency_sample_period = 16;
+};
+
+void print_usage(const char* program)
+{
+    std::fprintf(stderr,
+        "Usage: %s [--pool-size SIZE] [--ops N] [--interval N] [--workload N] [--policy NAME]\n"
+        "          [--free-period N] [--latency-sample N]\n"
+        "SIZE and N accept K, M and G suffixes; workloads:", program);
+    for (int kind = 0; kind < workloads::WORKLOAD_KIND_COUNT; ++kind) {
+        std::fprintf(stderr, " %d=%s", kind, workloads::workload_name(static_cast<workloads::WorkloadKind>(kind)));
+    }
+    std::fprintf(stderr, "\n");
+}
+
+bool parse_options(int argc, char** argv, SoakOptions& options)
+{
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        size_t number = 0;
+
+        if (std::strcmp(arg, "--policy") == 0 && value) {
+            options.policy = value;
+        } else if (!value || !lrumm::parse_size_argument(value, number)) {
+            return false;
+        } else if (std::strcmp(arg, "--pool-size") == 0) {
+            options.pool_size = number;
+        } else if (std::strcmp(arg, "--ops") == 0) {
+            options.op_count = number;
+        } else if (std::strcmp(arg, "--interval") == 0) {
+            options.sample_interval = number;
+        } else if (std::strcmp(arg, "--workload") == 0 && number < workloads::WORKLOAD_KIND_COUNT) {
+            options.kind = static_cast<workloads::WorkloadKind>(number);
+        } else if (std::strcmp(arg, "--free-period") == 0) {
+            options.free_period = static_cast<uint32_t>(number);
+        } else if (std::strcmp(arg, "--latency-sample") == 0) {
+            options.latency_sample_period = static_cast<uint32_t>(number);
+        } else {
+            return false;
+        }
+        ++i;
+    }
+    return true;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    SoakOptions options;
+    if (!parse_options(argc, argv, options)) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    // The stream is reused cyclically when the soak runs longer than it
+    workloads::WorkloadConfig config;
+    config.op_count = static_cast<size_t>(std::min<uint64_t>(options.op_count, 1 << 22));
+    const workloads::Workload workload = workloads::make_workload(options.kind, config);
+
+    lrumm::LRUMemoryManager manager(options.pool_size);
+    if (!lrumm::apply_replay_policy(manager, options.policy)) {
+        std::fprintf(stderr, "Unknown policy %s.\n", options.policy);
+        return 1;
+    }
+    manager.set_latency_sample_period(options.latency_sample_period);
+    std::vector<lrumm::LRUMemoryManager::LRUMemoryHandle> handles(workload.key_count);
+
+    std::printf("# pool %zu bytes, workload %s, policy %s, %llu ops\n", options.pool_size,
+        workloads::workload_name(options.kind), options.policy, static_cast<unsigned long long>(options.op_count));
+    std::printf("ops,elapsed_s,allocated_bytes,usable_fraction,largest_free_gap,free_gap_count,external_fragmentation,"
+        "hit_ratio,evictions,fragmentation_evictions,total_fragmentation_evictions,alloc_p50_ns,alloc_p99_ns\n");
+
+    uint64_t elapsed_ns = 0;
+    uint64_t total_fragmentation_evictions = 0;
+    uint64_t hits = 0;
+    size_t op_index = 0;
+
+    for (uint64_t done = 0; done < options.op_count;) {
+        uint64_t batch = std::min(options.sample_interval, options.op_count - done);
+        hits = 0;
+
+        uint64_t start_ns = lrumm::detail::now_ns();
+        for (uint64_t i = 0; i < batch; ++i) {
+            const workloads::WorkloadOp& op = workload.ops[op_index];
+            auto& handle = handles[op.key];
+            if (!handle.hunk_ptr()) {
+                // A miss: the key was evicted or freed, or is new
+                manager.alloc(&handle, op.size);
+            } else if (options.free_period && (done + i) % options.free_period == 0) {
+                manager.free(&handle);
+            } else {
+                hits += manager.get_buffer_and_refresh(&handle) != nullptr;
+            }
+            if (++op_index == workload.ops.size()) {
+                op_index = 0;
+            }
+        }
+        elapsed_ns += lrumm::detail::now_ns() - start_ns;
+        done += batch;
+
+        // Every sample covers the operations since the previous one
+        lrumm::LRUMemoryStats stats = manager.get_stats();
+        manager.reset_stats();
+        total_fragmentation_evictions += stats.evictions_fragmentation;
+
+        size_t allocated_size = manager.get_allocated_memory_size();
+        double usable_fraction = static_cast<double>(allocated_size + stats.largest_free_gap)
+            / static_cast<double>(options.pool_size);
+        std::printf("%llu,%.3f,%zu,%.4f,%llu,%llu,%.4f,%.4f,%llu,%llu,%llu,%llu,%llu\n",
+            static_cast<unsigned long long>(done), static_cast<double>(elapsed_ns) / 1e9, allocated_size, usable_fraction,
+            static_cast<unsigned long long>(stats.largest_free_gap), static_cast<unsigned long long>(stats.free_gap_count),
+            stats.external_fragmentation(), static_cast<double>(hits) / static_cast<double>(batch), static_cast<unsigned long long>(stats.evictions),
+            static_cast<unsigned long long>(stats.evictions_fragmentation),
+            static_cast<unsigned long long>(total_fragmentation_evictions),
+            static_cast<unsigned long long>(stats.alloc_latency.p50), static_cast<unsigned long long>(stats.alloc_latency.p99));
+        std::fflush(stdout);
+    }
+    return 0;
+}
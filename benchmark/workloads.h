@@ -0,0 +1,228 @@
+#ifndef LRU_MEMORY_WORKLOADS__H
+#define LRU_MEMORY_WORKLOADS__H
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include <unistd.h>
+
+#include "perfcounters.h"
+
+// Precomputed cache access streams for the benchmarks. All the random number
+// generation happens while building the stream, so the timed loops only read
+// the next operation from a flat array.
+
+namespace workloads {
+
+/**
+ * @brief One cache access: refresh the key if it is cached, allocate it otherwise
+ */
+struct WorkloadOp {
+    uint32_t key;
+    uint32_t size;
+};
+
+enum class WorkloadKind : int {
+    ZipfLognormal = 0,  ///< Zipf-skewed keys, lognormal sizes
+    ZipfBimodal = 1,    ///< Zipf-skewed keys, mostly small buffers with a tail of large ones
+    ZipfScanBursts = 2, ///< Zipf-skewed keys interrupted by sequential scans of cold keys
+    ZipfPhaseShift = 3, ///< The hot set moves to different keys every phase
+};
+
+constexpr int WORKLOAD_KIND_COUNT = 4;
+
+inline const char* workload_name(WorkloadKind kind)
+{
+    switch (kind) {
+        case WorkloadKind::ZipfLognormal: return "zipf_lognormal";
+        case WorkloadKind::ZipfBimodal: return "zipf_bimodal";
+        case WorkloadKind::ZipfScanBursts: return "zipf_scan_bursts";
+        case WorkloadKind::ZipfPhaseShift: return "zipf_phase_shift";
+    }
+    return "unknown";
+}
+
+struct WorkloadConfig {
+    uint32_t key_count = 100000;
+    size_t op_count = 1 << 20;
+    double zipf_exponent = 0.99;
+    uint32_t scan_period = 50000;  ///< Ops between the starts of two scans
+    uint32_t scan_length = 10000;  ///< Cold keys touched by one scan
+    uint32_t phase_count = 4;
+    uint32_t seed = 42;
+};
+
+struct Workload {
+    std::vector<WorkloadOp> ops;
+    uint32_t key_count = 0; ///< Distinct keys, including the scanned ones
+    uint64_t unique_bytes = 0; ///< Sum of the sizes of all distinct keys
+};
+
+/**
+ * @brief Samples ranks 0..n-1 with probability proportional to 1/(rank+1)^s
+ */
+class ZipfSampler {
+public:
+    ZipfSampler(uint32_t n, double exponent)
+        : cdf_(n)
+    {
+        double sum = 0.0;
+        for (uint32_t rank = 0; rank < n; ++rank) {
+            sum += 1.0 / std::pow(static_cast<double>(rank + 1), exponent);
+            cdf_[rank] = sum;
+        }
+        for (double& value : cdf_) {
+            value /= sum;
+        }
+    }
+
+    template<typename Generator>
+    uint32_t operator()(Generator& gen)
+    {
+        double u = std::uniform_real_distribution<double>(0.0, 1.0)(gen);
+        auto itr = std::lower_bound(cdf_.begin(), cdf_.end(), u);
+        return static_cast<uint32_t>(std::min<size_t>(itr - cdf_.begin(), cdf_.size() - 1));
+    }
+
+private:
+    std::vector<double> cdf_;
+};
+
+template<typename Generator>
+uint32_t lognormal_size(Generator& gen, double median, double sigma, uint32_t min_size, uint32_t max_size)
+{
+    double size = std::lognormal_distribution<double>(std::log(median), sigma)(gen);
+    return static_cast<uint32_t>(std::clamp(size, static_cast<double>(min_size), static_cast<double>(max_size)));
+}
+
+inline Workload make_workload(WorkloadKind kind, const WorkloadConfig& config = WorkloadConfig())
+{
+    std::mt19937_64 gen(config.seed);
+    Workload workload;
+
+    uint32_t scan_keys = kind == WorkloadKind::ZipfScanBursts ? config.scan_length * 4 : 0;
+    workload.key_count = config.key_count + scan_keys;
+
+    // Every key keeps the same size for the whole stream
+    std::vector<uint32_t> sizes(workload.key_count);
+    for (auto& size : sizes) {
+        if (kind == WorkloadKind::ZipfBimodal) {
+            bool is_large = std::bernoulli_distribution(0.1)(gen);
+            size = is_large ? lognormal_size(gen, 64 * 1024, 0.3, 16 * 1024, 1024 * 1024)
+                            : lognormal_size(gen, 256, 0.5, 16, 4096);
+        } else {
+            size = lognormal_size(gen, 1024, 1.0, 16, 256 * 1024);
+        }
+        workload.unique_bytes += size;
+    }
+
+    // Shuffle popularity so that the hot keys are not the low key numbers
+    std::vector<uint32_t> rank_to_key(config.key_count);
+    for (uint32_t rank = 0; rank < config.key_count; ++rank) {
+        rank_to_key[rank] = rank;
+    }
+    std::shuffle(rank_to_key.begin(), rank_to_key.end(), gen);
+
+    ZipfSampler zipf(config.key_count, config.zipf_exponent);
+    size_t phase_length = (config.op_count + config.phase_count - 1) / config.phase_count;
+    uint32_t next_scan_key = 0;
+
+    workload.ops.reserve(config.op_count);
+    while (workload.ops.size() < config.op_count) {
+        size_t op_index = workload.ops.size();
+
+        if (kind == WorkloadKind::ZipfScanBursts && op_index % config.scan_period == 0 && op_index > 0) {
+            // A scan touches a run of cold keys once each
+            for (uint32_t i = 0; i < config.scan_length && workload.ops.size() < config.op_count; ++i) {
+                uint32_t key = config.key_count + next_scan_key;
+                workload.ops.push_back({ key, sizes[key] });
+                next_scan_key = (next_scan_key + 1) % scan_keys;
+            }
+            continue;
+        }
+
+        uint32_t rank = zipf(gen);
+        if (kind == WorkloadKind::ZipfPhaseShift) {
+            // Each phase maps the popular ranks onto a different part of the key space
+            uint32_t phase = static_cast<uint32_t>(op_index / phase_length);
+            rank = (rank + phase * (config.key_count / config.phase_count)) % config.key_count;
+        }
+        uint32_t key = rank_to_key[rank];
+        workload.ops.push_back({ key, sizes[key] });
+    }
+
+    return workload;
+}
+
+/**
+ * @brief Workloads are expensive to build, so every kind is generated once per process
+ */
+inline const Workload& cached_workload(WorkloadKind kind)
+{
+    static std::map<WorkloadKind, std::unique_ptr<Workload>> cache;
+    auto& workload_ptr = cache[kind];
+    if (!workload_ptr) {
+        workload_ptr = std::make_unique<Workload>(make_workload(kind));
+    }
+    return *workload_ptr;
+}
+
+/**
+ * @brief Resident set size of the process, 0 when /proc is not available
+ */
+inline size_t resident_set_bytes()
+{
+    std::FILE* file_ptr = std::fopen("/proc/self/statm", "r");
+    if (!file_ptr) {
+        return 0;
+    }
+    unsigned long long total_pages = 0, resident_pages = 0;
+    int fields = std::fscanf(file_ptr, "%llu %llu", &total_pages, &resident_pages);
+    std::fclose(file_ptr);
+    return fields == 2 ? static_cast<size_t>(resident_pages) * static_cast<size_t>(sysconf(_SC_PAGESIZE)) : 0;
+}
+
+/**
+ * @brief Runs a precomputed stream against a cache adapter
+ *
+ * Cache must provide bool access(uint32_t key, uint32_t size) that returns true on a hit.
+ * rss_before is the resident set size taken before the cache was built; the growth
+ * since is reported as RSSBytes.
+ */
+template<typename Cache>
+void run_workload(benchmark::State& state, Cache& cache, const Workload& workload, size_t rss_before)
+{
+    const WorkloadOp* ops = workload.ops.data();
+    size_t op_count = workload.ops.size();
+    size_t index = 0;
+    uint64_t hits = 0;
+
+    perfcounters::PerfCounters perf_counters;
+    perf_counters.start();
+    for ([[maybe_unused]] auto _ : state) {
+        const WorkloadOp& op = ops[index];
+        hits += cache.access(op.key, op.size);
+        if (++index == op_count) {
+            index = 0;
+        }
+    }
+    perf_counters.stop(state);
+
+    state.SetItemsProcessed(state.iterations());
+    state.counters["HitRatio"] = benchmark::Counter(
+        state.iterations() ? static_cast<double>(hits) / static_cast<double>(state.iterations()) : 0.0);
+    size_t rss_after = resident_set_bytes();
+    state.counters["RSSBytes"] = benchmark::Counter(rss_after > rss_before ? static_cast<double>(rss_after - rss_before) : 0.0,
+        benchmark::Counter::kDefaults, benchmark::Counter::kIs1024);
+}
+
+}
+#endif // LRU_MEMORY_WORKLOADS__H
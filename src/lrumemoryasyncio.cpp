@@ -0,0 +1,438 @@
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+#include "lrumemoryasyncio.h"
+#include "lrumemorymanager.h"
+
+namespace lrumm {
+
+namespace {
+
+struct IORequest {
+    bool is_write = false;
+    int fd = -1;
+    uint8_t* buffer_ptr = nullptr;
+    size_t size = 0;
+    uint64_t offset = 0;
+    uint64_t tag = 0;
+    size_t done = 0; ///< Bytes transferred by earlier partial completions
+};
+
+IORequest
+make_request(bool is_write, int fd, const void* buffer_ptr, size_t size, uint64_t offset, uint64_t tag)
+{
+    IORequest request;
+    request.is_write = is_write;
+    request.fd = fd;
+    request.buffer_ptr = static_cast<uint8_t*>(const_cast<void*>(buffer_ptr));
+    request.size = size;
+    request.offset = offset;
+    request.tag = tag;
+    return request;
+}
+
+#if defined(__linux__) && defined(__NR_io_uring_setup)
+class UringEngine : public LRUIOEngine {
+public:
+    static constexpr size_t MAX_TRANSFER = size_t(1) << 30; ///< The SQE length is 32 bits
+
+    static std::unique_ptr<LRUIOEngine> create(unsigned queue_depth)
+    {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        int ring_fd = static_cast<int>(syscall(__NR_io_uring_setup, queue_depth, &params));
+        if (ring_fd < 0) {
+            return nullptr;
+        }
+
+        std::unique_ptr<UringEngine> engine_ptr(new UringEngine(ring_fd, queue_depth));
+        if (!engine_ptr->map_rings(params) || !engine_ptr->supports_read_write()) {
+            return nullptr;
+        }
+        return engine_ptr;
+    }
+
+    ~UringEngine() override
+    {
+        // Requests still in flight write into buffers of the caller, wait for them
+        std::vector<LRUIOCompletion> completions(queue_depth_);
+        while (in_flight_ > 0) {
+            poll(completions.data(), completions.size(), in_flight_);
+        }
+        if (sqes_ptr_) {
+            munmap(sqes_ptr_, sqes_size_);
+        }
+        if (cq_ring_ptr_ && cq_ring_ptr_ != sq_ring_ptr_) {
+            munmap(cq_ring_ptr_, cq_ring_size_);
+        }
+        if (sq_ring_ptr_) {
+            munmap(sq_ring_ptr_, sq_ring_size_);
+        }
+        close(ring_fd_);
+    }
+
+    const char* name() const override { return "io_uring"; }
+
+    bool submit_read(int fd, void* buffer_ptr, size_t size, uint64_t offset, uint64_t tag) override
+    {
+        return submit(make_request(false, fd, buffer_ptr, size, offset, tag));
+    }
+
+    bool submit_write(int fd, const void* buffer_ptr, size_t size, uint64_t offset, uint64_t tag) override
+    {
+        return submit(make_request(true, fd, buffer_ptr, size, offset, tag));
+    }
+
+    size_t poll(LRUIOCompletion* completions_ptr, size_t max_count, size_t min_count) override
+    {
+        size_t count = 0;
+        while (true) {
+            count += reap(completions_ptr + count, max_count - count);
+            if (count == max_count || count >= std::min(min_count, count + in_flight_)) {
+                return count;
+            }
+            if (syscall(__NR_io_uring_enter, ring_fd_, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0) < 0
+                && errno != EINTR) {
+                LOG_ERROR("io_uring_enter failed: %s.\n", std::strerror(errno));
+                return count;
+            }
+        }
+    }
+
+    size_t in_flight() const override { return in_flight_; }
+
+private:
+    UringEngine(int ring_fd, unsigned queue_depth)
+        : ring_fd_(ring_fd)
+        , queue_depth_(queue_depth)
+        , requests_(queue_depth)
+    {
+        for (uint32_t slot = queue_depth; slot > 0; --slot) {
+            free_slots_.push_back(slot - 1);
+        }
+    }
+
+    bool map_rings(const io_uring_params& params)
+    {
+        sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool is_single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (is_single_mmap) {
+            sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+        }
+
+        sq_ring_ptr_ = map(sq_ring_size_, IORING_OFF_SQ_RING);
+        cq_ring_ptr_ = is_single_mmap ? sq_ring_ptr_ : map(cq_ring_size_, IORING_OFF_CQ_RING);
+        sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+        sqes_ptr_ = static_cast<io_uring_sqe*>(map(sqes_size_, IORING_OFF_SQES));
+        if (!sq_ring_ptr_ || !cq_ring_ptr_ || !sqes_ptr_) {
+            return false;
+        }
+
+        auto* sq_ptr = static_cast<uint8_t*>(sq_ring_ptr_);
+        sq_tail_ptr_ = reinterpret_cast<unsigned*>(sq_ptr + params.sq_off.tail);
+        sq_mask_ = *reinterpret_cast<unsigned*>(sq_ptr + params.sq_off.ring_mask);
+        sq_array_ptr_ = reinterpret_cast<unsigned*>(sq_ptr + params.sq_off.array);
+
+        auto* cq_ptr = static_cast<uint8_t*>(cq_ring_ptr_);
+        cq_head_ptr_ = reinterpret_cast<unsigned*>(cq_ptr + params.cq_off.head);
+        cq_tail_ptr_ = reinterpret_cast<unsigned*>(cq_ptr + params.cq_off.tail);
+        cq_mask_ = *reinterpret_cast<unsigned*>(cq_ptr + params.cq_off.ring_mask);
+        cqes_ptr_ = reinterpret_cast<io_uring_cqe*>(cq_ptr + params.cq_off.cqes);
+        return true;
+    }
+
+    /**
+     * @brief IORING_OP_READ and IORING_OP_WRITE came with Linux 5.6, as did the probe
+     */
+    bool supports_read_write() const
+    {
+        constexpr unsigned OP_COUNT = 256;
+        std::vector<uint8_t> probe_buffer(sizeof(io_uring_probe) + OP_COUNT * sizeof(io_uring_probe_op));
+        auto* probe_ptr = reinterpret_cast<io_uring_probe*>(probe_buffer.data());
+        if (syscall(__NR_io_uring_register, ring_fd_, IORING_REGISTER_PROBE, probe_ptr, OP_COUNT) < 0) {
+            return false;
+        }
+        auto is_supported = [probe_ptr](unsigned op) {
+            return op <= probe_ptr->last_op && (probe_ptr->ops[op].flags & IO_URING_OP_SUPPORTED);
+        };
+        return is_supported(IORING_OP_READ) && is_supported(IORING_OP_WRITE);
+    }
+
+    void* map(size_t size, uint64_t offset)
+    {
+        void* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_,
+            static_cast<off_t>(offset));
+        return ptr == MAP_FAILED ? nullptr : ptr;
+    }
+
+    bool submit(const IORequest& request)
+    {
+        if (free_slots_.empty()) {
+            return false;
+        }
+        uint32_t slot = free_slots_.back();
+        free_slots_.pop_back();
+        requests_[slot] = request;
+        in_flight_++;
+        push(slot);
+        return true;
+    }
+
+    /**
+     * @brief Queues the remaining part of a request
+     *
+     * At most queue_depth requests are in flight and each holds at most one entry,
+     * so the submission ring never overflows. When the kernel does not take the
+     * entry, it is withdrawn and the request completes with the error.
+     */
+    void push(uint32_t slot)
+    {
+        const IORequest& request = requests_[slot];
+        unsigned tail = *sq_tail_ptr_;
+        unsigned index = tail & sq_mask_;
+
+        io_uring_sqe& sqe = sqes_ptr_[index];
+        std::memset(&sqe, 0, sizeof(sqe));
+        sqe.opcode = request.is_write ? IORING_OP_WRITE : IORING_OP_READ;
+        sqe.fd = request.fd;
+        sqe.addr = reinterpret_cast<uint64_t>(request.buffer_ptr + request.done);
+        sqe.len = static_cast<uint32_t>(std::min(request.size - request.done, MAX_TRANSFER));
+        sqe.off = request.offset + request.done;
+        sqe.user_data = slot;
+
+        sq_array_ptr_[index] = index;
+        __atomic_store_n(sq_tail_ptr_, tail + 1, __ATOMIC_RELEASE);
+
+        long result;
+        while ((result = syscall(__NR_io_uring_enter, ring_fd_, 1, 0, 0, nullptr, 0)) < 0 && errno == EINTR) {
+        }
+        if (result != 1) {
+            int error = result < 0 ? errno : EAGAIN;
+            LOG_ERROR("io_uring_enter failed to submit: %s.\n", std::strerror(error));
+            __atomic_store_n(sq_tail_ptr_, tail, __ATOMIC_RELEASE); // without SQPOLL only io_uring_enter consumes entries
+            failed_.emplace_back(slot, -error);
+        }
+    }
+
+    size_t reap(LRUIOCompletion* completions_ptr, size_t max_count)
+    {
+        size_t count = 0;
+        while (count < max_count && !failed_.empty()) {
+            auto [slot, result] = failed_.front();
+            failed_.pop_front();
+            completions_ptr[count++] = LRUIOCompletion{ requests_[slot].tag, result };
+            free_slots_.push_back(slot);
+            in_flight_--;
+        }
+
+        unsigned head = *cq_head_ptr_;
+        while (count < max_count && head != __atomic_load_n(cq_tail_ptr_, __ATOMIC_ACQUIRE)) {
+            const io_uring_cqe& cqe = cqes_ptr_[head & cq_mask_];
+            uint32_t slot = static_cast<uint32_t>(cqe.user_data);
+            int result = cqe.res;
+            __atomic_store_n(cq_head_ptr_, ++head, __ATOMIC_RELEASE);
+
+            IORequest& request = requests_[slot];
+            if (result == -EINTR || result == -EAGAIN) {
+                push(slot);
+                continue;
+            }
+            if (result > 0 && request.done + result < request.size) {
+                request.done += result; // partial transfer, queue the rest
+                push(slot);
+                continue;
+            }
+
+            completions_ptr[count++] = LRUIOCompletion{ request.tag,
+                result < 0 ? result : static_cast<int64_t>(request.done + result) };
+            free_slots_.push_back(slot);
+            in_flight_--;
+        }
+        return count;
+    }
+
+    int ring_fd_;
+    unsigned queue_depth_;
+    size_t in_flight_ = 0;
+    std::vector<IORequest> requests_;  ///< Indexed by the SQE user data
+    std::vector<uint32_t> free_slots_;
+    std::deque<std::pair<uint32_t, int>> failed_; ///< Slots of the requests the kernel did not take, with -errno
+
+    void* sq_ring_ptr_ = nullptr;
+    void* cq_ring_ptr_ = nullptr;
+    io_uring_sqe* sqes_ptr_ = nullptr;
+    size_t sq_ring_size_ = 0;
+    size_t cq_ring_size_ = 0;
+    size_t sqes_size_ = 0;
+    unsigned* sq_tail_ptr_ = nullptr;
+    unsigned* sq_array_ptr_ = nullptr;
+    unsigned sq_mask_ = 0;
+    unsigned* cq_head_ptr_ = nullptr;
+    unsigned* cq_tail_ptr_ = nullptr;
+    unsigned cq_mask_ = 0;
+    io_uring_cqe* cqes_ptr_ = nullptr;
+};
+#endif
+
+class ThreadPoolEngine : public LRUIOEngine {
+public:
+    ThreadPoolEngine(unsigned thread_count, unsigned queue_depth)
+        : queue_depth_(queue_depth)
+    {
+        for (unsigned i = 0; i < thread_count; ++i) {
+            workers_.emplace_back(&ThreadPoolEngine::worker_loop, this);
+        }
+    }
+
+    ~ThreadPoolEngine() override
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        pending_cv_.notify_all();
+        for (auto& worker : workers_) {
+            worker.join();
+        }
+    }
+
+    const char* name() const override { return "thread_pool"; }
+
+    bool submit_read(int fd, void* buffer_ptr, size_t size, uint64_t offset, uint64_t tag) override
+    {
+        return submit(make_request(false, fd, buffer_ptr, size, offset, tag));
+    }
+
+    bool submit_write(int fd, const void* buffer_ptr, size_t size, uint64_t offset, uint64_t tag) override
+    {
+        return submit(make_request(true, fd, buffer_ptr, size, offset, tag));
+    }
+
+    size_t poll(LRUIOCompletion* completions_ptr, size_t max_count, size_t min_count) override
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        size_t wanted = std::min(min_count, in_flight_);
+        completed_cv_.wait(lock, [this, wanted] { return completed_.size() >= wanted; });
+
+        size_t count = std::min(max_count, completed_.size());
+        std::copy_n(completed_.begin(), count, completions_ptr);
+        completed_.erase(completed_.begin(), completed_.begin() + static_cast<std::ptrdiff_t>(count));
+        in_flight_ -= count;
+        return count;
+    }
+
+    size_t in_flight() const override { return in_flight_; }
+
+private:
+    bool submit(const IORequest& request)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (in_flight_ == queue_depth_) {
+                return false;
+            }
+            pending_.push_back(request);
+            in_flight_++;
+        }
+        pending_cv_.notify_one();
+        return true;
+    }
+
+    static int64_t transfer(const IORequest& request)
+    {
+        size_t done = 0;
+        while (done < request.size) {
+            ssize_t result = request.is_write
+                ? pwrite(request.fd, request.buffer_ptr + done, request.size - done, static_cast<off_t>(request.offset + done))
+                : pread(request.fd, request.buffer_ptr + done, request.size - done, static_cast<off_t>(request.offset + done));
+            if (result < 0 && errno == EINTR) {
+                continue;
+            }
+            if (result < 0) {
+                return -errno;
+            }
+            if (result == 0) {
+                break; // end of the file
+            }
+            done += static_cast<size_t>(result);
+        }
+        return static_cast<int64_t>(done);
+    }
+
+    void worker_loop()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true) {
+            pending_cv_.wait(lock, [this] { return stop_ || !pending_.empty(); });
+            if (pending_.empty()) {
+                return; // stopped
+            }
+            IORequest request = pending_.front();
+            pending_.pop_front();
+
+            lock.unlock();
+            int64_t result = transfer(request);
+            lock.lock();
+
+            completed_.push_back(LRUIOCompletion{ request.tag, result });
+            completed_cv_.notify_one();
+        }
+    }
+
+    unsigned queue_depth_;
+    size_t in_flight_ = 0; ///< Submitted and not reaped yet
+    bool stop_ = false;
+    std::mutex mutex_;
+    std::condition_variable pending_cv_;
+    std::condition_variable completed_cv_;
+    std::deque<IORequest> pending_;
+    std::deque<LRUIOCompletion> completed_;
+    std::vector<std::thread> workers_;
+};
+
+}
+
+std::unique_ptr<LRUIOEngine>
+make_uring_engine(unsigned queue_depth)
+{
+#if defined(__linux__) && defined(__NR_io_uring_setup)
+    return UringEngine::create(queue_depth > 0 ? queue_depth : 1);
+#else
+    (void)queue_depth;
+    return nullptr;
+#endif
+}
+
+std::unique_ptr<LRUIOEngine>
+make_thread_pool_engine(unsigned thread_count, unsigned queue_depth)
+{
+    return std::make_unique<ThreadPoolEngine>(thread_count > 0 ? thread_count : 1, queue_depth > 0 ? queue_depth : 1);
+}
+
+std::unique_ptr<LRUIOEngine>
+make_io_engine(unsigned queue_depth, unsigned thread_count)
+{
+    auto engine_ptr = make_uring_engine(queue_depth);
+    if (!engine_ptr) {
+        engine_ptr = make_thread_pool_engine(thread_count, queue_depth);
+    }
+    return engine_ptr;
+}
+
+}
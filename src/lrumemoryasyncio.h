@@ -0,0 +1,68 @@
+#ifndef LRU_MEMORY_ASYNCIO__H
+#define LRU_MEMORY_ASYNCIO__H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace lrumm {
+
+/**
+ * @brief Completion of one asynchronous read or write
+ */
+struct LRUIOCompletion {
+    uint64_t tag;    ///< Tag passed at submission
+    int64_t result;  ///< Bytes transferred, or -errno
+};
+
+/**
+ * @brief Asynchronous positional file I/O for the storage tiers
+ *
+ * Requests are submitted and completions reaped by one thread, the owner of the
+ * manager. A request completes only when all of its bytes were transferred, when
+ * it fails, or at the end of the file. A request the engine fails to start
+ * completes with -errno as well.
+ */
+class LRUIOEngine {
+public:
+    virtual ~LRUIOEngine() = default;
+
+    virtual const char* name() const = 0;
+
+    /**
+     * @brief Queues a read, false when queue_depth requests are in flight
+     */
+    virtual bool submit_read(int fd, void* buffer_ptr, size_t size, uint64_t offset, uint64_t tag) = 0;
+
+    /**
+     * @brief Queues a write, false when queue_depth requests are in flight
+     */
+    virtual bool submit_write(int fd, const void* buffer_ptr, size_t size, uint64_t offset, uint64_t tag) = 0;
+
+    /**
+     * @brief Reaps up to max_count completions, waiting until min_count are available
+     *
+     * Waits for no more completions than there are requests in flight.
+     */
+    virtual size_t poll(LRUIOCompletion* completions_ptr, size_t max_count, size_t min_count) = 0;
+
+    virtual size_t in_flight() const = 0;
+};
+
+/**
+ * @brief io_uring engine on raw system calls, nullptr when the kernel refuses io_uring
+ */
+std::unique_ptr<LRUIOEngine> make_uring_engine(unsigned queue_depth = 64);
+
+/**
+ * @brief Portable engine: worker threads run pread and pwrite
+ */
+std::unique_ptr<LRUIOEngine> make_thread_pool_engine(unsigned thread_count = 4, unsigned queue_depth = 64);
+
+/**
+ * @brief io_uring when available, the thread pool otherwise
+ */
+std::unique_ptr<LRUIOEngine> make_io_engine(unsigned queue_depth = 64, unsigned thread_count = 4);
+
+}
+#endif // LRU_MEMORY_ASYNCIO__H
@@ -0,0 +1,285 @@
+#include <algorithm>
+#include <cstring>
+
+#include "lrumemorycodec.h"
+
+namespace lrumm {
+
+static constexpr unsigned HASH_BITS = 12;
+static constexpr size_t MIN_MATCH = 4;
+static constexpr size_t MAX_OFFSET = 65535;
+static constexpr unsigned SKIP_SHIFT = 6; ///< Misses in a row before the search starts skipping bytes
+static constexpr uint8_t LENGTH_NIBBLE = 15;
+
+static constexpr uint64_t HASH_PRIME1 = 0x9E3779B185EBCA87ull;
+static constexpr uint64_t HASH_PRIME2 = 0xC2B2AE3D27D4EB4Full;
+static constexpr uint64_t HASH_PRIME3 = 0x165667B19E3779F9ull;
+static constexpr uint64_t HASH_PRIME4 = 0x85EBCA77C2B2AE63ull;
+static constexpr uint64_t HASH_PRIME5 = 0x27D4EB2F165667C5ull;
+
+namespace {
+
+uint32_t
+read32(const uint8_t* ptr)
+{
+    uint32_t value;
+    std::memcpy(&value, ptr, sizeof(value));
+    return value;
+}
+
+uint64_t
+read64(const uint8_t* ptr)
+{
+    uint64_t value;
+    std::memcpy(&value, ptr, sizeof(value));
+    return value;
+}
+
+uint64_t
+rotl64(uint64_t value, unsigned bits)
+{
+    return (value << bits) | (value >> (64 - bits));
+}
+
+uint64_t
+hash_round(uint64_t acc, uint64_t input)
+{
+    return rotl64(acc + input * HASH_PRIME2, 31) * HASH_PRIME1;
+}
+
+uint64_t
+hash_merge(uint64_t acc, uint64_t lane)
+{
+    return (acc ^ hash_round(0, lane)) * HASH_PRIME1 + HASH_PRIME4;
+}
+
+uint32_t
+hash4(uint32_t value)
+{
+    return (value * 2654435761u) >> (32 - HASH_BITS);
+}
+
+/**
+ * @brief Bounds-checked output of the compressor
+ */
+class TokenWriter {
+public:
+    TokenWriter(uint8_t* dst_ptr, size_t capacity)
+        : dst_ptr_(dst_ptr), capacity_(capacity) {}
+
+    size_t size() const { return size_; }
+
+    /**
+     * @brief Writes literals followed by a match, match_length 0 for the last token
+     */
+    bool write_token(const uint8_t* literal_ptr, size_t literal_length, size_t offset, size_t match_length)
+    {
+        size_t match_code = match_length ? match_length - MIN_MATCH : 0;
+        uint8_t token = static_cast<uint8_t>((std::min<size_t>(literal_length, LENGTH_NIBBLE) << 4)
+            | std::min<size_t>(match_code, LENGTH_NIBBLE));
+        if (!put(token) || !put_length(literal_length) || !put_bytes(literal_ptr, literal_length)) {
+            return false;
+        }
+        if (match_length == 0) {
+            return true;
+        }
+        return put(static_cast<uint8_t>(offset)) && put(static_cast<uint8_t>(offset >> 8)) && put_length(match_code);
+    }
+
+private:
+    bool put(uint8_t value)
+    {
+        if (size_ == capacity_) {
+            return false;
+        }
+        dst_ptr_[size_++] = value;
+        return true;
+    }
+
+    bool put_length(size_t length)
+    {
+        // Lengths that do not fit the token nibble continue in 255 steps
+        if (length < LENGTH_NIBBLE) {
+            return true;
+        }
+        length -= LENGTH_NIBBLE;
+        for (; length >= 255; length -= 255) {
+            if (!put(255)) {
+                return false;
+            }
+        }
+        return put(static_cast<uint8_t>(length));
+    }
+
+    bool put_bytes(const uint8_t* src_ptr, size_t length)
+    {
+        if (capacity_ - size_ < length) {
+            return false;
+        }
+        std::memcpy(dst_ptr_ + size_, src_ptr, length);
+        size_ += length;
+        return true;
+    }
+
+    uint8_t* dst_ptr_;
+    size_t capacity_;
+    size_t size_ = 0;
+};
+
+bool
+read_length(const uint8_t* src_ptr, size_t size, size_t& pos, size_t& length)
+{
+    uint8_t value;
+    do {
+        if (pos == size) {
+            return false;
+        }
+        value = src_ptr[pos++];
+        length += value;
+    } while (value == 255);
+    return true;
+}
+
+}
+
+size_t
+lz_compress(const void* src_ptr, size_t size, void* dst_ptr, size_t dst_capacity)
+{
+    const uint8_t* src = static_cast<const uint8_t*>(src_ptr);
+    TokenWriter writer(static_cast<uint8_t*>(dst_ptr), dst_capacity);
+
+    // Positions + 1 of the last 4-byte sequences seen per hash, 0 when empty
+    uint32_t table[1u << HASH_BITS] = {};
+    size_t anchor = 0;
+    size_t pos = 0;
+
+    while (pos + MIN_MATCH <= size) {
+        uint32_t sequence = read32(src + pos);
+        uint32_t& slot = table[hash4(sequence)];
+        size_t candidate = slot;
+        slot = static_cast<uint32_t>(pos + 1);
+
+        if (candidate == 0 || pos - (candidate - 1) > MAX_OFFSET || read32(src + candidate - 1) != sequence) {
+            // Step faster through data that does not match
+            pos += 1 + ((pos - anchor) >> SKIP_SHIFT);
+            continue;
+        }
+        candidate--;
+
+        size_t match_length = MIN_MATCH;
+        while (pos + match_length < size && src[candidate + match_length] == src[pos + match_length]) {
+            match_length++;
+        }
+        if (!writer.write_token(src + anchor, pos - anchor, pos - candidate, match_length)) {
+            return 0;
+        }
+        pos += match_length;
+        anchor = pos;
+    }
+
+    if (!writer.write_token(src + anchor, size - anchor, 0, 0)) {
+        return 0;
+    }
+    return writer.size();
+}
+
+uint64_t
+hash_bytes(const void* data_ptr, size_t size)
+{
+    const uint8_t* ptr = static_cast<const uint8_t*>(data_ptr);
+    const uint8_t* end_ptr = ptr + size;
+    uint64_t acc;
+
+    if (size >= 32) {
+        uint64_t lanes[4] = { HASH_PRIME1 + HASH_PRIME2, HASH_PRIME2, 0, 0 - HASH_PRIME1 };
+        for (; end_ptr - ptr >= 32; ptr += 32) {
+            for (unsigned lane = 0; lane < 4; ++lane) {
+                lanes[lane] = hash_round(lanes[lane], read64(ptr + lane * 8));
+            }
+        }
+        acc = rotl64(lanes[0], 1) + rotl64(lanes[1], 7) + rotl64(lanes[2], 12) + rotl64(lanes[3], 18);
+        for (uint64_t lane : lanes) {
+            acc = hash_merge(acc, lane);
+        }
+    } else {
+        acc = HASH_PRIME5;
+    }
+    acc += size;
+
+    // Tail shorter than a step
+    for (; end_ptr - ptr >= 8; ptr += 8) {
+        acc = rotl64(acc ^ hash_round(0, read64(ptr)), 27) * HASH_PRIME1 + HASH_PRIME4;
+    }
+    if (end_ptr - ptr >= 4) {
+        acc = rotl64(acc ^ (read32(ptr) * HASH_PRIME1), 23) * HASH_PRIME2 + HASH_PRIME3;
+        ptr += 4;
+    }
+    for (; ptr < end_ptr; ++ptr) {
+        acc = rotl64(acc ^ (*ptr * HASH_PRIME5), 11) * HASH_PRIME1;
+    }
+
+    // Final avalanche
+    acc ^= acc >> 33;
+    acc *= HASH_PRIME2;
+    acc ^= acc >> 29;
+    acc *= HASH_PRIME3;
+    acc ^= acc >> 32;
+    return acc;
+}
+
+bool
+lz_decompress(const void* src_ptr, size_t size, void* dst_ptr, size_t dst_size)
+{
+    const uint8_t* src = static_cast<const uint8_t*>(src_ptr);
+    uint8_t* dst = static_cast<uint8_t*>(dst_ptr);
+    size_t in = 0;
+    size_t out = 0;
+
+    while (in < size) {
+        uint8_t token = src[in++];
+
+        size_t literal_length = token >> 4;
+        if (literal_length == LENGTH_NIBBLE && !read_length(src, size, in, literal_length)) {
+            return false;
+        }
+        if (size - in < literal_length || dst_size - out < literal_length) {
+            return false;
+        }
+        std::memcpy(dst + out, src + in, literal_length);
+        in += literal_length;
+        out += literal_length;
+
+        if (in == size) {
+            break; // the last token has no match
+        }
+
+        if (size - in < 2) {
+            return false;
+        }
+        size_t offset = src[in] | (static_cast<size_t>(src[in + 1]) << 8);
+        in += 2;
+        size_t match_length = token & LENGTH_NIBBLE;
+        if (match_length == LENGTH_NIBBLE && !read_length(src, size, in, match_length)) {
+            return false;
+        }
+        match_length += MIN_MATCH;
+        if (offset == 0 || offset > out || dst_size - out < match_length) {
+            return false;
+        }
+
+        // Overlapping matches repeat the bytes just written
+        const uint8_t* match_ptr = dst + out - offset;
+        if (offset >= match_length) {
+            std::memcpy(dst + out, match_ptr, match_length);
+        } else {
+            for (size_t i = 0; i < match_length; ++i) {
+                dst[out + i] = match_ptr[i];
+            }
+        }
+        out += match_length;
+    }
+
+    return out == dst_size;
+}
+
+}
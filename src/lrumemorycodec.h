@@ -0,0 +1,34 @@
+#ifndef LRU_MEMORY_CODEC__H
+#define LRU_MEMORY_CODEC__H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace lrumm {
+
+/**
+ * @brief Compresses size bytes with a byte-oriented LZ77 codec
+ *
+ * The output is a sequence of tokens, each a run of literals followed by a match
+ * of at least 4 bytes within the previous 64 KiB (the last token has no match).
+ * Returns the compressed size, or 0 when the output would exceed dst_capacity,
+ * so a capacity below size rejects the input unless it compresses.
+ */
+size_t lz_compress(const void* src_ptr, size_t size, void* dst_ptr, size_t dst_capacity);
+
+/**
+ * @brief Decompresses exactly dst_size bytes, false when the input is malformed
+ */
+bool lz_decompress(const void* src_ptr, size_t size, void* dst_ptr, size_t dst_size);
+
+/**
+ * @brief 64-bit content hash for deduplication, not cryptographic
+ *
+ * Four independent multiply-rotate lanes consume 32 bytes per step, so the
+ * multiplications of one step do not wait on each other. The lanes are plain
+ * scalar code.
+ */
+uint64_t hash_bytes(const void* data_ptr, size_t size);
+
+}
+#endif // LRU_MEMORY_CODEC__H
@@ -0,0 +1,178 @@
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+
+#include "lrumemorymanager.h"
+#include "lrumemoryexport.h"
+
+namespace lrumm {
+
+namespace {
+
+// Appends formatted text with snprintf semantics: the length keeps counting past the end of the buffer
+class BufferWriter {
+public:
+    BufferWriter(char* buffer_ptr, size_t buffer_size)
+        : buffer_ptr_(buffer_ptr)
+        , buffer_size_(buffer_size)
+        , length_(0)
+    {
+        if (buffer_size_ > 0) {
+            buffer_ptr_[0] = '\0';
+        }
+    }
+
+    void append(const char* format, ...)
+    {
+        char* output_ptr = length_ < buffer_size_ ? buffer_ptr_ + length_ : nullptr;
+        size_t output_size = length_ < buffer_size_ ? buffer_size_ - length_ : 0;
+
+        std::va_list args;
+        va_start(args, format);
+        int written = std::vsnprintf(output_ptr, output_size, format, args);
+        va_end(args);
+
+        if (written > 0) {
+            length_ += static_cast<size_t>(written);
+        }
+    }
+
+    size_t length() const { return length_; }
+
+private:
+    char* buffer_ptr_;
+    size_t buffer_size_;
+    size_t length_;
+};
+
+struct CounterField {
+    const char* name;
+    uint64_t LRUMemoryStats::*field_ptr;
+};
+
+const CounterField COUNTER_FIELDS[] = {
+    { "hits", &LRUMemoryStats::hits },
+    { "misses", &LRUMemoryStats::misses },
+    { "allocs", &LRUMemoryStats::allocs },
+    { "frees", &LRUMemoryStats::frees },
+    { "evictions", &LRUMemoryStats::evictions },
+    { "evictions_fragmentation", &LRUMemoryStats::evictions_fragmentation },
+    { "evictions_capacity", &LRUMemoryStats::evictions_capacity },
+    { "evicted_bytes", &LRUMemoryStats::evicted_bytes },
+    { "failed_allocs", &LRUMemoryStats::failed_allocs },
+    { "hunks_scanned", &LRUMemoryStats::hunks_scanned },
+    { "tier_stores", &LRUMemoryStats::tier_stores },
+    { "tier_stored_bytes", &LRUMemoryStats::tier_stored_bytes },
+    { "tier_loads", &LRUMemoryStats::tier_loads },
+    { "seals", &LRUMemoryStats::seals },
+    { "seal_shares", &LRUMemoryStats::seal_shares },
+    { "seal_shared_bytes", &LRUMemoryStats::seal_shared_bytes },
+    { "large_allocs", &LRUMemoryStats::large_allocs },
+    { "large_evictions", &LRUMemoryStats::large_evictions },
+    { "pool_shrinks", &LRUMemoryStats::pool_shrinks },
+    { "pool_grows", &LRUMemoryStats::pool_grows },
+    { "relinks_skipped", &LRUMemoryStats::relinks_skipped },
+};
+
+struct LatencyField {
+    const char* name;
+    LRULatencySummary LRUMemoryStats::*field_ptr;
+};
+
+const LatencyField LATENCY_FIELDS[] = {
+    { "alloc_latency_ns", &LRUMemoryStats::alloc_latency },
+    { "free_latency_ns", &LRUMemoryStats::free_latency },
+    { "refresh_latency_ns", &LRUMemoryStats::refresh_latency },
+    { "eviction_latency_ns", &LRUMemoryStats::eviction_latency },
+    { "evictions_per_alloc", &LRUMemoryStats::evictions_per_alloc },
+};
+
+unsigned long long
+to_ull(uint64_t value)
+{
+    return static_cast<unsigned long long>(value);
+}
+
+void
+write_json(BufferWriter& writer, const LRUMemoryStats& stats, size_t pool_size, size_t allocated_size)
+{
+    writer.append("{\"stats_enabled\":%s,\"latency_enabled\":%s,\"pool_size\":%zu,\"allocated_size\":%zu,"
+        "\"peak_allocated_size\":%llu", LRUMM_ENABLE_STATS ? "true" : "false",
+        LRUMM_ENABLE_LATENCY ? "true" : "false", pool_size, allocated_size, to_ull(stats.peak_allocated_size));
+
+    for (const auto& counter : COUNTER_FIELDS) {
+        writer.append(",\"%s\":%llu", counter.name, to_ull(stats.*counter.field_ptr));
+    }
+    writer.append(",\"hit_ratio\":%.6f,\"free_bytes\":%llu,\"free_gap_count\":%llu,\"largest_free_gap\":%llu,"
+        "\"external_fragmentation\":%.6f", stats.hit_ratio(), to_ull(stats.free_bytes), to_ull(stats.free_gap_count),
+        to_ull(stats.largest_free_gap), stats.external_fragmentation());
+
+    writer.append(",\"gap_histogram\":[");
+    for (size_t i = 0; i < stats.gap_histogram.size(); ++i) {
+        writer.append(i ? ",%llu" : "%llu", to_ull(stats.gap_histogram[i]));
+    }
+    writer.append("]");
+
+    for (const auto& latency : LATENCY_FIELDS) {
+        const LRULatencySummary& summary = stats.*latency.field_ptr;
+        writer.append(",\"%s\":{\"samples\":%llu,\"p50\":%llu,\"p99\":%llu,\"p999\":%llu,\"max\":%llu}", latency.name,
+            to_ull(summary.samples), to_ull(summary.p50), to_ull(summary.p99), to_ull(summary.p999), to_ull(summary.max));
+    }
+    writer.append("}\n");
+}
+
+void
+write_prometheus(BufferWriter& writer, const LRUMemoryStats& stats, size_t pool_size, size_t allocated_size)
+{
+    for (const auto& counter : COUNTER_FIELDS) {
+        writer.append("# TYPE lrumm_%s_total counter\nlrumm_%s_total %llu\n", counter.name, counter.name,
+            to_ull(stats.*counter.field_ptr));
+    }
+
+    const struct {
+        const char* name;
+        uint64_t value;
+    } gauges[] = {
+        { "pool_size_bytes", pool_size },
+        { "allocated_bytes", allocated_size },
+        { "peak_allocated_bytes", stats.peak_allocated_size },
+        { "free_bytes", stats.free_bytes },
+        { "free_gaps", stats.free_gap_count },
+        { "largest_free_gap_bytes", stats.largest_free_gap },
+    };
+    for (const auto& gauge : gauges) {
+        writer.append("# TYPE lrumm_%s gauge\nlrumm_%s %llu\n", gauge.name, gauge.name, to_ull(gauge.value));
+    }
+    writer.append("# TYPE lrumm_hit_ratio gauge\nlrumm_hit_ratio %.6f\n", stats.hit_ratio());
+    writer.append("# TYPE lrumm_external_fragmentation gauge\nlrumm_external_fragmentation %.6f\n",
+        stats.external_fragmentation());
+
+    for (const auto& latency : LATENCY_FIELDS) {
+        const LRULatencySummary& summary = stats.*latency.field_ptr;
+        writer.append("# TYPE lrumm_%s gauge\n", latency.name);
+        writer.append("lrumm_%s{quantile=\"0.5\"} %llu\n", latency.name, to_ull(summary.p50));
+        writer.append("lrumm_%s{quantile=\"0.99\"} %llu\n", latency.name, to_ull(summary.p99));
+        writer.append("lrumm_%s{quantile=\"0.999\"} %llu\n", latency.name, to_ull(summary.p999));
+        writer.append("lrumm_%s{quantile=\"1\"} %llu\n", latency.name, to_ull(summary.max));
+        writer.append("# TYPE lrumm_%s_samples_total counter\nlrumm_%s_samples_total %llu\n", latency.name,
+            latency.name, to_ull(summary.samples));
+    }
+}
+
+}
+
+size_t
+export_stats(const LRUMemoryStats& stats, size_t pool_size, size_t allocated_size, LRUExportFormat format,
+    char* buffer_ptr, size_t buffer_size)
+{
+    Expects(buffer_ptr != nullptr || buffer_size == 0);
+
+    BufferWriter writer(buffer_ptr, buffer_size);
+    switch (format) {
+        case LRUExportFormat::Json: write_json(writer, stats, pool_size, allocated_size); break;
+        case LRUExportFormat::Prometheus: write_prometheus(writer, stats, pool_size, allocated_size); break;
+    }
+    return writer.length();
+}
+
+}
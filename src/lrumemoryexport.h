@@ -0,0 +1,43 @@
+#ifndef LRU_MEMORY_EXPORT__H
+#define LRU_MEMORY_EXPORT__H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "lrumemorystats.h"
+
+namespace lrumm {
+
+enum class LRUExportFormat : uint8_t {
+    Json,       ///< One JSON object
+    Prometheus, ///< Prometheus text exposition format, metrics prefixed with lrumm_
+};
+
+/**
+ * @brief Formats a counters snapshot into the buffer
+ *
+ * Works like snprintf: the output is truncated to buffer_size - 1 characters and
+ * terminated, and the return value is the length of the complete output, so a
+ * result >= buffer_size means the buffer was too small.
+ */
+size_t export_stats(const LRUMemoryStats& stats, size_t pool_size, size_t allocated_size, LRUExportFormat format,
+    char* buffer_ptr, size_t buffer_size);
+
+/**
+ * @brief Position of a chunked hunk walk, see LRUMemoryManager::export_hunks
+ *
+ * The cursor keeps a pointer to the next hunk together with the release epoch of
+ * the manager. The manager logs its latest releases, so the walk resumes at that
+ * hunk, or at the successor it had when it was released, without a rescan. Only
+ * after more releases than the log holds does it rescan for the first hunk at or
+ * after the saved arena offset. Hunks placed behind the cursor are not listed.
+ */
+struct LRUExportCursor {
+    const void* next_hunk_ptr = nullptr; ///< Hunk to resume at, nullptr before the first chunk
+    uint64_t next_offset = 0;            ///< Arena offset of next_hunk_ptr
+    uint64_t release_epoch = 0;          ///< Release epoch of the manager when the cursor was saved
+    bool is_done = false;                ///< The walk reached the end of the pool
+};
+
+}
+#endif // LRU_MEMORY_EXPORT__H
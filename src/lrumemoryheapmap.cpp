@@ -0,0 +1,66 @@
+#include <cstdio>
+#include <cstring>
+
+#include "lrumemorymanager.h"
+#include "lrumemoryheapmap.h"
+
+namespace lrumm {
+
+bool
+read_heap_map(const void* buffer_ptr, size_t buffer_size, LRUHeapMap& heap_map)
+{
+    Expects(buffer_ptr != nullptr || buffer_size == 0);
+
+    LRUHeapMapHeader header;
+    if (buffer_size < sizeof(header)) {
+        LOG_ERROR("Heap map is truncated.\n");
+        return false;
+    }
+    std::memcpy(&header, buffer_ptr, sizeof(header));
+    if (std::memcmp(header.magic, LRUHeapMapHeader::MAGIC, sizeof(header.magic)) != 0
+        || header.version != LRUHeapMapHeader::VERSION || header.range_size != sizeof(LRUHeapMapRange)) {
+        LOG_ERROR("Unsupported heap map format.\n");
+        return false;
+    }
+
+    size_t range_count = buffer_size / sizeof(LRUHeapMapRange);
+    if (header.hunk_count > range_count || header.gap_count > range_count
+        || buffer_size - sizeof(header) < (header.hunk_count + header.gap_count) * sizeof(LRUHeapMapRange)) {
+        LOG_ERROR("Heap map is truncated.\n");
+        return false;
+    }
+
+    const uint8_t* ranges_ptr = static_cast<const uint8_t*>(buffer_ptr) + sizeof(header);
+    heap_map.pool_size = header.pool_size;
+    heap_map.allocated_size = header.allocated_size;
+    heap_map.hunks.resize(header.hunk_count);
+    heap_map.gaps.resize(header.gap_count);
+    std::memcpy(heap_map.hunks.data(), ranges_ptr, header.hunk_count * sizeof(LRUHeapMapRange));
+    std::memcpy(heap_map.gaps.data(), ranges_ptr + header.hunk_count * sizeof(LRUHeapMapRange),
+        header.gap_count * sizeof(LRUHeapMapRange));
+    return true;
+}
+
+bool
+read_heap_map(const char* path, LRUHeapMap& heap_map)
+{
+    Expects(path != nullptr);
+
+    std::FILE* file_ptr = std::fopen(path, "rb");
+    if (!file_ptr) {
+        LOG_ERROR("Failed to open heap map file %s.\n", path);
+        return false;
+    }
+
+    std::vector<uint8_t> buffer;
+    uint8_t chunk[64 * 1024];
+    size_t read_size;
+    while ((read_size = std::fread(chunk, 1, sizeof(chunk), file_ptr)) > 0) {
+        buffer.insert(buffer.end(), chunk, chunk + read_size);
+    }
+    std::fclose(file_ptr);
+
+    return read_heap_map(buffer.data(), buffer.size(), heap_map);
+}
+
+}
@@ -0,0 +1,62 @@
+#ifndef LRU_MEMORY_HEAPMAP__H
+#define LRU_MEMORY_HEAPMAP__H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace lrumm {
+
+/**
+ * @brief Header of a binary heap map snapshot
+ *
+ * The header is followed by hunk_count ranges of the allocated hunks in recency
+ * order (most recent first, so the index of a range is its recency rank) and then
+ * gap_count ranges of the free gaps in address order. Offsets are relative to the
+ * start of the arena; the sentinel hunk at offset 0 is not listed.
+ */
+struct LRUHeapMapHeader {
+    static constexpr char MAGIC[8] = { 'L', 'R', 'U', 'H', 'E', 'A', 'P', 'M' };
+    static constexpr uint32_t VERSION = 1;
+
+    char magic[8];
+    uint32_t version;
+    uint32_t range_size;
+    uint64_t pool_size;
+    uint64_t allocated_size;
+    uint64_t hunk_count;
+    uint64_t gap_count;
+};
+static_assert(sizeof(LRUHeapMapHeader) == 48, "LRUHeapMapHeader must stay 48 bytes");
+
+/**
+ * @brief One hunk or free gap of a heap map, sizes include the hunk header
+ */
+struct LRUHeapMapRange {
+    uint64_t offset;
+    uint64_t size;
+};
+static_assert(sizeof(LRUHeapMapRange) == 16, "LRUHeapMapRange must stay 16 bytes");
+
+/**
+ * @brief Decoded heap map snapshot
+ */
+struct LRUHeapMap {
+    uint64_t pool_size = 0;
+    uint64_t allocated_size = 0;
+    std::vector<LRUHeapMapRange> hunks; ///< Most recent first
+    std::vector<LRUHeapMapRange> gaps;  ///< Address order
+};
+
+/**
+ * @brief Decodes a snapshot written by LRUMemoryManager::write_heap_map
+ */
+bool read_heap_map(const void* buffer_ptr, size_t buffer_size, LRUHeapMap& heap_map);
+
+/**
+ * @brief Reads a snapshot file written by LRUMemoryManager::write_heap_map
+ */
+bool read_heap_map(const char* path, LRUHeapMap& heap_map);
+
+}
+#endif // LRU_MEMORY_HEAPMAP__H
@@ -0,0 +1,280 @@
+#ifndef LRU_MEMORY_HISTOGRAM__H
+#define LRU_MEMORY_HISTOGRAM__H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <map>
+
+#include "lrumemorystats.h"
+
+#ifndef LRUMM_ENABLE_LATENCY
+#define LRUMM_ENABLE_LATENCY 0
+#endif
+
+#ifndef LRUMM_LATENCY_SAMPLE_PERIOD
+#define LRUMM_LATENCY_SAMPLE_PERIOD 256
+#endif
+
+namespace lrumm {
+
+/**
+ * @brief HDR-style histogram with logarithmic buckets
+ *
+ * Each power of two range is split into 2^SUB_BUCKET_BITS linear sub-buckets,
+ * so any recorded value is reported with a relative error below 1/2^SUB_BUCKET_BITS.
+ * Values below 2^SUB_BUCKET_BITS are kept exactly.
+ */
+class LRULogHistogram {
+public:
+    static constexpr unsigned SUB_BUCKET_BITS = 3;
+    static constexpr size_t SUB_BUCKET_COUNT = size_t(1) << SUB_BUCKET_BITS;
+    static constexpr size_t BUCKET_COUNT = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT;
+
+    void record(uint64_t value)
+    {
+        buckets_[bucket_index(value)] += 1;
+        count_ += 1;
+        if (value > max_) {
+            max_ = value;
+        }
+    }
+
+    uint64_t count() const { return count_; }
+    uint64_t max() const { return max_; }
+    uint64_t bucket_value(size_t index) const { return buckets_[index]; }
+
+    /**
+     * @brief Highest value equivalent to the given percentile (0..100) of the recorded values
+     */
+    uint64_t value_at_percentile(double percentile) const
+    {
+        uint64_t total = count_;
+        if (total == 0) {
+            return 0;
+        }
+
+        auto target = static_cast<uint64_t>(percentile / 100.0 * static_cast<double>(total) + 0.5);
+        target = target == 0 ? 1 : (target > total ? total : target);
+
+        uint64_t cumulative = 0;
+        for (size_t index = 0; index < BUCKET_COUNT; ++index) {
+            cumulative += buckets_[index];
+            if (cumulative >= target) {
+                uint64_t upper = bucket_upper_bound(index);
+                uint64_t max_value = max_;
+                return upper < max_value ? upper : max_value;
+            }
+        }
+        return max_;
+    }
+
+    void merge(const LRULogHistogram& other)
+    {
+        for (size_t index = 0; index < BUCKET_COUNT; ++index) {
+            buckets_[index] += other.buckets_[index];
+        }
+        count_ += other.count_;
+        uint64_t other_max = other.max_;
+        if (other_max > max_) {
+            max_ = other_max;
+        }
+    }
+
+    void reset()
+    {
+        for (auto& bucket : buckets_) {
+            bucket = 0;
+        }
+        count_ = 0;
+        max_ = 0;
+    }
+
+    static size_t bucket_index(uint64_t value)
+    {
+        if (value < SUB_BUCKET_COUNT) {
+            return static_cast<size_t>(value);
+        }
+        unsigned msb = 63 - static_cast<unsigned>(__builtin_clzll(value));
+        unsigned shift = msb - SUB_BUCKET_BITS;
+        return (shift + 1) * SUB_BUCKET_COUNT + ((value >> shift) & (SUB_BUCKET_COUNT - 1));
+    }
+
+    static uint64_t bucket_lower_bound(size_t index)
+    {
+        if (index < SUB_BUCKET_COUNT) {
+            return index;
+        }
+        size_t shift = index / SUB_BUCKET_COUNT - 1;
+        return (SUB_BUCKET_COUNT + index % SUB_BUCKET_COUNT) << shift;
+    }
+
+    static uint64_t bucket_upper_bound(size_t index)
+    {
+        if (index < SUB_BUCKET_COUNT) {
+            return index;
+        }
+        size_t shift = index / SUB_BUCKET_COUNT - 1;
+        return bucket_lower_bound(index) + ((uint64_t(1) << shift) - 1);
+    }
+
+private:
+    std::array<detail::StatsCounter, BUCKET_COUNT> buckets_{};
+    detail::StatsCounter count_{};
+    detail::StatsCounter max_{};
+};
+
+namespace detail {
+
+inline
+uint64_t
+now_ns()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000u + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+inline
+LRULatencySummary
+summarize(const LRULogHistogram& histogram)
+{
+    LRULatencySummary summary;
+    summary.samples = histogram.count();
+    summary.p50 = histogram.value_at_percentile(50.0);
+    summary.p99 = histogram.value_at_percentile(99.0);
+    summary.p999 = histogram.value_at_percentile(99.9);
+    summary.max = histogram.max();
+    return summary;
+}
+
+/**
+ * @brief Incrementally maintained histogram of the free gaps of a pool
+ *
+ * Gaps are added and removed as hunks are placed and released, so the gap
+ * count, the histogram and the largest gap are available without walking the pool.
+ * The gap sizes are also counted in an ordered map, which keeps the largest gap
+ * exact at O(log gaps) per change.
+ */
+class GapTracker {
+public:
+    void add(size_t gap_size)
+    {
+        if (gap_size == 0) {
+            return;
+        }
+        size_t index = LRULogHistogram::bucket_index(gap_size);
+        buckets_[index] += 1;
+        gap_count_ += 1;
+        if (index > highest_index_) {
+            highest_index_ = index;
+        }
+        gap_sizes_[gap_size] += 1;
+    }
+
+    void remove(size_t gap_size)
+    {
+        if (gap_size == 0) {
+            return;
+        }
+        size_t index = LRULogHistogram::bucket_index(gap_size);
+        buckets_[index] -= 1;
+        gap_count_ -= 1;
+
+        // The scan is bounded by the fixed bucket count
+        while (highest_index_ > 0 && buckets_[highest_index_] == 0) {
+            highest_index_--;
+        }
+        auto size_it = gap_sizes_.find(gap_size);
+        if (--size_it->second == 0) {
+            gap_sizes_.erase(size_it);
+        }
+    }
+
+    void snapshot(LRUMemoryStats& stats) const
+    {
+        stats.free_gap_count = gap_count_;
+        stats.largest_free_gap = gap_sizes_.empty() ? 0 : gap_sizes_.rbegin()->first;
+        for (size_t index = 0; index <= highest_index_; ++index) {
+            uint64_t gaps = buckets_[index];
+            if (gaps) {
+                stats.gap_histogram[63 - __builtin_clzll(LRULogHistogram::bucket_lower_bound(index))] += gaps;
+            }
+        }
+    }
+
+private:
+    std::array<StatsCounter, LRULogHistogram::BUCKET_COUNT> buckets_{};
+    StatsCounter gap_count_{};
+    size_t highest_index_ = 0;
+    std::map<size_t, uint64_t> gap_sizes_; ///< Gaps per size, the last one is the largest
+};
+
+enum class LatencyOp {
+    Alloc,
+    Free,
+    Refresh,
+    Count,
+};
+
+/**
+ * @brief Sampled latency histograms of the manager operations
+ *
+ * Only one operation out of sample_period is timed, which keeps the clock reads
+ * off the common path. Each operation counts down on its own, so a periodic mix
+ * of operations cannot starve the histogram of one of them.
+ */
+class LatencyRecorder {
+public:
+    bool sample(LatencyOp op)
+    {
+        uint32_t& countdown = countdowns_[static_cast<size_t>(op)];
+        if (--countdown != 0) {
+            return false;
+        }
+        countdown = sample_period_;
+        return true;
+    }
+
+    void set_sample_period(uint32_t sample_period)
+    {
+        sample_period_ = sample_period > 0 ? sample_period : 1;
+        countdowns_.fill(sample_period_);
+    }
+
+    void snapshot(LRUMemoryStats& stats) const
+    {
+        stats.alloc_latency = summarize(alloc_);
+        stats.free_latency = summarize(free_);
+        stats.refresh_latency = summarize(refresh_);
+        stats.eviction_latency = summarize(eviction_);
+        stats.evictions_per_alloc = summarize(evictions_per_alloc_);
+    }
+
+    void reset()
+    {
+        alloc_.reset();
+        free_.reset();
+        refresh_.reset();
+        eviction_.reset();
+        evictions_per_alloc_.reset();
+    }
+
+    LRULogHistogram alloc_;               ///< Nanoseconds per alloc
+    LRULogHistogram free_;                ///< Nanoseconds per free
+    LRULogHistogram refresh_;             ///< Nanoseconds per get_buffer_and_refresh
+    LRULogHistogram eviction_;            ///< Nanoseconds per alloc that had to evict
+    LRULogHistogram evictions_per_alloc_; ///< Hunks evicted per alloc
+    size_t last_alloc_evictions_ = 0;     ///< Hunks evicted by the latest alloc
+
+private:
+    uint32_t sample_period_ = LRUMM_LATENCY_SAMPLE_PERIOD;
+    std::array<uint32_t, static_cast<size_t>(LatencyOp::Count)> countdowns_ = {
+        LRUMM_LATENCY_SAMPLE_PERIOD, LRUMM_LATENCY_SAMPLE_PERIOD, LRUMM_LATENCY_SAMPLE_PERIOD };
+};
+
+}
+
+}
+#endif // LRU_MEMORY_HISTOGRAM__H
@@ -1,10 +1,24 @@
+#include <algorithm>
+#include <cerrno>
 #include <cstdlib>
 #include <cstdint>
+#include <cstdio>
 #include <new>
 #include <cstring>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
 
 #include <sanitizer/asan_interface.h>
 
+#include "lrumemorycodec.h"
 #include "lrumemorymanager.h"
 
 namespace lrumm {
@@ -20,10 +34,35 @@ struct LRUMemoryManager::LRUMemoryHunk {
     uint8_t data_ptr[];
 };
 
+// A large object is mapped with its header at the end of the first page, the payload starts on the second
+static size_t
+large_mapping_size(size_t hunk_size)
+{
+    constexpr size_t page_mask = LRUMemoryManager::DIRECT_IO_ALIGNMENT - 1;
+    return LRUMemoryManager::DIRECT_IO_ALIGNMENT
+        + ((hunk_size - sizeof(LRUMemoryManager::LRUMemoryHunk) + page_mask) & ~page_mask);
+}
+
+// A few nanoseconds, at the resolution of the scheduler tick
+static uint64_t
+coarse_now_ms()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000u + static_cast<uint64_t>(ts.tv_nsec) / 1000000u;
+}
+
+static uint8_t*
+large_mapping_start(LRUMemoryManager::LRUMemoryHunk *hunk_ptr)
+{
+    return reinterpret_cast<uint8_t*>(hunk_ptr) + sizeof(LRUMemoryManager::LRUMemoryHunk) - LRUMemoryManager::DIRECT_IO_ALIGNMENT;
+}
+
 LRUMemoryManager::LRUMemoryHandle*
 LRUMemoryManager::LRUMemoryHandle::next() const
 {
     Expects(hunk_ptr_ != nullptr);
+    Expects(!manager_ptr_->is_large_hunk(hunk_ptr_)); // Large objects are not in the address list
     return hunk_ptr_->next_ptr->handler_ptr;
 }
 
@@ -41,15 +80,40 @@ LRUMemoryManager::LRUMemoryHandle::size() const
     return hunk_ptr_->size - sizeof(LRUMemoryHunk);
 }
 
+size_t
+LRUMemoryManager::get_hunk_footprint(size_t size)
+{
+    return (size + sizeof(LRUMemoryHunk) + ALIGNMENT_MASK) & ~ALIGNMENT_MASK;
+}
+
 LRUMemoryManager::LRUMemoryManager(size_t mem_pool_size)
     : mem_total_size_(mem_pool_size)
+    , mem_capacity_size_(mem_pool_size)
     , mem_allocated_size_(0)
     , mem_arena_ptr_(nullptr)
+    , trace_recorder_ptr_(nullptr)
+    , site_profiler_ptr_(nullptr)
+    , tier_ptr_(nullptr)
+    , release_epoch_(0)
+    , release_log_()
+    , interior_gap_count_(0)
+    , is_dedup_enabled_(false)
+    , use_clock_(0)
+    , large_threshold_(0)
+    , large_budget_(0)
+    , large_allocated_size_(0)
+    , large_head_hunk_ptr_(nullptr)
+    , epoch_ops_(0)
+    , epoch_ms_(0)
+    , epoch_(0)
+    , epoch_end_clock_(0)
+    , epoch_end_ms_(0)
 {
     Expects(mem_pool_size > 0);
 
-    mem_arena_ptr_ = std::malloc(mem_total_size_);
-    if (!mem_arena_ptr_) {
+    // Mapped rather than allocated, so pages released on shrink belong to the arena alone
+    mem_arena_ptr_ = ::mmap(nullptr, mem_capacity_size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem_arena_ptr_ == MAP_FAILED) {
         LOG_ERROR("Failed to allocate memory pool of size %zu.\n", mem_pool_size);
         std::abort();
     }
@@ -64,6 +128,14 @@ LRUMemoryManager::LRUMemoryManager(size_t mem_pool_size)
 
     mem_allocated_size_ = sizeof(LRUMemoryHunk);
 
+    // The large object region has a list of its own
+    large_head_hunk_ptr_ = new LRUMemoryHunk();
+    large_head_hunk_ptr_->most_recent_ptr = large_head_hunk_ptr_;
+    large_head_hunk_ptr_->least_recent_ptr = large_head_hunk_ptr_;
+#if LRUMM_ENABLE_STATS
+    gaps_.add(mem_total_size_ - mem_allocated_size_);
+#endif
+
     // Initially, poison the entire buffer as it contains no valid data yet
     void* mem_free_ptr_ = static_cast<uint8_t*>(mem_arena_ptr_) + mem_allocated_size_;
     ASAN_POISON_MEMORY_REGION(mem_free_ptr_, mem_total_size_ - mem_allocated_size_);
@@ -71,25 +143,51 @@ LRUMemoryManager::LRUMemoryManager(size_t mem_pool_size)
 
 LRUMemoryManager::~LRUMemoryManager() noexcept
 {
+    LRUMemoryHunk* hunk_ptr = large_head_hunk_ptr_->least_recent_ptr;
+    while (hunk_ptr != large_head_hunk_ptr_) {
+        LRUMemoryHunk* next_hunk_ptr = hunk_ptr->least_recent_ptr;
+        ::munmap(large_mapping_start(hunk_ptr), large_mapping_size(hunk_ptr->size));
+        hunk_ptr = next_hunk_ptr;
+    }
+    delete large_head_hunk_ptr_;
+
     // Unpoison before deallocation to avoid false positives during potential internal checks
-    ASAN_UNPOISON_MEMORY_REGION(mem_arena_ptr_, mem_total_size_);
-    std::free(mem_arena_ptr_);
+    ASAN_UNPOISON_MEMORY_REGION(mem_arena_ptr_, mem_capacity_size_);
+    ::munmap(mem_arena_ptr_, mem_capacity_size_);
 }
 
 void
 LRUMemoryManager::flush()
 {
-    LRUMemoryHunk* head_hunk_ptr = get_head_hunk();
+    auto release = [this](LRUMemoryHunk* hunk_ptr) {
+        LRUMM_STAT_ADD(stats_, frees, 1);
+        if (trace_recorder_ptr_) {
+            trace_recorder_ptr_->record(LRUTraceOp::Free, hunk_ptr->handler_ptr, hunk_ptr->size - sizeof(LRUMemoryHunk));
+        }
+        if (hunk_ptr->handler_ptr->site_index_) {
+            release_site(hunk_ptr->handler_ptr, false);
+        }
+        real_free(hunk_ptr->handler_ptr);
+    };
 
     // Keep removing the first allocated hunk until only the head remains
+    LRUMemoryHunk* head_hunk_ptr = get_head_hunk();
     while(head_hunk_ptr->next_ptr != head_hunk_ptr) {
-        real_free(head_hunk_ptr->next_ptr->handler_ptr);
+        release(head_hunk_ptr->next_ptr);
+    }
+    while (large_head_hunk_ptr_->least_recent_ptr != large_head_hunk_ptr_) {
+        release(large_head_hunk_ptr_->least_recent_ptr);
     }
 }
 
 LRUMemoryManager::LRUMemoryHunk*
-LRUMemoryManager::try_alloc(size_t size)
+LRUMemoryManager::try_alloc(size_t size, size_t alignment)
 {
+    // Bytes to skip at a free position so that the payload lands on the alignment
+    auto lead_size = [alignment](const uint8_t* position) -> size_t {
+        return alignment ? (0 - (reinterpret_cast<uintptr_t>(position) + sizeof(LRUMemoryHunk))) & (alignment - 1) : 0;
+    };
+
     LRUMemoryHunk *next_hunk_ptr, *current_hunk_ptr;
     LRUMemoryHunk* head_hunk_ptr = get_head_hunk();
 
@@ -97,17 +195,35 @@ LRUMemoryManager::try_alloc(size_t size)
     current_hunk_ptr = head_hunk_ptr;
     next_hunk_ptr = head_hunk_ptr->next_ptr;
 
-    do {
+    if (interior_gap_count_ == 0) {
+        // Hunks are packed, the first fit can only be at the end of the pool
+        LRUMM_STAT_ADD(stats_, hunks_scanned, 1);
+        next_hunk_ptr = head_hunk_ptr;
+    }
+
+    while (next_hunk_ptr != head_hunk_ptr) {
+        LRUMM_STAT_ADD(stats_, hunks_scanned, 1);
+
         // Calculate available space between current and next hunks
         uint8_t* current_end = reinterpret_cast<uint8_t*>(current_hunk_ptr) + current_hunk_ptr->size;
         uint8_t* next_start = reinterpret_cast<uint8_t*>(next_hunk_ptr);
+        uint8_t* hunk_start = current_end + lead_size(current_end);
+
+        if (next_start >= hunk_start + size) {
+#if LRUMM_ENABLE_STATS
+            gaps_.remove(next_start - current_end);
+            gaps_.add(hunk_start - current_end);
+            gaps_.add(next_start - hunk_start - size);
+#endif
+            // The gap splits around the hunk, or is filled completely
+            interior_gap_count_ += (hunk_start > current_end) + (next_start > hunk_start + size);
+            interior_gap_count_--;
 
-        if (next_start >= current_end + size) {
             // Unpoison the space before allocate it
-            ASAN_UNPOISON_MEMORY_REGION(current_end, size);
+            ASAN_UNPOISON_MEMORY_REGION(hunk_start, size);
 
             // Free space found, allocate new hunk here
-            LRUMemoryHunk* new_hunk_ptr = new (current_end) LRUMemoryHunk;
+            LRUMemoryHunk* new_hunk_ptr = new (hunk_start) LRUMemoryHunk;
             new_hunk_ptr->size = size;
 
             // Insert into the allocation linked list
@@ -120,24 +236,33 @@ LRUMemoryManager::try_alloc(size_t size)
             link_lru(new_hunk_ptr);
 
             mem_allocated_size_ += size;
+            LRUMM_STAT_PEAK(stats_, mem_allocated_size_);
             return new_hunk_ptr;
         }
 
         // Continue looking
         current_hunk_ptr = next_hunk_ptr;
         next_hunk_ptr = next_hunk_ptr->next_ptr;
-    } while (next_hunk_ptr != head_hunk_ptr);
+    }
 
     // Try to allocate at the end of the memory pool
     uint8_t* pool_end = static_cast<uint8_t*>(mem_arena_ptr_) + mem_total_size_;
     uint8_t* last_hunk_end = reinterpret_cast<uint8_t*>(head_hunk_ptr->prev_ptr) + head_hunk_ptr->prev_ptr->size;
+    uint8_t* hunk_start = last_hunk_end + lead_size(last_hunk_end);
+
+    if (pool_end >= hunk_start + size) {
+#if LRUMM_ENABLE_STATS
+        gaps_.remove(pool_end - last_hunk_end);
+        gaps_.add(hunk_start - last_hunk_end);
+        gaps_.add(pool_end - hunk_start - size);
+#endif
+        interior_gap_count_ += hunk_start > last_hunk_end; // the skipped bytes stay free
 
-    if (pool_end >= last_hunk_end + size) {
         // Unpoison the space before allocate it
-        ASAN_UNPOISON_MEMORY_REGION(last_hunk_end, size);
+        ASAN_UNPOISON_MEMORY_REGION(hunk_start, size);
 
         // Space available at the end
-        LRUMemoryHunk* new_hunk_ptr = new (last_hunk_end) LRUMemoryHunk;
+        LRUMemoryHunk* new_hunk_ptr = new (hunk_start) LRUMemoryHunk;
         new_hunk_ptr->size = size;
 
         // Insert into the allocation linked list
@@ -150,20 +275,195 @@ LRUMemoryManager::try_alloc(size_t size)
         link_lru(new_hunk_ptr);
 
         mem_allocated_size_ += size;
+        LRUMM_STAT_PEAK(stats_, mem_allocated_size_);
         return new_hunk_ptr;
     }
 
     return nullptr;  // Couldn't allocate
 }
 
+LRUMemoryManager::LRUMemoryHunk*
+LRUMemoryManager::try_alloc_large(size_t size)
+{
+    size_t mapping_size = large_mapping_size(size);
+    void* mapping_ptr = ::mmap(nullptr, mapping_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapping_ptr == MAP_FAILED) {
+        LOG_ERROR("Failed to map a large object of size %zu: %s.\n", mapping_size, std::strerror(errno));
+        return nullptr;
+    }
+
+    uint8_t* hunk_start = static_cast<uint8_t*>(mapping_ptr) + DIRECT_IO_ALIGNMENT - sizeof(LRUMemoryHunk);
+    LRUMemoryHunk* new_hunk_ptr = new (hunk_start) LRUMemoryHunk;
+    new_hunk_ptr->size = size;
+    link_lru(new_hunk_ptr);
+
+    large_allocated_size_ += mapping_size;
+    LRUMM_STAT_ADD(stats_, large_allocs, 1);
+    return new_hunk_ptr;
+}
+
+bool
+LRUMemoryManager::is_large_hunk(const LRUMemoryHunk *hunk_ptr) const
+{
+    // Anything outside the arena, one unsigned comparison
+    return reinterpret_cast<uintptr_t>(hunk_ptr) - reinterpret_cast<uintptr_t>(mem_arena_ptr_) >= mem_capacity_size_;
+}
+
+LRUMemoryManager::LRUMemoryHunk*
+LRUMemoryManager::coldest_hunk() const
+{
+    LRUMemoryHunk* head_hunk_ptr = get_head_hunk();
+    LRUMemoryHunk* pool_hunk_ptr = head_hunk_ptr->least_recent_ptr;
+    LRUMemoryHunk* large_hunk_ptr = large_head_hunk_ptr_->least_recent_ptr;
+    if (large_hunk_ptr == large_head_hunk_ptr_) {
+        return pool_hunk_ptr != head_hunk_ptr ? pool_hunk_ptr : nullptr;
+    }
+    if (pool_hunk_ptr == head_hunk_ptr) {
+        return large_hunk_ptr;
+    }
+
+    // The one with less recency per byte goes first: more idle operations times more bytes
+    auto idle_bytes = [this](const LRUMemoryHunk* hunk_ptr) {
+        return static_cast<double>(use_clock_ - hunk_ptr->handler_ptr->last_use_) * static_cast<double>(hunk_ptr->size);
+    };
+    return idle_bytes(large_hunk_ptr) >= idle_bytes(pool_hunk_ptr) ? large_hunk_ptr : pool_hunk_ptr;
+}
+
+uint32_t
+LRUMemoryManager::current_epoch()
+{
+    bool is_due = epoch_ops_ && use_clock_ >= epoch_end_clock_;
+    if (!is_due && epoch_ms_ && (use_clock_ & 63) == 0) {
+        is_due = coarse_now_ms() >= epoch_end_ms_;
+    }
+    if (is_due) {
+        epoch_++;
+        epoch_end_clock_ = use_clock_ + epoch_ops_;
+        epoch_end_ms_ = epoch_ms_ ? coarse_now_ms() + epoch_ms_ : 0;
+    }
+    return epoch_;
+}
+
+void
+LRUMemoryManager::set_recency_epoch(uint32_t epoch_ops, uint32_t epoch_ms)
+{
+    // The hunks moved so far all belong to earlier epochs
+    epoch_ops_ = epoch_ops;
+    epoch_ms_ = epoch_ms;
+    epoch_++;
+    epoch_end_clock_ = use_clock_ + epoch_ops;
+    epoch_end_ms_ = epoch_ms ? coarse_now_ms() + epoch_ms : 0;
+}
+
+void
+LRUMemoryManager::evict(LRUMemoryHunk *hunk_ptr)
+{
+    LRUMemoryHandle* victim_ptr = hunk_ptr->handler_ptr;
+    LRUMM_STAT_ADD(stats_, evicted_bytes, hunk_ptr->size);
+    if (trace_recorder_ptr_) {
+        trace_recorder_ptr_->record(LRUTraceOp::Evict, victim_ptr, hunk_ptr->size - sizeof(LRUMemoryHunk));
+    }
+    if (victim_ptr->site_index_) {
+        release_site(victim_ptr, true);
+    }
+    uint64_t locator = tier_ptr_ ? spill(victim_ptr) : LRUMemoryTier::NO_LOCATOR;
+    if (locator != LRUMemoryTier::NO_LOCATOR && victim_ptr->is_shared()) {
+        spill_references(victim_ptr, locator);
+        return;
+    }
+    real_free(victim_ptr);
+    victim_ptr->tier_locator_ = locator;
+}
+
+void
+LRUMemoryManager::spill_references(LRUMemoryHandle *owner_ptr, uint64_t locator)
+{
+    // One copy in the tier for all the references, they stay linked until a reload seals it again
+    size_t payload_size = owner_ptr->hunk_ptr_->size - sizeof(LRUMemoryHunk);
+    LRUMemoryHandle* sharer_ptr = owner_ptr->next_sharer_ptr_;
+    owner_ptr->prev_sharer_ptr_->next_sharer_ptr_ = sharer_ptr;
+    sharer_ptr->prev_sharer_ptr_ = owner_ptr->prev_sharer_ptr_;
+    owner_ptr->next_sharer_ptr_ = owner_ptr->prev_sharer_ptr_ = owner_ptr;
+    real_free(owner_ptr); // unseals the hunk, the owner alone
+
+    LRUMemoryHandle* first_ptr = sharer_ptr;
+    do {
+        if (trace_recorder_ptr_) {
+            trace_recorder_ptr_->record(LRUTraceOp::Evict, sharer_ptr, payload_size);
+        }
+        sharer_ptr->hunk_ptr_ = nullptr;
+        sharer_ptr->tier_locator_ = locator;
+        sharer_ptr = sharer_ptr->next_sharer_ptr_;
+    } while (sharer_ptr != first_ptr);
+
+    owner_ptr->next_sharer_ptr_ = first_ptr->next_sharer_ptr_;
+    owner_ptr->prev_sharer_ptr_ = first_ptr;
+    first_ptr->next_sharer_ptr_->prev_sharer_ptr_ = owner_ptr;
+    first_ptr->next_sharer_ptr_ = owner_ptr;
+    owner_ptr->tier_locator_ = locator;
+}
+
+void
+LRUMemoryManager::reseal(LRUMemoryHandle *handle_ptr)
+{
+    // The first reload of a shared copy brings the other references back with it
+    LRUMemoryHunk* hunk_ptr = handle_ptr->hunk_ptr_;
+    uint64_t hash = hash_bytes(hunk_ptr->data_ptr, hunk_ptr->size - sizeof(LRUMemoryHunk));
+    uint32_t ref_count = 1;
+    for (LRUMemoryHandle* sharer_ptr = handle_ptr->next_sharer_ptr_; sharer_ptr != handle_ptr;
+         sharer_ptr = sharer_ptr->next_sharer_ptr_) {
+        sharer_ptr->hunk_ptr_ = hunk_ptr;
+        sharer_ptr->tier_locator_ = LRUMemoryTier::NO_LOCATOR;
+        ref_count++;
+    }
+    seal_index_.emplace(hash, hunk_ptr);
+    sealed_hunks_.emplace(hunk_ptr, SealedHunk{ hash, ref_count });
+}
+
+void
+LRUMemoryManager::drop_references(LRUMemoryHandle *handle_ptr)
+{
+    // The shared copy is gone, for every reference
+    LRUMemoryHandle* sharer_ptr = handle_ptr->next_sharer_ptr_;
+    while (sharer_ptr != handle_ptr) {
+        LRUMemoryHandle* next_ptr = sharer_ptr->next_sharer_ptr_;
+        sharer_ptr->next_sharer_ptr_ = sharer_ptr->prev_sharer_ptr_ = nullptr;
+        sharer_ptr->tier_locator_ = LRUMemoryTier::NO_LOCATOR;
+        sharer_ptr = next_ptr;
+    }
+    handle_ptr->next_sharer_ptr_ = handle_ptr->prev_sharer_ptr_ = nullptr;
+}
+
 void*
 LRUMemoryManager::real_get_buffer(LRUMemoryHandle *handle_ptr)
 {
     if (handle_ptr->hunk_ptr_ == nullptr) {
+        LRUMM_STAT_ADD(stats_, misses, 1);
+        if (trace_recorder_ptr_) {
+            trace_recorder_ptr_->record(LRUTraceOp::Refresh, handle_ptr, 0);
+        }
+        return handle_ptr->is_spilled() ? reload(handle_ptr) : nullptr;
+    }
+
+    if (handle_ptr->is_loading() && !complete_load(handle_ptr)) {
+        real_free(handle_ptr);
         return nullptr;
     }
 
     LRUMemoryHunk *hunk_ptr = handle_ptr->hunk_ptr_;
+    LRUMM_STAT_ADD(stats_, hits, 1);
+    if (trace_recorder_ptr_) {
+        trace_recorder_ptr_->record(LRUTraceOp::Refresh, handle_ptr, hunk_ptr->size - sizeof(LRUMemoryHunk));
+    }
+    hunk_ptr->handler_ptr->last_use_ = ++use_clock_;
+    if (epoch_ops_ | epoch_ms_) {
+        uint32_t epoch = current_epoch();
+        if (hunk_ptr->handler_ptr->link_epoch_ == epoch) {
+            LRUMM_STAT_ADD(stats_, relinks_skipped, 1);
+            return hunk_ptr->data_ptr; // already among the most recent of this epoch
+        }
+        hunk_ptr->handler_ptr->link_epoch_ = epoch;
+    }
 
     // Move to top of LRU linked list (most recently used)
     unlink_lru(hunk_ptr);
@@ -173,27 +473,81 @@ LRUMemoryManager::real_get_buffer(LRUMemoryHandle *handle_ptr)
 }
 
 void*
-LRUMemoryManager::real_alloc(LRUMemoryHandle *handle_ptr, size_t size)
+LRUMemoryManager::real_alloc(LRUMemoryHandle *handle_ptr, size_t size, size_t alignment, bool is_evicting)
 {
+    if (trace_recorder_ptr_) {
+        trace_recorder_ptr_->record(LRUTraceOp::Alloc, handle_ptr, size);
+    }
+    if (handle_ptr->is_spilled()) {
+        release_tier(handle_ptr); // the new allocation replaces the kept payload
+    }
+
     // Align size to MEMORY_ALIGNMENT boundary
-    size_t aligned_size = (size + sizeof(LRUMemoryHunk) + ALIGNMENT_MASK) & ~ALIGNMENT_MASK;
+    size_t aligned_size = get_hunk_footprint(size);
+    bool is_large = large_threshold_ && size >= large_threshold_ && alignment <= DIRECT_IO_ALIGNMENT;
+    size_t charged_size = is_large ? large_mapping_size(aligned_size) : aligned_size;
 
     // Try to find and allocate
     LRUMemoryHunk* head_hunk_ptr = get_head_hunk();
+    [[maybe_unused]] size_t evicted_count = 0;
 
     while (true) {
-        LRUMemoryHunk* hunk_ptr = try_alloc(aligned_size);
+        // The regions share one budget; the pool can exceed it only while large objects take more than their own
+        bool is_over_budget = large_threshold_ && (is_large || large_allocated_size_ > large_budget_)
+            && mem_allocated_size_ + large_allocated_size_ + charged_size > mem_total_size_ + large_budget_;
+
+        LRUMemoryHunk* hunk_ptr = nullptr;
+        if (!is_over_budget) {
+            hunk_ptr = is_large ? try_alloc_large(aligned_size) : try_alloc(aligned_size, alignment);
+        }
         if (hunk_ptr) {
             hunk_ptr->handler_ptr = handle_ptr;
             handle_ptr->hunk_ptr_ = hunk_ptr;
+            handle_ptr->manager_ptr_ = this;
+            handle_ptr->last_use_ = ++use_clock_;
+            if (epoch_ops_ | epoch_ms_) {
+                handle_ptr->link_epoch_ = current_epoch();
+            }
+            if (is_dedup_enabled_) {
+                // Equal payloads must be equal up to the end of the hunk to be shared
+                std::memset(hunk_ptr->data_ptr + size, 0, hunk_ptr->size - sizeof(LRUMemoryHunk) - size);
+            }
+            LRUMM_STAT_ADD(stats_, allocs, 1);
+#if LRUMM_ENABLE_LATENCY
+            latency_.last_alloc_evictions_ = evicted_count;
+#endif
             return hunk_ptr->data_ptr;
         }
 
         // If no free space found, try to free the least recently used hunk
-        if (head_hunk_ptr != head_hunk_ptr->least_recent_ptr) {
-            real_free(head_hunk_ptr->least_recent_ptr->handler_ptr);
+        LRUMemoryHunk* victim_hunk_ptr = nullptr;
+        if (!is_evicting) {
+            // Only free space may be used
+        } else if (is_over_budget) {
+            victim_hunk_ptr = coldest_hunk();
+        } else if (!is_large && head_hunk_ptr != head_hunk_ptr->least_recent_ptr) {
+            victim_hunk_ptr = head_hunk_ptr->least_recent_ptr;
+        }
+
+        if (victim_hunk_ptr) {
+            evicted_count++;
+            LRUMM_STAT_ADD(stats_, evictions, 1);
+            if (is_large_hunk(victim_hunk_ptr)) {
+                LRUMM_STAT_ADD(stats_, large_evictions, 1);
+            }
+            if (!is_over_budget && mem_total_size_ - mem_allocated_size_ >= aligned_size) {
+                // Enough free space in total, but no single gap fits
+                LRUMM_STAT_ADD(stats_, evictions_fragmentation, 1);
+            } else {
+                LRUMM_STAT_ADD(stats_, evictions_capacity, 1);
+            }
+            evict(victim_hunk_ptr);
         } else {
             // No more hunks to free, allocation failed
+            LRUMM_STAT_ADD(stats_, failed_allocs, 1);
+#if LRUMM_ENABLE_LATENCY
+            latency_.last_alloc_evictions_ = evicted_count;
+#endif
             return nullptr;
         }
     }
@@ -204,10 +558,31 @@ LRUMemoryManager::real_alloc(LRUMemoryHandle *handle_ptr, size_t size)
 void
 LRUMemoryManager::real_free(LRUMemoryHandle *handle_ptr)
 {
+    if (handle_ptr->is_loading()) {
+        complete_load(handle_ptr); // the read must not land in a released hunk
+    }
+    if (handle_ptr->is_sealed()) {
+        unseal(handle_ptr);
+    }
+
     LRUMemoryHunk* hunk_ptr = handle_ptr->hunk_ptr_;
+    if (is_large_hunk(hunk_ptr)) {
+        unlink_lru(hunk_ptr);
+        size_t mapping_size = large_mapping_size(hunk_ptr->size);
+        large_allocated_size_ -= mapping_size;
+        ::munmap(large_mapping_start(hunk_ptr), mapping_size);
+        handle_ptr->hunk_ptr_ = nullptr;
+        return;
+    }
 
     size_t size = hunk_ptr->size;
 
+#if LRUMM_ENABLE_STATS
+    track_released_gap(hunk_ptr);
+#endif
+    track_interior_gaps(hunk_ptr);
+    release_log_[release_epoch_ % RELEASE_LOG_SIZE] = { hunk_ptr, hunk_ptr->next_ptr };
+
     // Remove from allocation linked list
     hunk_ptr->prev_ptr->next_ptr = hunk_ptr->next_ptr;
     hunk_ptr->next_ptr->prev_ptr = hunk_ptr->prev_ptr;
@@ -224,8 +599,499 @@ LRUMemoryManager::real_free(LRUMemoryHandle *handle_ptr)
 
     hunk_ptr->~LRUMemoryHunk();
     handle_ptr->hunk_ptr_ = nullptr;
+    release_epoch_++;
+}
+
+void
+LRUMemoryManager::release_site(LRUMemoryHandle *handle_ptr, bool is_evicted)
+{
+    // The profiler may have been detached since the allocation was sampled
+    if (site_profiler_ptr_) {
+        site_profiler_ptr_->release(handle_ptr->site_index_, handle_ptr->hunk_ptr_->size, is_evicted);
+    }
+    handle_ptr->site_index_ = 0;
+}
+
+uint64_t
+LRUMemoryManager::spill(LRUMemoryHandle *handle_ptr)
+{
+    if (handle_ptr->is_loading() && !complete_load(handle_ptr)) {
+        return LRUMemoryTier::NO_LOCATOR; // the prefetch failed, the hunk holds no payload
+    }
+
+    LRUMemoryHunk* hunk_ptr = handle_ptr->hunk_ptr_;
+    size_t payload_size = hunk_ptr->size - sizeof(LRUMemoryHunk);
+
+    // Kept by the caller until the hunk is released
+    uint64_t locator = tier_ptr_->store(hunk_ptr->data_ptr, payload_size);
+    if (locator != LRUMemoryTier::NO_LOCATOR) {
+        LRUMM_STAT_ADD(stats_, tier_stores, 1);
+        LRUMM_STAT_ADD(stats_, tier_stored_bytes, payload_size);
+    }
+    return locator;
+}
+
+void*
+LRUMemoryManager::reload(LRUMemoryHandle *handle_ptr)
+{
+    if (!tier_ptr_) {
+        release_tier(handle_ptr); // the tier was detached, the payload is lost
+        return nullptr;
+    }
+    uint64_t locator = handle_ptr->tier_locator_;
+    handle_ptr->tier_locator_ = LRUMemoryTier::NO_LOCATOR;
+
+    // The new hunk may evict and spill other hunks, never this one
+    size_t payload_size = tier_ptr_->stored_size(locator);
+    void* buffer_ptr = real_alloc(handle_ptr, payload_size);
+    if (!buffer_ptr) {
+        handle_ptr->tier_locator_ = locator;
+        release_tier(handle_ptr);
+        return nullptr;
+    }
+    if (!tier_ptr_->load(locator, buffer_ptr, payload_size)) {
+        drop_references(handle_ptr);
+        real_free(handle_ptr);
+        return nullptr;
+    }
+    if (handle_ptr->is_sealed()) {
+        reseal(handle_ptr);
+    }
+    LRUMM_STAT_ADD(stats_, tier_loads, 1);
+    return buffer_ptr;
+}
+
+bool
+LRUMemoryManager::prefetch(LRUMemoryHandle *handle_ptr)
+{
+    Expects(handle_ptr != nullptr);
+    if (!handle_ptr->is_spilled() || !tier_ptr_) {
+        return false;
+    }
+    if (handle_ptr->is_sealed()) {
+        return reload(handle_ptr) != nullptr; // a shared copy is sealed again at once, synchronously
+    }
+
+    uint64_t locator = handle_ptr->tier_locator_;
+    handle_ptr->tier_locator_ = LRUMemoryTier::NO_LOCATOR;
+    size_t payload_size = tier_ptr_->stored_size(locator);
+    void* buffer_ptr = real_alloc(handle_ptr, payload_size);
+    if (!buffer_ptr) {
+        tier_ptr_->release(locator);
+        return false;
+    }
+    LRUMM_STAT_ADD(stats_, tier_loads, 1);
+
+    if (tier_ptr_->start_load(locator, buffer_ptr, payload_size)) {
+        handle_ptr->tier_locator_ = locator; // completed by the next refresh, eviction or free
+        return true;
+    }
+    if (!tier_ptr_->load(locator, buffer_ptr, payload_size)) {
+        real_free(handle_ptr);
+        return false;
+    }
+    return true;
+}
+
+bool
+LRUMemoryManager::complete_load(LRUMemoryHandle *handle_ptr)
+{
+    uint64_t locator = handle_ptr->tier_locator_;
+    handle_ptr->tier_locator_ = LRUMemoryTier::NO_LOCATOR;
+    return tier_ptr_ && tier_ptr_->finish_load(locator);
+}
+
+void*
+LRUMemoryManager::alloc_aligned(LRUMemoryHandle *handle_ptr, size_t size, size_t alignment)
+{
+    Expects(size > 0);
+    Expects(handle_ptr != nullptr);
+    Expects(alignment > 0 && (alignment & (alignment - 1)) == 0);
+
+    return real_alloc(handle_ptr, size, alignment > MEMORY_ALIGNMENT ? alignment : 0);
+}
+
+void*
+LRUMemoryManager::load_from_fd(LRUMemoryHandle *handle_ptr, int fd, uint64_t offset, size_t len, LRUIOEngine *engine_ptr)
+{
+    Expects(len > 0);
+    Expects(handle_ptr != nullptr);
+    Expects(engine_ptr == nullptr || engine_ptr->in_flight() == 0);
+
+    int file_flags = ::fcntl(fd, F_GETFL);
+    if (file_flags < 0) {
+        LOG_ERROR("Failed to load from descriptor %d: %s.\n", fd, std::strerror(errno));
+        return nullptr;
+    }
+
+    // Direct reads transfer whole blocks into block aligned memory
+    bool is_direct = (file_flags & O_DIRECT) != 0;
+    size_t read_size = len;
+    if (is_direct) {
+        if (offset & (DIRECT_IO_ALIGNMENT - 1)) {
+            LOG_ERROR("Failed to load from descriptor %d: offset %llu is not block aligned.\n", fd,
+                static_cast<unsigned long long>(offset));
+            return nullptr;
+        }
+        read_size = (len + DIRECT_IO_ALIGNMENT - 1) & ~(DIRECT_IO_ALIGNMENT - 1);
+    }
+
+    auto* buffer_ptr = static_cast<uint8_t*>(real_alloc(handle_ptr, read_size, is_direct ? DIRECT_IO_ALIGNMENT : 0));
+    if (!buffer_ptr) {
+        return nullptr;
+    }
+
+    size_t read_bytes = 0;
+    if (engine_ptr) {
+        // The engine resubmits partial transfers, one completion ends the read
+        LRUIOCompletion completion = { 0, -EIO };
+        if (engine_ptr->submit_read(fd, buffer_ptr, read_size, offset, 0)) {
+            // The poll blocks, it returns empty only after a failed wait
+            while (engine_ptr->poll(&completion, 1, 1) == 0) {
+                if (engine_ptr->in_flight() == 0) {
+                    completion.result = -EIO; // the read is gone without a completion
+                    break;
+                }
+            }
+        }
+        read_bytes = completion.result > 0 ? static_cast<size_t>(completion.result) : 0;
+    } else {
+        while (read_bytes < read_size) {
+            ssize_t result = ::pread(fd, buffer_ptr + read_bytes, read_size - read_bytes, offset + read_bytes);
+            if (result < 0 && errno == EINTR) {
+                continue;
+            }
+            if (result <= 0) {
+                break;
+            }
+            read_bytes += static_cast<size_t>(result);
+        }
+    }
+
+    if (read_bytes < len) {
+        LOG_ERROR("Failed to load %zu bytes at offset %llu from descriptor %d.\n", len,
+            static_cast<unsigned long long>(offset), fd);
+        real_free(handle_ptr);
+        return nullptr;
+    }
+    return buffer_ptr;
+}
+
+bool
+LRUMemoryManager::resize_in_place(LRUMemoryHandle *handle_ptr, size_t size)
+{
+    Expects(handle_ptr != nullptr && handle_ptr->hunk_ptr_ != nullptr); // LRUMemoryManager::resize_in_place: not allocated.
+    Expects(!handle_ptr->is_sealed() && !handle_ptr->is_loading());
+
+    LRUMemoryHunk* hunk_ptr = handle_ptr->hunk_ptr_;
+    if (is_large_hunk(hunk_ptr)) {
+        // Within the pages mapped already; a shrink unmaps the whole pages it releases
+        size_t new_size = get_hunk_footprint(size);
+        size_t mapping_size = large_mapping_size(hunk_ptr->size);
+        size_t new_mapping_size = large_mapping_size(new_size);
+        if (new_mapping_size > mapping_size) {
+            return false;
+        }
+        if (handle_ptr->site_index_) {
+            release_site(handle_ptr, false);
+        }
+        if (new_mapping_size < mapping_size) {
+            ::munmap(large_mapping_start(hunk_ptr) + new_mapping_size, mapping_size - new_mapping_size);
+            large_allocated_size_ -= mapping_size - new_mapping_size;
+        }
+        hunk_ptr->size = new_size;
+        if (is_dedup_enabled_) {
+            std::memset(hunk_ptr->data_ptr + size, 0, new_size - sizeof(LRUMemoryHunk) - size);
+        }
+        return true;
+    }
+
+    uint8_t* hunk_start = reinterpret_cast<uint8_t*>(hunk_ptr);
+    bool is_last = hunk_ptr->next_ptr == get_head_hunk();
+    uint8_t* next_start = is_last
+        ? static_cast<uint8_t*>(mem_arena_ptr_) + mem_total_size_
+        : reinterpret_cast<uint8_t*>(hunk_ptr->next_ptr);
+
+    size_t new_size = get_hunk_footprint(size);
+    if (new_size > static_cast<size_t>(next_start - hunk_start)) {
+        return false;
+    }
+    if (handle_ptr->site_index_) {
+        release_site(handle_ptr, false); // the sample was taken for the old size
+    }
+
+    size_t gap_before = next_start - (hunk_start + hunk_ptr->size);
+    size_t gap_after = next_start - (hunk_start + new_size);
+#if LRUMM_ENABLE_STATS
+    gaps_.remove(gap_before);
+    gaps_.add(gap_after);
+#endif
+    if (!is_last) {
+        interior_gap_count_ += (gap_after > 0);
+        interior_gap_count_ -= (gap_before > 0);
+    }
+
+    if (new_size > hunk_ptr->size) {
+        ASAN_UNPOISON_MEMORY_REGION(hunk_start + hunk_ptr->size, new_size - hunk_ptr->size);
+    } else {
+        ASAN_POISON_MEMORY_REGION(hunk_start + new_size, hunk_ptr->size - new_size);
+    }
+    mem_allocated_size_ += new_size;
+    mem_allocated_size_ -= hunk_ptr->size;
+    LRUMM_STAT_PEAK(stats_, mem_allocated_size_);
+    hunk_ptr->size = new_size;
+    if (is_dedup_enabled_) {
+        // The padding holds old payload or free space bytes, see real_alloc
+        std::memset(hunk_ptr->data_ptr + size, 0, new_size - sizeof(LRUMemoryHunk) - size);
+    }
+    return true;
+}
+
+bool
+LRUMemoryManager::resize_pool(size_t pool_size)
+{
+    if (pool_size > mem_capacity_size_ || pool_size < sizeof(LRUMemoryHunk)) {
+        return false;
+    }
+    LRUMemoryHunk* head_hunk_ptr = get_head_hunk();
+    uint8_t* arena_ptr = static_cast<uint8_t*>(mem_arena_ptr_);
+    uint8_t* pool_end = arena_ptr + pool_size;
+
+    // Hunks cannot move, the ones reaching past the new end are evicted
+    auto last_end = [head_hunk_ptr]() {
+        return reinterpret_cast<uint8_t*>(head_hunk_ptr->prev_ptr) + head_hunk_ptr->prev_ptr->size;
+    };
+    while (last_end() > pool_end) {
+        LRUMM_STAT_ADD(stats_, evictions, 1);
+        LRUMM_STAT_ADD(stats_, evictions_capacity, 1);
+        evict(head_hunk_ptr->prev_ptr);
+    }
+#if LRUMM_ENABLE_STATS
+    gaps_.remove(arena_ptr + mem_total_size_ - last_end());
+    gaps_.add(pool_end - last_end());
+#endif
+
+    if (pool_size < mem_total_size_) {
+        LRUMM_STAT_ADD(stats_, pool_shrinks, 1);
+
+        // Whole pages only, the tail of the mapping past the new end holds no hunks
+        uintptr_t page_mask = static_cast<uintptr_t>(::sysconf(_SC_PAGESIZE)) - 1;
+        uintptr_t release_start = (reinterpret_cast<uintptr_t>(pool_end) + page_mask) & ~page_mask;
+        uintptr_t release_end = (reinterpret_cast<uintptr_t>(arena_ptr + mem_capacity_size_) + page_mask) & ~page_mask;
+        if (release_end > release_start) {
+            ::madvise(reinterpret_cast<void*>(release_start), release_end - release_start, MADV_DONTNEED);
+        }
+    } else if (pool_size > mem_total_size_) {
+        LRUMM_STAT_ADD(stats_, pool_grows, 1);
+    }
+    mem_total_size_ = pool_size;
+
+    // The large objects share the budget of the pool
+    while (large_threshold_ && mem_allocated_size_ + large_allocated_size_ > mem_total_size_ + large_budget_) {
+        LRUMemoryHunk* victim_hunk_ptr = coldest_hunk();
+        LRUMM_STAT_ADD(stats_, evictions, 1);
+        LRUMM_STAT_ADD(stats_, evictions_capacity, 1);
+        if (is_large_hunk(victim_hunk_ptr)) {
+            LRUMM_STAT_ADD(stats_, large_evictions, 1);
+        }
+        evict(victim_hunk_ptr);
+    }
+    return true;
+}
+
+void
+LRUMemoryManager::transfer_hunk(LRUMemoryHandle *from_handle_ptr, LRUMemoryHandle *to_handle_ptr)
+{
+    Expects(to_handle_ptr->hunk_ptr_ == nullptr && !to_handle_ptr->is_spilled());
+    Expects(!from_handle_ptr->is_sealed() && !from_handle_ptr->is_loading());
+
+    LRUMemoryHunk* hunk_ptr = from_handle_ptr->hunk_ptr_;
+    hunk_ptr->handler_ptr = to_handle_ptr;
+    to_handle_ptr->hunk_ptr_ = hunk_ptr;
+    to_handle_ptr->manager_ptr_ = this;
+    to_handle_ptr->site_index_ = from_handle_ptr->site_index_;
+    to_handle_ptr->last_use_ = from_handle_ptr->last_use_;
+    to_handle_ptr->link_epoch_ = from_handle_ptr->link_epoch_;
+    from_handle_ptr->hunk_ptr_ = nullptr;
+    from_handle_ptr->site_index_ = 0;
+}
+
+bool
+LRUMemoryManager::seal(LRUMemoryHandle *handle_ptr)
+{
+    Expects(handle_ptr != nullptr && handle_ptr->hunk_ptr_ != nullptr); // LRUMemoryManager::seal: not allocated.
+    Expects(!handle_ptr->is_loading());
+    if (!is_dedup_enabled_ || handle_ptr->is_sealed()) {
+        return false;
+    }
+    LRUMM_STAT_ADD(stats_, seals, 1);
+
+    LRUMemoryHunk* hunk_ptr = handle_ptr->hunk_ptr_;
+    size_t payload_size = hunk_ptr->size - sizeof(LRUMemoryHunk);
+    uint64_t hash = hash_bytes(hunk_ptr->data_ptr, payload_size);
+
+    auto range = seal_index_.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it) {
+        LRUMemoryHunk* shared_hunk_ptr = it->second;
+        if (shared_hunk_ptr->size != hunk_ptr->size
+            || std::memcmp(shared_hunk_ptr->data_ptr, hunk_ptr->data_ptr, payload_size) != 0) {
+            continue;
+        }
+
+        // Identical, the own copy is released and the handle joins the references
+        LRUMM_STAT_ADD(stats_, seal_shares, 1);
+        LRUMM_STAT_ADD(stats_, seal_shared_bytes, hunk_ptr->size);
+        if (handle_ptr->site_index_) {
+            release_site(handle_ptr, false);
+        }
+        real_free(handle_ptr);
+
+        LRUMemoryHandle* owner_ptr = shared_hunk_ptr->handler_ptr;
+        handle_ptr->next_sharer_ptr_ = owner_ptr->next_sharer_ptr_;
+        handle_ptr->prev_sharer_ptr_ = owner_ptr;
+        owner_ptr->next_sharer_ptr_->prev_sharer_ptr_ = handle_ptr;
+        owner_ptr->next_sharer_ptr_ = handle_ptr;
+        handle_ptr->hunk_ptr_ = shared_hunk_ptr;
+        sealed_hunks_[shared_hunk_ptr].ref_count++;
+
+        // The new reference is a use of the shared hunk
+        owner_ptr->last_use_ = ++use_clock_;
+        unlink_lru(shared_hunk_ptr);
+        link_lru(shared_hunk_ptr);
+        return true;
+    }
+
+    seal_index_.emplace(hash, hunk_ptr);
+    sealed_hunks_.emplace(hunk_ptr, SealedHunk{ hash, 1 });
+    handle_ptr->next_sharer_ptr_ = handle_ptr->prev_sharer_ptr_ = handle_ptr;
+    return false;
+}
+
+void
+LRUMemoryManager::release_reference(LRUMemoryHandle *handle_ptr)
+{
+    LRUMemoryHunk* hunk_ptr = handle_ptr->hunk_ptr_;
+    sealed_hunks_[hunk_ptr].ref_count--;
+
+    handle_ptr->prev_sharer_ptr_->next_sharer_ptr_ = handle_ptr->next_sharer_ptr_;
+    handle_ptr->next_sharer_ptr_->prev_sharer_ptr_ = handle_ptr->prev_sharer_ptr_;
+    if (hunk_ptr->handler_ptr == handle_ptr) {
+        // The next reference takes the hunk over, with its profiler site
+        hunk_ptr->handler_ptr = handle_ptr->next_sharer_ptr_;
+        hunk_ptr->handler_ptr->site_index_ = handle_ptr->site_index_;
+        handle_ptr->site_index_ = 0;
+    }
+    handle_ptr->next_sharer_ptr_ = handle_ptr->prev_sharer_ptr_ = nullptr;
+    handle_ptr->hunk_ptr_ = nullptr;
+}
+
+void
+LRUMemoryManager::unseal(LRUMemoryHandle *handle_ptr)
+{
+    LRUMemoryHunk* hunk_ptr = handle_ptr->hunk_ptr_;
+    auto sealed_it = sealed_hunks_.find(hunk_ptr);
+    auto range = seal_index_.equal_range(sealed_it->second.hash);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (it->second == hunk_ptr) {
+            seal_index_.erase(it);
+            break;
+        }
+    }
+    sealed_hunks_.erase(sealed_it);
+
+    // A flush, or an eviction that could not spill, releases a shared hunk for all the references
+    LRUMemoryHandle* sharer_ptr = handle_ptr->next_sharer_ptr_;
+    while (sharer_ptr != handle_ptr) {
+        LRUMemoryHandle* next_ptr = sharer_ptr->next_sharer_ptr_;
+        sharer_ptr->next_sharer_ptr_ = sharer_ptr->prev_sharer_ptr_ = nullptr;
+        sharer_ptr->hunk_ptr_ = nullptr;
+        sharer_ptr = next_ptr;
+    }
+    handle_ptr->next_sharer_ptr_ = handle_ptr->prev_sharer_ptr_ = nullptr;
+}
+
+void
+LRUMemoryManager::release_tier(LRUMemoryHandle *handle_ptr)
+{
+    if (handle_ptr->is_shared()) {
+        // The other references keep the shared copy
+        handle_ptr->prev_sharer_ptr_->next_sharer_ptr_ = handle_ptr->next_sharer_ptr_;
+        handle_ptr->next_sharer_ptr_->prev_sharer_ptr_ = handle_ptr->prev_sharer_ptr_;
+    } else if (tier_ptr_) {
+        tier_ptr_->release(handle_ptr->tier_locator_);
+    }
+    handle_ptr->next_sharer_ptr_ = handle_ptr->prev_sharer_ptr_ = nullptr;
+    handle_ptr->tier_locator_ = LRUMemoryTier::NO_LOCATOR;
+}
+
+void
+LRUMemoryManager::track_interior_gaps(const LRUMemoryHunk *hunk_ptr)
+{
+    // The gaps around the released hunk merge into one, which is interior unless it reaches the pool end
+    const uint8_t* hunk_start = reinterpret_cast<const uint8_t*>(hunk_ptr);
+    const uint8_t* prev_end = reinterpret_cast<const uint8_t*>(hunk_ptr->prev_ptr) + hunk_ptr->prev_ptr->size;
+    bool is_last = hunk_ptr->next_ptr == get_head_hunk();
+    bool has_gap_after = !is_last
+        && reinterpret_cast<const uint8_t*>(hunk_ptr->next_ptr) > hunk_start + hunk_ptr->size;
+
+    interior_gap_count_ -= (hunk_start > prev_end) + has_gap_after;
+    interior_gap_count_ += !is_last;
 }
 
+#if LRUMM_ENABLE_STATS
+void
+LRUMemoryManager::track_released_gap(const LRUMemoryHunk *hunk_ptr)
+{
+    // Merge the gaps on both sides of the released hunk into one
+    const uint8_t* hunk_start = reinterpret_cast<const uint8_t*>(hunk_ptr);
+    const uint8_t* hunk_end = hunk_start + hunk_ptr->size;
+    const uint8_t* prev_end = reinterpret_cast<const uint8_t*>(hunk_ptr->prev_ptr) + hunk_ptr->prev_ptr->size;
+    const uint8_t* next_start = hunk_ptr->next_ptr == get_head_hunk()
+        ? static_cast<const uint8_t*>(mem_arena_ptr_) + mem_total_size_
+        : reinterpret_cast<const uint8_t*>(hunk_ptr->next_ptr);
+
+    size_t gap_before = hunk_start - prev_end;
+    size_t gap_after = next_start - hunk_end;
+    gaps_.remove(gap_before);
+    gaps_.remove(gap_after);
+    gaps_.add(gap_before + hunk_ptr->size + gap_after);
+}
+#endif
+
+#if LRUMM_ENABLE_LATENCY
+void*
+LRUMemoryManager::timed_get_buffer(LRUMemoryHandle *handle_ptr)
+{
+    uint64_t start_ns = detail::now_ns();
+    void* buffer_ptr = real_get_buffer(handle_ptr);
+    latency_.refresh_.record(detail::now_ns() - start_ns);
+    return buffer_ptr;
+}
+
+void*
+LRUMemoryManager::timed_alloc(LRUMemoryHandle *handle_ptr, size_t size)
+{
+    uint64_t start_ns = detail::now_ns();
+    void* buffer_ptr = real_alloc(handle_ptr, size);
+    uint64_t elapsed_ns = detail::now_ns() - start_ns;
+
+    latency_.alloc_.record(elapsed_ns);
+    latency_.evictions_per_alloc_.record(latency_.last_alloc_evictions_);
+    if (latency_.last_alloc_evictions_ > 0) {
+        latency_.eviction_.record(elapsed_ns);
+    }
+    return buffer_ptr;
+}
+
+void
+LRUMemoryManager::timed_free(LRUMemoryHandle *handle_ptr)
+{
+    uint64_t start_ns = detail::now_ns();
+    real_free(handle_ptr);
+    latency_.free_.record(detail::now_ns() - start_ns);
+}
+#endif
+
 void
 LRUMemoryManager::unlink_lru(LRUMemoryHunk *hunk_ptr)
 {
@@ -243,8 +1109,8 @@ LRUMemoryManager::link_lru(LRUMemoryHunk *hunk_ptr)
     Expects(hunk_ptr);
     Expects(!hunk_ptr->most_recent_ptr && !hunk_ptr->least_recent_ptr); // LRUMemoryManager::link_lru: already linked.
 
-    // link to the top of the lru list
-    LRUMemoryHunk* head_hunk_ptr = get_head_hunk();
+    // link to the top of the lru list of its region
+    LRUMemoryHunk* head_hunk_ptr = is_large_hunk(hunk_ptr) ? large_head_hunk_ptr_ : get_head_hunk();
     head_hunk_ptr->most_recent_ptr->least_recent_ptr = hunk_ptr;
     hunk_ptr->most_recent_ptr = head_hunk_ptr->most_recent_ptr;
     hunk_ptr->least_recent_ptr = head_hunk_ptr;
@@ -300,6 +1166,270 @@ LRUMemoryManager::debug_dump() const
     LOG_INFO("used memory: %zu, total pool size %zu\n", mem_allocated_size_, mem_total_size_);
 }
 
+size_t
+LRUMemoryManager::write_heap_map(void* buffer_ptr, size_t buffer_size) const
+{
+    const LRUMemoryHunk* head_hunk_ptr = get_head_hunk();
+    const uint8_t* arena_ptr = static_cast<const uint8_t*>(mem_arena_ptr_);
+
+    // Count first, so the caller can size the buffer
+    LRUHeapMapHeader header = {};
+    std::memcpy(header.magic, LRUHeapMapHeader::MAGIC, sizeof(header.magic));
+    header.version = LRUHeapMapHeader::VERSION;
+    header.range_size = sizeof(LRUHeapMapRange);
+    header.pool_size = mem_total_size_;
+    header.allocated_size = mem_allocated_size_;
+
+    const LRUMemoryHunk* hunk_ptr = head_hunk_ptr;
+    do {
+        const uint8_t* hunk_end = reinterpret_cast<const uint8_t*>(hunk_ptr) + hunk_ptr->size;
+        const uint8_t* next_start = hunk_ptr->next_ptr == head_hunk_ptr
+            ? arena_ptr + mem_total_size_
+            : reinterpret_cast<const uint8_t*>(hunk_ptr->next_ptr);
+        header.gap_count += next_start > hunk_end;
+        header.hunk_count += hunk_ptr != head_hunk_ptr;
+        hunk_ptr = hunk_ptr->next_ptr;
+    } while (hunk_ptr != head_hunk_ptr);
+
+    size_t map_size = sizeof(header) + (header.hunk_count + header.gap_count) * sizeof(LRUHeapMapRange);
+    if (buffer_size < map_size) {
+        return map_size;
+    }
+    Expects(buffer_ptr != nullptr);
+
+    uint8_t* output_ptr = static_cast<uint8_t*>(buffer_ptr);
+    std::memcpy(output_ptr, &header, sizeof(header));
+    output_ptr += sizeof(header);
+
+    // Hunks in recency order, the position is the rank
+    for (hunk_ptr = head_hunk_ptr->most_recent_ptr; hunk_ptr != head_hunk_ptr; hunk_ptr = hunk_ptr->most_recent_ptr) {
+        LRUHeapMapRange range = { static_cast<uint64_t>(reinterpret_cast<const uint8_t*>(hunk_ptr) - arena_ptr), hunk_ptr->size };
+        std::memcpy(output_ptr, &range, sizeof(range));
+        output_ptr += sizeof(range);
+    }
+
+    // Gaps in address order
+    hunk_ptr = head_hunk_ptr;
+    do {
+        const uint8_t* hunk_end = reinterpret_cast<const uint8_t*>(hunk_ptr) + hunk_ptr->size;
+        const uint8_t* next_start = hunk_ptr->next_ptr == head_hunk_ptr
+            ? arena_ptr + mem_total_size_
+            : reinterpret_cast<const uint8_t*>(hunk_ptr->next_ptr);
+        if (next_start > hunk_end) {
+            LRUHeapMapRange range = { static_cast<uint64_t>(hunk_end - arena_ptr), static_cast<uint64_t>(next_start - hunk_end) };
+            std::memcpy(output_ptr, &range, sizeof(range));
+            output_ptr += sizeof(range);
+        }
+        hunk_ptr = hunk_ptr->next_ptr;
+    } while (hunk_ptr != head_hunk_ptr);
+
+    return map_size;
+}
+
+bool
+LRUMemoryManager::write_heap_map(const char* path) const
+{
+    Expects(path != nullptr);
+
+    std::vector<uint8_t> buffer(write_heap_map(nullptr, 0));
+    write_heap_map(buffer.data(), buffer.size());
+
+    std::FILE* file_ptr = std::fopen(path, "wb");
+    if (!file_ptr) {
+        LOG_ERROR("Failed to open heap map file %s.\n", path);
+        return false;
+    }
+    bool is_written = std::fwrite(buffer.data(), buffer.size(), 1, file_ptr) == 1;
+    is_written = std::fclose(file_ptr) == 0 && is_written;
+    if (!is_written) {
+        LOG_ERROR("Failed to write heap map file %s.\n", path);
+    }
+    return is_written;
+}
+
+bool
+LRUMemoryManager::snapshot(const char* path, const std::function<uint64_t(const LRUMemoryHandle&)>& key_of) const
+{
+    Expects(path != nullptr);
+    const LRUMemoryHunk* head_hunk_ptr = get_head_hunk();
+
+    LRUSnapshotHeader header = {};
+    std::memcpy(header.magic, LRUSnapshotHeader::MAGIC, sizeof(header.magic));
+    header.version = LRUSnapshotHeader::VERSION;
+    header.record_size = sizeof(LRUSnapshotRecord);
+
+    // Least recent first, so that restoring in file order rebuilds the recency
+    std::vector<LRUSnapshotRecord> records;
+    std::vector<iovec> iovecs(2);
+    for (const LRUMemoryHunk* hunk_ptr = head_hunk_ptr->least_recent_ptr; hunk_ptr != head_hunk_ptr;
+        hunk_ptr = hunk_ptr->least_recent_ptr) {
+        if (hunk_ptr->handler_ptr->is_loading()) {
+            continue;
+        }
+        size_t payload_size = hunk_ptr->size - sizeof(LRUMemoryHunk);
+        records.push_back({ key_of(*hunk_ptr->handler_ptr), payload_size });
+        iovecs.push_back({ const_cast<uint8_t*>(hunk_ptr->data_ptr), payload_size });
+        header.payload_size += payload_size;
+    }
+    header.hunk_count = records.size();
+    iovecs[0] = { &header, sizeof(header) };
+    iovecs[1] = { records.data(), records.size() * sizeof(LRUSnapshotRecord) };
+
+    std::string temp_path = std::string(path) + ".tmp";
+    int fd = ::open(temp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        LOG_ERROR("Failed to open snapshot file %s: %s.\n", temp_path.c_str(), std::strerror(errno));
+        return false;
+    }
+
+    // At most IOV_MAX buffers per call; a short write resumes inside a buffer
+    bool is_written = true;
+    for (size_t index = 0; index < iovecs.size() && is_written;) {
+        int count = static_cast<int>(std::min<size_t>(iovecs.size() - index, IOV_MAX));
+        ssize_t written = ::writev(fd, &iovecs[index], count);
+        if (written < 0) {
+            is_written = errno == EINTR;
+            continue;
+        }
+        while (index < iovecs.size() && static_cast<size_t>(written) >= iovecs[index].iov_len) {
+            written -= static_cast<ssize_t>(iovecs[index].iov_len);
+            index++;
+        }
+        if (written > 0) {
+            iovecs[index].iov_base = static_cast<uint8_t*>(iovecs[index].iov_base) + written;
+            iovecs[index].iov_len -= static_cast<size_t>(written);
+        }
+    }
+    is_written = ::close(fd) == 0 && is_written;
+    is_written = is_written && ::rename(temp_path.c_str(), path) == 0;
+    if (!is_written) {
+        LOG_ERROR("Failed to write snapshot file %s: %s.\n", path, std::strerror(errno));
+        ::unlink(temp_path.c_str());
+    }
+    return is_written;
+}
+
+bool
+LRUMemoryManager::restore(const char* path, const std::function<LRUMemoryHandle*(uint64_t key, size_t size)>& bind)
+{
+    Expects(path != nullptr);
+
+    int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        LOG_ERROR("Failed to open snapshot file %s: %s.\n", path, std::strerror(errno));
+        return false;
+    }
+    struct stat file_stat;
+    void* map_ptr = MAP_FAILED;
+    if (::fstat(fd, &file_stat) == 0 && file_stat.st_size > 0) {
+        map_ptr = ::mmap(nullptr, static_cast<size_t>(file_stat.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    ::close(fd);
+    if (map_ptr == MAP_FAILED) {
+        LOG_ERROR("Failed to map snapshot file %s.\n", path);
+        return false;
+    }
+    size_t file_size = static_cast<size_t>(file_stat.st_size);
+    ::madvise(map_ptr, file_size, MADV_SEQUENTIAL);
+
+    // The file is validated as a whole before any hunk is allocated
+    const uint8_t* file_ptr = static_cast<const uint8_t*>(map_ptr);
+    LRUSnapshotHeader header;
+    bool is_valid = file_size >= sizeof(header);
+    if (is_valid) {
+        std::memcpy(&header, file_ptr, sizeof(header));
+        is_valid = std::memcmp(header.magic, LRUSnapshotHeader::MAGIC, sizeof(header.magic)) == 0
+            && header.version == LRUSnapshotHeader::VERSION && header.record_size == sizeof(LRUSnapshotRecord)
+            && header.hunk_count <= (file_size - sizeof(header)) / sizeof(LRUSnapshotRecord)
+            && header.payload_size == file_size - sizeof(header) - header.hunk_count * sizeof(LRUSnapshotRecord);
+    }
+    std::vector<LRUSnapshotRecord> records(is_valid ? header.hunk_count : 0);
+    if (is_valid) {
+        std::memcpy(records.data(), file_ptr + sizeof(header), records.size() * sizeof(LRUSnapshotRecord));
+        uint64_t payload_size = 0;
+        for (const auto& record : records) {
+            is_valid = is_valid && record.size > 0 && record.size <= header.payload_size - payload_size;
+            payload_size += is_valid ? record.size : 0;
+        }
+        is_valid = is_valid && payload_size == header.payload_size;
+    }
+    if (!is_valid) {
+        LOG_ERROR("Malformed snapshot file %s.\n", path);
+        ::munmap(map_ptr, file_size);
+        return false;
+    }
+
+    const uint8_t* payload_ptr = file_ptr + sizeof(header) + records.size() * sizeof(LRUSnapshotRecord);
+    for (const auto& record : records) {
+        LRUMemoryHandle* handle_ptr = bind(record.key, record.size);
+        if (handle_ptr) {
+            Expects(handle_ptr->hunk_ptr_ == nullptr); // LRUMemoryManager::restore: handle already allocated.
+            void* buffer_ptr = real_alloc(handle_ptr, record.size);
+            if (buffer_ptr) {
+                std::memcpy(buffer_ptr, payload_ptr, record.size);
+            }
+        }
+        payload_ptr += record.size;
+    }
+    ::munmap(map_ptr, file_size);
+    return true;
+}
+
+size_t
+LRUMemoryManager::export_hunks(LRUExportCursor& cursor, size_t max_hunks, char* buffer_ptr, size_t buffer_size) const
+{
+    Expects(buffer_ptr != nullptr || buffer_size == 0);
+
+    const LRUMemoryHunk* head_hunk_ptr = get_head_hunk();
+    const uint8_t* arena_ptr = static_cast<const uint8_t*>(mem_arena_ptr_);
+    auto hunk_offset = [arena_ptr](const LRUMemoryHunk* hunk_ptr) {
+        return static_cast<uint64_t>(reinterpret_cast<const uint8_t*>(hunk_ptr) - arena_ptr);
+    };
+
+    if (buffer_size > 0) {
+        buffer_ptr[0] = '\0';
+    }
+    if (cursor.is_done) {
+        return 0;
+    }
+
+    const LRUMemoryHunk* hunk_ptr = head_hunk_ptr->next_ptr;
+    if (cursor.next_hunk_ptr && release_epoch_ - cursor.release_epoch <= RELEASE_LOG_SIZE) {
+        // Replay the releases since the cursor was saved; a released hunk passes the walk on to its successor
+        hunk_ptr = static_cast<const LRUMemoryHunk*>(cursor.next_hunk_ptr);
+        for (uint64_t epoch = cursor.release_epoch; epoch != release_epoch_; ++epoch) {
+            const ReleasedHunk& released = release_log_[epoch % RELEASE_LOG_SIZE];
+            if (released.hunk_ptr == hunk_ptr) {
+                hunk_ptr = released.next_ptr;
+            }
+        }
+    } else if (cursor.next_hunk_ptr) {
+        // Too many releases to replay, find the first hunk at or after the saved offset
+        while (hunk_ptr != head_hunk_ptr && hunk_offset(hunk_ptr) < cursor.next_offset) {
+            hunk_ptr = hunk_ptr->next_ptr;
+        }
+    }
+
+    size_t written = 0;
+    for (size_t count = 0; hunk_ptr != head_hunk_ptr && count < max_hunks; ++count) {
+        char line[96];
+        int length = std::snprintf(line, sizeof(line), "{\"offset\":%llu,\"size\":%zu,\"payload\":%zu}\n",
+            static_cast<unsigned long long>(hunk_offset(hunk_ptr)), hunk_ptr->size, hunk_ptr->size - sizeof(LRUMemoryHunk));
+        if (written + static_cast<size_t>(length) >= buffer_size) {
+            break;
+        }
+        std::memcpy(buffer_ptr + written, line, static_cast<size_t>(length) + 1);
+        written += static_cast<size_t>(length);
+        hunk_ptr = hunk_ptr->next_ptr;
+    }
+
+    cursor.is_done = hunk_ptr == head_hunk_ptr;
+    cursor.next_hunk_ptr = cursor.is_done ? nullptr : hunk_ptr;
+    cursor.next_offset = cursor.is_done ? mem_total_size_ : hunk_offset(hunk_ptr);
+    cursor.release_epoch = release_epoch_;
+    return written;
+}
+
 LRUMemoryManager::iterator
 LRUMemoryManager::begin(bool is_lru_order)
 {
@@ -336,4 +1466,4 @@ LRUMemoryManager::get_instance() {
     return lru_memory_cache_;
 }
 
-}
\ No newline at end of file
+}
@@ -1,10 +1,22 @@
 #ifndef LRU_MEMORY_MANAGER__H
 #define LRU_MEMORY_MANAGER__H
 
+#include <array>
+#include <functional>
 #include <iterator>
 #include <type_traits>
+#include <unordered_map>
 #include <gsl/gsl>
 
+#include "lrumemorystats.h"
+#include "lrumemoryheapmap.h"
+#include "lrumemoryexport.h"
+#include "lrumemoryhistogram.h"
+#include "lrumemoryprofile.h"
+#include "lrumemorysnapshot.h"
+#include "lrumemorytier.h"
+#include "lrumemorytrace.h"
+
 #ifndef LOG_ERROR
 #define LOG_ERROR(...) std::fprintf(stderr, __VA_ARGS__)
 #endif
@@ -15,6 +27,8 @@
 
 namespace lrumm {
 
+class LRUAppendWriter;
+
 /**
  * @brief A memory manager implementing an LRU (Least Recently Used) eviction strategy
  *
@@ -39,9 +53,13 @@ public:
         void operator= (const LRUMemoryHandle& other) { Expects(other.hunk_ptr_ == nullptr); } // Copyable in initial state only.
         LRUMemoryHandle(LRUMemoryHandle&& other) { Expects(other.hunk_ptr_ == nullptr); } // Movable in initial state only.
         void operator= (LRUMemoryHandle&& other) { Expects(other.hunk_ptr_ == nullptr); } // Movable in initial state only.
-        ~LRUMemoryHandle() { if (hunk_ptr_) LRUMemoryManager::get_instance().free(this); };
+        ~LRUMemoryHandle() { if (hunk_ptr_ || tier_locator_ != LRUMemoryTier::NO_LOCATOR) manager_ptr_->free(this); };
 
         const LRUMemoryHunk* hunk_ptr() const { return hunk_ptr_; }
+        bool is_spilled() const { return !hunk_ptr_ && tier_locator_ != LRUMemoryTier::NO_LOCATOR; }
+        bool is_loading() const { return hunk_ptr_ && tier_locator_ != LRUMemoryTier::NO_LOCATOR; } ///< Prefetch in flight
+        bool is_sealed() const { return next_sharer_ptr_ != nullptr; }
+        bool is_shared() const { return next_sharer_ptr_ != nullptr && next_sharer_ptr_ != this; }
 
         LRUMemoryHandle* next() const;
         LRUMemoryHandle* most_recent() const;
@@ -49,6 +67,13 @@ public:
         size_t size() const;
     private:
         LRUMemoryHunk *hunk_ptr_ = nullptr;
+        LRUMemoryManager *manager_ptr_ = nullptr; ///< Manager the hunk was allocated from
+        uint32_t site_index_ = 0; ///< Profiler site of a sampled allocation, 0 when not sampled
+        uint32_t link_epoch_ = 0; ///< Recency epoch in which the hunk was last moved to the most recent end
+        uint64_t tier_locator_ = LRUMemoryTier::NO_LOCATOR; ///< Payload kept by the second tier, or being prefetched into the hunk
+        LRUMemoryHandle *next_sharer_ptr_ = nullptr; ///< Circular list of the handles of a sealed hunk, nullptr when not sealed
+        LRUMemoryHandle *prev_sharer_ptr_ = nullptr;
+        uint64_t last_use_ = 0; ///< Operation clock at the last allocation or refresh of the hunk
         friend LRUMemoryManager;
     };
 
@@ -82,6 +107,8 @@ public:
     using iterator = Iterator<false>;
     using const_iterator = Iterator<true>;
 
+    static constexpr size_t DIRECT_IO_ALIGNMENT = 4096; ///< Buffer, offset and length unit of O_DIRECT reads
+
     explicit LRUMemoryManager(size_t mem_pool_size = 4 * 1024 * 1024);
     ~LRUMemoryManager() noexcept;
 
@@ -93,10 +120,174 @@ public:
     void* get_buffer_and_refresh(LRUMemoryHandle *handle_ptr);
     void flush();
 
+    /**
+     * @brief Allocates a payload starting on a power of two boundary, for direct I/O
+     *
+     * The hunk header is placed right before the boundary; the bytes skipped
+     * to reach it stay free for smaller allocations.
+     */
+    void* alloc_aligned(LRUMemoryHandle *handle_ptr, size_t size, size_t alignment = DIRECT_IO_ALIGNMENT);
+
+    /**
+     * @brief Allocates a hunk and reads len bytes of the file at offset straight into it
+     *
+     * When fd was opened with O_DIRECT, the offset must be block aligned and the
+     * payload is block aligned with its size rounded up to whole blocks. With an
+     * engine the read goes through it; the engine must have no other requests in
+     * flight. Returns nullptr, with the handle not allocated, when the allocation
+     * fails or fewer than len bytes could be read.
+     */
+    void* load_from_fd(LRUMemoryHandle *handle_ptr, int fd, uint64_t offset, size_t len, LRUIOEngine *engine_ptr = nullptr);
+
+    /**
+     * @brief Grows or shrinks the payload without moving it
+     *
+     * Growing takes the free space right after the hunk and never evicts; returns
+     * false when that space is too small. Shrinking always succeeds and leaves the
+     * released tail free. A large object grows within the pages it has mapped. A
+     * sampled allocation is dropped from the site profiler.
+     */
+    bool resize_in_place(LRUMemoryHandle *handle_ptr, size_t size);
+
+    /**
+     * @brief Moves the end of the pool, within the size it was constructed with
+     *
+     * Hunks do not move: shrinking evicts the hunks reaching past the new end and
+     * returns the whole pages after it to the system with madvise(MADV_DONTNEED).
+     * Growing takes them back, they are faulted in again as they are used. Large
+     * objects exceeding the reduced shared budget are evicted too. Returns false
+     * when the size is out of range.
+     */
+    bool resize_pool(size_t pool_size);
+
     void report_state() const;
     void debug_dump() const;
 
+    /**
+     * @brief Writes a binary heap map (see LRUHeapMapHeader) into the buffer
+     *
+     * Returns the size of the map; nothing is written when it exceeds buffer_size,
+     * so a call with an empty buffer queries the size.
+     */
+    size_t write_heap_map(void* buffer_ptr, size_t buffer_size) const;
+    bool write_heap_map(const char* path) const;
+
+    /**
+     * @brief Writes the payloads of the hunks and their recency order to a file
+     *
+     * key_of names the handle of each hunk, restore() binds the payloads back by
+     * these keys. The payloads are written straight from the pool with vectored
+     * writes; spilled payloads and prefetches in flight are not included. The file
+     * is written next to path and renamed over it once complete.
+     */
+    bool snapshot(const char* path, const std::function<uint64_t(const LRUMemoryHandle&)>& key_of) const;
+
+    /**
+     * @brief Loads a snapshot written by snapshot() into new hunks, in the saved recency order
+     *
+     * bind returns the handle for a key, nullptr to skip the payload. The handle must
+     * not be allocated. The restored hunks become the most recent ones; when they do
+     * not all fit, the least recent of them are evicted like any allocation.
+     */
+    bool restore(const char* path, const std::function<LRUMemoryHandle*(uint64_t key, size_t size)>& bind);
+
+    /**
+     * @brief Formats the counters as JSON or Prometheus text, see export_stats
+     *
+     * Reads only the maintained counters, O(1) regardless of the number of hunks.
+     */
+    size_t export_state(LRUExportFormat format, char* buffer_ptr, size_t buffer_size) const;
+
+    /**
+     * @brief Writes up to max_hunks hunks in address order as JSON lines, resuming at the cursor
+     *
+     * Each line is {"offset":N,"size":N,"payload":N}. Only whole lines are written and the
+     * output is always terminated; the return value is the number of characters written.
+     * Nothing written while cursor.is_done is false means the buffer cannot hold one line.
+     */
+    size_t export_hunks(LRUExportCursor& cursor, size_t max_hunks, char* buffer_ptr, size_t buffer_size) const;
+
     size_t get_allocated_memory_size() const;
+    size_t get_pool_size() const;
+    size_t get_pool_capacity() const;
+
+    LRUMemoryStats get_stats() const;
+    void reset_stats();
+    void set_latency_sample_period(uint32_t sample_period);
+
+    void set_trace_recorder(LRUTraceRecorder *recorder_ptr);
+
+    /**
+     * @brief Attaches an allocation site profiler, nullptr detaches it
+     *
+     * Allocations sampled while a profiler is attached are charged back to it
+     * when they are freed or evicted, so detach it only when it is no longer read.
+     */
+    void set_site_profiler(LRUSiteProfiler *profiler_ptr);
+
+    /**
+     * @brief Attaches a second tier for the payloads of evicted hunks, nullptr detaches it
+     *
+     * A refresh of a handle whose payload the tier kept allocates a new hunk and
+     * loads the payload back. free() drops a kept payload. The tier must outlive
+     * the handles it keeps payloads for.
+     */
+    void set_tier(LRUMemoryTier *tier_ptr);
+
+    /**
+     * @brief Starts loading a spilled payload back into a new most recent hunk
+     *
+     * The hunk is reserved at once and the tier reads into it in the background;
+     * the next refresh waits for the read. Tiers without asynchronous loads load
+     * synchronously. Returns false when the handle is not spilled, the hunk does
+     * not fit or the load failed.
+     */
+    bool prefetch(LRUMemoryHandle *handle_ptr);
+
+    /**
+     * @brief Enables the deduplication of sealed payloads
+     *
+     * While enabled, the alignment padding of new and resized hunks is zeroed, so
+     * that hunks with equal payloads compare equal as a whole.
+     */
+    void set_dedup_enabled(bool is_enabled);
+
+    /**
+     * @brief Marks the payload as read-only and shares an identical sealed hunk, if any
+     *
+     * The payload is hashed and compared with the sealed hunks of the same size.
+     * On a match the own hunk of the handle is released and the handle becomes one
+     * more reference to the existing hunk, so get_buffer_and_refresh() returns the
+     * shared buffer; returns true then. free() of a reference releases the hunk
+     * with the last one, an eviction releases it for all of them. Does nothing
+     * while deduplication is disabled.
+     */
+    bool seal(LRUMemoryHandle *handle_ptr);
+
+    /**
+     * @brief Places allocations of threshold bytes and more in a separate large object region, 0 turns it off
+     *
+     * Each large payload is mapped on its own, page aligned, and kept in an LRU list of
+     * its own, so a large allocation does not flush the small hunks of the pool. The two
+     * regions share one budget, the pool size plus budget: an allocation that exceeds it
+     * evicts the least recent hunk of either region, the one holding less recency per
+     * byte, that is with the larger product of idle operations and size. Large objects
+     * are not visited by the iterators, heap maps, exports and snapshots; the ones left
+     * when the region is turned off stay until they are freed.
+     */
+    void set_large_object_region(size_t threshold, size_t budget);
+
+    /**
+     * @brief Lets a refresh leave a hunk in place when it was moved in the current epoch, 0 and 0 restore exact LRU
+     *
+     * An epoch ends after epoch_ops allocations and refreshes or after epoch_ms
+     * milliseconds, whichever comes first; the coarse clock is read every 64
+     * operations. Hot hunks are relinked at most once per epoch, and the recency
+     * order differs from LRU only among the hunks moved within the same epoch.
+     * Setting it starts a new epoch.
+     */
+    void set_recency_epoch(uint32_t epoch_ops, uint32_t epoch_ms = 0);
+    size_t get_large_allocated_size() const; ///< Bytes mapped for large objects
 
     iterator begin(bool lru = true);
     iterator end();
@@ -105,20 +296,91 @@ public:
 
     static LRUMemoryManager& get_instance();
 
+    /**
+     * @brief Pool bytes an allocation of the given size occupies, header and alignment included
+     */
+    static size_t get_hunk_footprint(size_t size);
+
 private:
     LRUMemoryHunk* get_head_hunk() const;
 
-    LRUMemoryHunk* try_alloc(size_t size);
+    LRUMemoryHunk* try_alloc(size_t size, size_t alignment);
+    LRUMemoryHunk* try_alloc_large(size_t size);
+    bool is_large_hunk(const LRUMemoryHunk *hunk_ptr) const;
+    LRUMemoryHunk* coldest_hunk() const;
+    void evict(LRUMemoryHunk *hunk_ptr);
+    uint32_t current_epoch();
     void* real_get_buffer(LRUMemoryHandle *handle_ptr);
-    void* real_alloc(LRUMemoryHandle *handle_ptr, size_t size);
+    void* real_alloc(LRUMemoryHandle *handle_ptr, size_t size, size_t alignment = 0, bool is_evicting = true);
     void real_free(LRUMemoryHandle *handle_ptr);
+    void release_site(LRUMemoryHandle *handle_ptr, bool is_evicted);
+    uint64_t spill(LRUMemoryHandle *handle_ptr);
+    void* reload(LRUMemoryHandle *handle_ptr);
+    void release_tier(LRUMemoryHandle *handle_ptr);
+    bool complete_load(LRUMemoryHandle *handle_ptr);
+    void release_reference(LRUMemoryHandle *handle_ptr);
+    void unseal(LRUMemoryHandle *handle_ptr);
+    void spill_references(LRUMemoryHandle *owner_ptr, uint64_t locator);
+    void reseal(LRUMemoryHandle *handle_ptr);
+    void drop_references(LRUMemoryHandle *handle_ptr);
+    void transfer_hunk(LRUMemoryHandle *from_handle_ptr, LRUMemoryHandle *to_handle_ptr);
+#if LRUMM_ENABLE_LATENCY
+    void* timed_get_buffer(LRUMemoryHandle *handle_ptr);
+    void* timed_alloc(LRUMemoryHandle *handle_ptr, size_t size);
+    void timed_free(LRUMemoryHandle *handle_ptr);
+#endif
+
+    void track_interior_gaps(const LRUMemoryHunk *hunk_ptr);
+#if LRUMM_ENABLE_STATS
+    void track_released_gap(const LRUMemoryHunk *hunk_ptr);
+#endif
 
     void unlink_lru(LRUMemoryHunk *hunk_ptr);
     void link_lru(LRUMemoryHunk *hunk_ptr);
 
+    struct ReleasedHunk {
+        const LRUMemoryHunk* hunk_ptr;
+        const LRUMemoryHunk* next_ptr; ///< Successor in address order when the hunk was released
+    };
+    static constexpr size_t RELEASE_LOG_SIZE = 256;
+
+    struct SealedHunk {
+        uint64_t hash;
+        uint32_t ref_count;
+    };
+
     size_t mem_total_size_;      ///< Total size of the memory pool
+    size_t mem_capacity_size_;   ///< Size of the reserved arena, the pool can grow back up to it
     size_t mem_allocated_size_;  ///< Currently allocated size
     void* mem_arena_ptr_;         ///< Pointer to the memory pool
+    LRUTraceRecorder* trace_recorder_ptr_; ///< Optional operation recorder
+    LRUSiteProfiler* site_profiler_ptr_; ///< Optional allocation site profiler
+    LRUMemoryTier* tier_ptr_;    ///< Optional second tier for evicted payloads
+    uint64_t release_epoch_;     ///< Number of released hunks, validates export cursors
+    std::array<ReleasedHunk, RELEASE_LOG_SIZE> release_log_; ///< The latest releases by epoch, moves export cursors past them
+    size_t interior_gap_count_;  ///< Free gaps between hunks; without any, first fit is the end of the pool
+    bool is_dedup_enabled_;      ///< Sealed payloads are deduplicated
+    uint64_t use_clock_;         ///< Allocations and refreshes so far, stamps the last use of a hunk
+    size_t large_threshold_;     ///< Smallest allocation placed in the large object region, 0 when off
+    size_t large_budget_;        ///< Bytes the large object region adds to the shared budget
+    size_t large_allocated_size_; ///< Bytes mapped for large objects
+    LRUMemoryHunk* large_head_hunk_ptr_; ///< Sentinel of the LRU list of the large objects
+    uint32_t epoch_ops_;         ///< Operations per recency epoch, 0 when not bounded by operations
+    uint32_t epoch_ms_;          ///< Milliseconds per recency epoch, 0 when not bounded by time
+    uint32_t epoch_;             ///< Current recency epoch
+    uint64_t epoch_end_clock_;   ///< Operation clock at which the current epoch ends
+    uint64_t epoch_end_ms_;      ///< Coarse time at which the current epoch ends
+    std::unordered_map<const LRUMemoryHunk*, SealedHunk> sealed_hunks_; ///< Hash and references of the sealed hunks
+    std::unordered_multimap<uint64_t, LRUMemoryHunk*> seal_index_;      ///< Sealed hunks by payload hash
+#if LRUMM_ENABLE_STATS
+    detail::StatsRegistry stats_; ///< Operation counters
+    detail::GapTracker gaps_; ///< Free gaps of the pool
+#endif
+#if LRUMM_ENABLE_LATENCY
+    detail::LatencyRecorder latency_; ///< Sampled operation latencies
+#endif
+
+    friend LRUAppendWriter;
 };
 
 // Inline implementations
@@ -134,6 +396,11 @@ void*
 LRUMemoryManager::get_buffer_and_refresh(LRUMemoryHandle *handle_ptr)
 {
     Expects(handle_ptr != nullptr);
+#if LRUMM_ENABLE_LATENCY
+    if (latency_.sample(detail::LatencyOp::Refresh)) {
+        return timed_get_buffer(handle_ptr);
+    }
+#endif
     return real_get_buffer(handle_ptr);
 }
 
@@ -142,7 +409,28 @@ void
 LRUMemoryManager::free(LRUMemoryHandle *handle_ptr)
 {
     Expects(handle_ptr);
+    if (handle_ptr->is_spilled()) {
+        release_tier(handle_ptr);
+        return;
+    }
     Expects(handle_ptr->hunk_ptr_); // LRUMemoryManager::free: not allocated.
+    LRUMM_STAT_ADD(stats_, frees, 1);
+    if (trace_recorder_ptr_) {
+        trace_recorder_ptr_->record(LRUTraceOp::Free, handle_ptr, handle_ptr->size());
+    }
+    if (handle_ptr->is_shared()) {
+        release_reference(handle_ptr); // the other references keep the hunk
+        return;
+    }
+    if (handle_ptr->site_index_) {
+        release_site(handle_ptr, false);
+    }
+#if LRUMM_ENABLE_LATENCY
+    if (latency_.sample(detail::LatencyOp::Free)) {
+        timed_free(handle_ptr);
+        return;
+    }
+#endif
     real_free(handle_ptr);
 }
 
@@ -152,7 +440,22 @@ LRUMemoryManager::alloc(LRUMemoryHandle *handle_ptr, size_t size)
 {
     Expects(size > 0);
     Expects(handle_ptr != nullptr);
-    return real_alloc(handle_ptr, size);
+
+    // Sampled here, in the caller, so that the captured stack starts at the call site
+    uint32_t site_index = site_profiler_ptr_ ? site_profiler_ptr_->sample(get_hunk_footprint(size)) : 0;
+
+#if LRUMM_ENABLE_LATENCY
+    void* buffer_ptr = latency_.sample(detail::LatencyOp::Alloc) ? timed_alloc(handle_ptr, size) : real_alloc(handle_ptr, size);
+#else
+    void* buffer_ptr = real_alloc(handle_ptr, size);
+#endif
+
+    if (buffer_ptr) {
+        handle_ptr->site_index_ = site_index;
+    } else if (site_index) {
+        site_profiler_ptr_->cancel(site_index, get_hunk_footprint(size));
+    }
+    return buffer_ptr;
 }
 
 inline
@@ -162,5 +465,108 @@ LRUMemoryManager::get_allocated_memory_size() const
     return mem_allocated_size_;
 }
 
+inline
+size_t
+LRUMemoryManager::get_pool_size() const
+{
+    return mem_total_size_;
+}
+
+inline
+size_t
+LRUMemoryManager::get_pool_capacity() const
+{
+    return mem_capacity_size_;
+}
+
+inline
+size_t
+LRUMemoryManager::get_large_allocated_size() const
+{
+    return large_allocated_size_;
+}
+
+inline
+LRUMemoryStats
+LRUMemoryManager::get_stats() const
+{
+    LRUMemoryStats stats;
+#if LRUMM_ENABLE_STATS
+    stats_.snapshot(stats);
+    gaps_.snapshot(stats);
+    stats.free_bytes = mem_total_size_ - mem_allocated_size_;
+#endif
+#if LRUMM_ENABLE_LATENCY
+    latency_.snapshot(stats);
+#endif
+    return stats;
+}
+
+inline
+void
+LRUMemoryManager::reset_stats()
+{
+#if LRUMM_ENABLE_STATS
+    stats_.reset(mem_allocated_size_);
+#endif
+#if LRUMM_ENABLE_LATENCY
+    latency_.reset();
+#endif
+}
+
+inline
+size_t
+LRUMemoryManager::export_state(LRUExportFormat format, char* buffer_ptr, size_t buffer_size) const
+{
+    return export_stats(get_stats(), mem_total_size_, mem_allocated_size_, format, buffer_ptr, buffer_size);
+}
+
+inline
+void
+LRUMemoryManager::set_trace_recorder(LRUTraceRecorder *recorder_ptr)
+{
+    trace_recorder_ptr_ = recorder_ptr;
+}
+
+inline
+void
+LRUMemoryManager::set_dedup_enabled(bool is_enabled)
+{
+    is_dedup_enabled_ = is_enabled;
+}
+
+inline
+void
+LRUMemoryManager::set_large_object_region(size_t threshold, size_t budget)
+{
+    large_threshold_ = threshold;
+    large_budget_ = budget;
+}
+
+inline
+void
+LRUMemoryManager::set_tier(LRUMemoryTier *tier_ptr)
+{
+    tier_ptr_ = tier_ptr;
+}
+
+inline
+void
+LRUMemoryManager::set_site_profiler(LRUSiteProfiler *profiler_ptr)
+{
+    site_profiler_ptr_ = profiler_ptr;
+}
+
+inline
+void
+LRUMemoryManager::set_latency_sample_period(uint32_t sample_period)
+{
+#if LRUMM_ENABLE_LATENCY
+    latency_.set_sample_period(sample_period);
+#else
+    (void)sample_period;
+#endif
+}
+
 }
 #endif // LRU_MEMORY_MANAGER__H
@@ -0,0 +1,108 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include "lrumemorypressure.h"
+
+namespace lrumm {
+
+LRUPressureMonitor::LRUPressureMonitor(LRUMemoryManager& manager, const LRUPressureConfig& config)
+    : manager_(manager)
+    , config_(config)
+{
+    Expects(config.shrink_ratio > 0.0 && config.shrink_ratio < 1.0);
+    Expects(config.clear_avg10 <= config.shrink_avg10);
+}
+
+LRUPressureAction
+LRUPressureMonitor::poll()
+{
+    double avg10 = 0.0;
+    uint64_t event_count = 0;
+    bool has_pressure = read_pressure(avg10);
+    bool has_events = read_events(event_count);
+    is_available_ = has_pressure || has_events;
+    avg10_ = avg10;
+    if (!is_available_) {
+        return LRUPressureAction::None;
+    }
+
+    bool has_new_events = has_events && has_event_count_ && event_count > event_count_;
+    if (has_events) {
+        event_count_ = event_count;
+        has_event_count_ = true;
+    }
+
+    size_t pool_size = manager_.get_pool_size();
+    if (has_new_events || (has_pressure && avg10 >= config_.shrink_avg10)) {
+        cleared_polls_ = 0;
+        size_t min_pool_size = std::max(config_.min_pool_size, LRUMemoryManager::get_hunk_footprint(0));
+        size_t new_pool_size = std::max(static_cast<size_t>(static_cast<double>(pool_size) * config_.shrink_ratio), min_pool_size);
+        if (new_pool_size < pool_size && manager_.resize_pool(new_pool_size)) {
+            return LRUPressureAction::Shrink;
+        }
+        return LRUPressureAction::None;
+    }
+
+    // Between the thresholds the pool stays as it is
+    if (has_pressure && avg10 > config_.clear_avg10) {
+        cleared_polls_ = 0;
+        return LRUPressureAction::None;
+    }
+    if (++cleared_polls_ < config_.clear_polls || pool_size == manager_.get_pool_capacity()) {
+        return LRUPressureAction::None;
+    }
+    cleared_polls_ = 0;
+    size_t new_pool_size = std::min(static_cast<size_t>(static_cast<double>(pool_size) / config_.shrink_ratio),
+        manager_.get_pool_capacity());
+    manager_.resize_pool(new_pool_size);
+    return LRUPressureAction::Grow;
+}
+
+bool
+LRUPressureMonitor::read_pressure(double& avg10) const
+{
+    std::FILE* file_ptr = std::fopen(config_.pressure_path, "r");
+    if (!file_ptr) {
+        return false;
+    }
+
+    // some avg10=0.00 avg60=0.00 avg300=0.00 total=0
+    char line[256];
+    bool is_read = false;
+    while (!is_read && std::fgets(line, sizeof(line), file_ptr)) {
+        is_read = std::sscanf(line, "some avg10=%lf", &avg10) == 1;
+    }
+    std::fclose(file_ptr);
+    return is_read;
+}
+
+bool
+LRUPressureMonitor::read_events(uint64_t& event_count) const
+{
+    std::FILE* file_ptr = std::fopen(config_.events_path, "r");
+    if (!file_ptr) {
+        return false;
+    }
+
+    // One "name count" pair per line; low only reports reclaim below the protection
+    char line[256];
+    char name[64];
+    unsigned long long count;
+    bool is_read = false;
+    event_count = 0;
+    while (std::fgets(line, sizeof(line), file_ptr)) {
+        if (std::sscanf(line, "%63s %llu", name, &count) != 2) {
+            continue;
+        }
+        is_read = true;
+        if (std::strcmp(name, "high") == 0 || std::strcmp(name, "max") == 0
+            || std::strcmp(name, "oom") == 0 || std::strcmp(name, "oom_kill") == 0) {
+            event_count += count;
+        }
+    }
+    std::fclose(file_ptr);
+    return is_read;
+}
+
+}
@@ -0,0 +1,69 @@
+#ifndef LRU_MEMORY_PRESSURE__H
+#define LRU_MEMORY_PRESSURE__H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "lrumemorymanager.h"
+
+namespace lrumm {
+
+/**
+ * @brief Where the monitor reads the pressure from and how it reacts
+ *
+ * The paths default to the cgroup v2 files of the current cgroup in a container;
+ * any file in the same format can stand in for them.
+ */
+struct LRUPressureConfig {
+    const char* pressure_path = "/sys/fs/cgroup/memory.pressure"; ///< PSI file, the "some avg10" stall percentage is read
+    const char* events_path = "/sys/fs/cgroup/memory.events";     ///< The high, max, oom and oom_kill counts are read
+    double shrink_avg10 = 10.0;  ///< Stall percentage at or above which the pool shrinks
+    double clear_avg10 = 1.0;    ///< Stall percentage at or below which the pressure has cleared
+    double shrink_ratio = 0.75;  ///< Part of the pool size one shrink keeps; one grow divides by it
+    size_t min_pool_size = 0;    ///< The pool is not shrunk below this size
+    uint32_t clear_polls = 3;    ///< Consecutive cleared polls before the pool grows
+};
+
+enum class LRUPressureAction {
+    None,
+    Shrink,
+    Grow,
+};
+
+/**
+ * @brief Resizes the pool of a manager as the memory pressure of its cgroup rises and clears
+ *
+ * Each poll() reads both files once. The pool shrinks while the stall percentage
+ * is at or above the shrink threshold, or when the limit events counted in the
+ * events file have grown since the previous poll; see LRUMemoryManager::resize_pool().
+ * After clear_polls polls in a row at or below the clear threshold, without new
+ * events, it grows back a step, up to the size the manager was constructed with.
+ * A missing file is ignored. poll() is called by the thread that owns the manager.
+ */
+class LRUPressureMonitor {
+public:
+    explicit LRUPressureMonitor(LRUMemoryManager& manager, const LRUPressureConfig& config = LRUPressureConfig());
+
+    LRUPressureMonitor(const LRUPressureMonitor&) = delete;
+    LRUPressureMonitor& operator=(const LRUPressureMonitor&) = delete;
+
+    LRUPressureAction poll();
+
+    bool is_available() const { return is_available_; } ///< The last poll read at least one of the files
+    double avg10() const { return avg10_; }             ///< Stall percentage read by the last poll
+
+private:
+    bool read_pressure(double& avg10) const;
+    bool read_events(uint64_t& event_count) const;
+
+    LRUMemoryManager& manager_;
+    LRUPressureConfig config_;
+    bool is_available_ = false;
+    double avg10_ = 0.0;
+    bool has_event_count_ = false; ///< The first poll only takes the count as the baseline
+    uint64_t event_count_ = 0;
+    uint32_t cleared_polls_ = 0;
+};
+
+}
+#endif // LRU_MEMORY_PRESSURE__H
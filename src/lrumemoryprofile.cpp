@@ -0,0 +1,192 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__GLIBC__)
+#include <execinfo.h>
+#endif
+
+#include "lrumemorymanager.h"
+#include "lrumemoryprofile.h"
+
+namespace lrumm {
+
+static const char OVERFLOW_SITE_TAG[] = "<other sites>";
+
+LRUSiteProfiler::LRUSiteProfiler(uint64_t sample_period, uint32_t stack_depth, size_t max_sites, uint64_t seed)
+    : sample_period_(sample_period > 0 ? sample_period : 1)
+    , stack_depth_(std::min(stack_depth, LRUSiteStats::MAX_FRAMES))
+    , max_sites_(max_sites > 0 ? max_sites : 1)
+    , rng_state_(seed ? seed : 1)
+    , bytes_until_sample_(0)
+{
+    bytes_until_sample_ = next_interval();
+}
+
+uint64_t
+LRUSiteProfiler::next_interval()
+{
+    // xorshift64*, then an exponential interval with the mean of the sample period
+    rng_state_ ^= rng_state_ >> 12;
+    rng_state_ ^= rng_state_ << 25;
+    rng_state_ ^= rng_state_ >> 27;
+    uint64_t random = rng_state_ * 0x2545F4914F6CDD1Dull;
+
+    double uniform = (static_cast<double>(random >> 11) + 1.0) / 9007199254740992.0; // (0, 1]
+    double interval = -std::log(uniform) * static_cast<double>(sample_period_);
+    return interval < 1.0 ? 1 : static_cast<uint64_t>(interval);
+}
+
+uint64_t
+LRUSiteProfiler::sample_weight(size_t footprint) const
+{
+    // An allocation of s bytes is sampled with probability 1 - exp(-s / period);
+    // dividing by it keeps the per-site estimates unbiased
+    double size = static_cast<double>(footprint);
+    double probability = -std::expm1(-size / static_cast<double>(sample_period_));
+    return static_cast<uint64_t>(size / probability + 0.5);
+}
+
+uint32_t
+LRUSiteProfiler::record_sample(size_t footprint)
+{
+    bytes_until_sample_ = next_interval();
+
+    LRUSiteStats key;
+    key.tag = site_tag_;
+#if defined(__GLIBC__)
+    if (!key.tag && stack_depth_ > 0) {
+        // The first frame is this function
+        void* frames[LRUSiteStats::MAX_FRAMES + 1];
+        int depth = backtrace(frames, static_cast<int>(stack_depth_) + 1);
+        for (int i = 1; i < depth; ++i) {
+            key.frames[key.frame_count++] = reinterpret_cast<uintptr_t>(frames[i]);
+        }
+    }
+#endif
+
+    uint32_t site_index = find_site(key);
+    LRUSiteStats& site = sites_[site_index - 1];
+    uint64_t weight = sample_weight(footprint);
+    site.samples++;
+    site.alloc_bytes += weight;
+    site.live_bytes += weight;
+    return site_index;
+}
+
+uint32_t
+LRUSiteProfiler::find_site(const LRUSiteStats& key)
+{
+    auto itr = site_index_.find(key);
+    if (itr != site_index_.end()) {
+        return itr->second;
+    }
+
+    if (sites_.size() >= max_sites_) {
+        // Once the table is full, new sites share one overflow entry
+        LRUSiteStats overflow_key;
+        overflow_key.tag = OVERFLOW_SITE_TAG;
+        itr = site_index_.find(overflow_key);
+        if (itr != site_index_.end()) {
+            return itr->second;
+        }
+        sites_.push_back(overflow_key);
+        return site_index_[overflow_key] = static_cast<uint32_t>(sites_.size());
+    }
+
+    sites_.push_back(key);
+    return site_index_[key] = static_cast<uint32_t>(sites_.size());
+}
+
+void
+LRUSiteProfiler::release(uint32_t site_index, size_t footprint, bool is_evicted)
+{
+    Expects(site_index > 0 && site_index <= sites_.size());
+
+    LRUSiteStats& site = sites_[site_index - 1];
+    uint64_t weight = sample_weight(footprint);
+    site.live_bytes -= std::min(site.live_bytes, weight);
+    if (is_evicted) {
+        site.evicted_bytes += weight;
+    } else {
+        site.freed_bytes += weight;
+    }
+}
+
+void
+LRUSiteProfiler::cancel(uint32_t site_index, size_t footprint)
+{
+    Expects(site_index > 0 && site_index <= sites_.size());
+
+    LRUSiteStats& site = sites_[site_index - 1];
+    uint64_t weight = sample_weight(footprint);
+    site.samples--;
+    site.alloc_bytes -= std::min(site.alloc_bytes, weight);
+    site.live_bytes -= std::min(site.live_bytes, weight);
+}
+
+std::vector<LRUSiteStats>
+LRUSiteProfiler::sites() const
+{
+    std::vector<LRUSiteStats> sorted_sites = sites_;
+    std::stable_sort(sorted_sites.begin(), sorted_sites.end(), [](const LRUSiteStats& lhs, const LRUSiteStats& rhs) {
+        return lhs.live_bytes > rhs.live_bytes;
+    });
+    return sorted_sites;
+}
+
+void
+LRUSiteProfiler::print_report(std::FILE* file_ptr, size_t max_sites) const
+{
+    Expects(file_ptr != nullptr);
+
+    auto sorted_sites = sites();
+    std::fprintf(file_ptr, "%zu allocation sites, sample period %llu bytes\n", sorted_sites.size(),
+        static_cast<unsigned long long>(sample_period_));
+    std::fprintf(file_ptr, "%14s %14s %14s %14s %10s  site\n", "live", "allocated", "evicted", "freed", "samples");
+
+    size_t count = std::min(max_sites, sorted_sites.size());
+    for (size_t i = 0; i < count; ++i) {
+        const LRUSiteStats& site = sorted_sites[i];
+        std::fprintf(file_ptr, "%14llu %14llu %14llu %14llu %10llu  ", static_cast<unsigned long long>(site.live_bytes),
+            static_cast<unsigned long long>(site.alloc_bytes), static_cast<unsigned long long>(site.evicted_bytes),
+            static_cast<unsigned long long>(site.freed_bytes), static_cast<unsigned long long>(site.samples));
+
+        if (site.tag || site.frame_count == 0) {
+            std::fprintf(file_ptr, "%s\n", site.tag ? site.tag : "<unknown>");
+            continue;
+        }
+#if defined(__GLIBC__)
+        void* frames[LRUSiteStats::MAX_FRAMES];
+        for (uint32_t frame = 0; frame < site.frame_count; ++frame) {
+            frames[frame] = reinterpret_cast<void*>(site.frames[frame]);
+        }
+        char** symbols = backtrace_symbols(frames, static_cast<int>(site.frame_count));
+        for (uint32_t frame = 0; frame < site.frame_count; ++frame) {
+            // Continuation lines line up under the first frame
+            std::fprintf(file_ptr, "%*s%s\n", frame ? 72 : 0, "", symbols ? symbols[frame] : "?");
+        }
+        std::free(symbols);
+#endif
+    }
+}
+
+size_t
+LRUSiteProfiler::SiteKeyHash::operator()(const LRUSiteStats& key) const
+{
+    uint64_t hash = reinterpret_cast<uintptr_t>(key.tag) * 0x9E3779B97F4A7C15ull;
+    for (uint32_t i = 0; i < key.frame_count; ++i) {
+        hash = (hash ^ key.frames[i]) * 0x100000001B3ull;
+    }
+    return static_cast<size_t>(hash ^ (hash >> 32));
+}
+
+bool
+LRUSiteProfiler::SiteKeyEqual::operator()(const LRUSiteStats& lhs, const LRUSiteStats& rhs) const
+{
+    return lhs.tag == rhs.tag && lhs.frame_count == rhs.frame_count
+        && std::equal(lhs.frames, lhs.frames + lhs.frame_count, rhs.frames);
+}
+
+}
@@ -0,0 +1,122 @@
+#ifndef LRU_MEMORY_PROFILE__H
+#define LRU_MEMORY_PROFILE__H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <unordered_map>
+#include <vector>
+
+namespace lrumm {
+
+/**
+ * @brief Estimated pool usage of one allocation site
+ *
+ * All byte counts are pool bytes (the hunk footprint, header and alignment
+ * included) scaled up from the sampled allocations, so they estimate the totals
+ * of every allocation made at the site.
+ */
+struct LRUSiteStats {
+    static constexpr uint32_t MAX_FRAMES = 8;
+
+    const char* tag = nullptr;           ///< Caller-supplied tag, nullptr for a stack site
+    uintptr_t frames[MAX_FRAMES] = {};   ///< Return addresses, innermost first
+    uint32_t frame_count = 0;
+    uint64_t samples = 0;                ///< Sampled allocations
+    uint64_t alloc_bytes = 0;            ///< Bytes allocated
+    uint64_t live_bytes = 0;             ///< Bytes still resident in the pool
+    uint64_t freed_bytes = 0;            ///< Bytes released by free() or flush()
+    uint64_t evicted_bytes = 0;          ///< Bytes evicted to make room for other allocations
+};
+
+/**
+ * @brief Samples allocations and attributes their pool bytes to allocation sites
+ *
+ * One allocation is sampled about every sample_period allocated bytes, with
+ * exponentially distributed intervals so that periodic allocation patterns do
+ * not alias with the sampling. A sampled allocation is attributed to the current
+ * site tag when one is set, otherwise to a short stack of its caller. The site
+ * is kept in the handle, so evictions and frees of sampled allocations are
+ * charged back to the site they came from. Unsampled allocations cost one
+ * subtraction. Like the manager, a profiler is used by a single thread.
+ */
+class LRUSiteProfiler {
+public:
+    explicit LRUSiteProfiler(uint64_t sample_period = 512 * 1024, uint32_t stack_depth = 4,
+        size_t max_sites = 4096, uint64_t seed = 0x9E3779B97F4A7C15ull);
+
+    LRUSiteProfiler(const LRUSiteProfiler&) = delete;
+    LRUSiteProfiler& operator=(const LRUSiteProfiler&) = delete;
+
+    /**
+     * @brief Attributes the following allocations to tag instead of their stack
+     *
+     * Tags are compared by address, string literals work best. nullptr returns
+     * to stack sites.
+     */
+    void set_site_tag(const char* tag) { site_tag_ = tag; }
+    const char* site_tag() const { return site_tag_; }
+
+    uint64_t sample_period() const { return sample_period_; }
+
+    /**
+     * @brief Counts footprint allocated bytes, returns the site of a sampled allocation or 0
+     */
+    uint32_t sample(size_t footprint);
+
+    /**
+     * @brief Charges a sampled allocation that left the pool back to its site
+     */
+    void release(uint32_t site_index, size_t footprint, bool is_evicted);
+
+    /**
+     * @brief Withdraws a sampled allocation that failed
+     */
+    void cancel(uint32_t site_index, size_t footprint);
+
+    /**
+     * @brief All sites, most live bytes first
+     */
+    std::vector<LRUSiteStats> sites() const;
+
+    /**
+     * @brief Prints the sites with the most live bytes, symbolizing the stacks when possible
+     */
+    void print_report(std::FILE* file_ptr, size_t max_sites = 20) const;
+
+private:
+    struct SiteKeyHash {
+        size_t operator()(const LRUSiteStats& key) const;
+    };
+    struct SiteKeyEqual {
+        bool operator()(const LRUSiteStats& lhs, const LRUSiteStats& rhs) const;
+    };
+
+    uint32_t record_sample(size_t footprint);
+    uint32_t find_site(const LRUSiteStats& key);
+    uint64_t sample_weight(size_t footprint) const;
+    uint64_t next_interval();
+
+    uint64_t sample_period_;
+    uint32_t stack_depth_;
+    size_t max_sites_;
+    uint64_t rng_state_;
+    uint64_t bytes_until_sample_;  ///< Allocated bytes left until the next sample
+    const char* site_tag_ = nullptr;
+    std::vector<LRUSiteStats> sites_; ///< Site index i is sites_[i - 1]
+    std::unordered_map<LRUSiteStats, uint32_t, SiteKeyHash, SiteKeyEqual> site_index_;
+};
+
+inline
+uint32_t
+LRUSiteProfiler::sample(size_t footprint)
+{
+    if (footprint < bytes_until_sample_) {
+        bytes_until_sample_ -= footprint;
+        return 0;
+    }
+    return record_sample(footprint);
+}
+
+}
+#endif // LRU_MEMORY_PROFILE__H
@@ -0,0 +1,234 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <list>
+#include <unordered_map>
+
+#include "lrumemorymanager.h"
+#include "lrumemoryreplay.h"
+
+namespace lrumm {
+
+const std::vector<const char*>&
+replay_policy_names()
+{
+    static const std::vector<const char*> policy_names = { "lru", "lru-large", "lru-epoch" };
+    return policy_names;
+}
+
+bool
+apply_replay_policy(LRUMemoryManager& manager, const char* policy)
+{
+    if (std::strcmp(policy, "lru") == 0) {
+        return true;
+    }
+    if (std::strcmp(policy, "lru-large") == 0) {
+        // Payloads of 1/64 of the pool and more go to a region of a quarter of its size
+        manager.set_large_object_region(std::max<size_t>(manager.get_pool_size() / 64, 1), manager.get_pool_size() / 4);
+        return true;
+    }
+    if (std::strcmp(policy, "lru-epoch") == 0) {
+        // A hunk refreshed again within 1024 operations keeps its place
+        manager.set_recency_epoch(1024);
+        return true;
+    }
+    return false;
+}
+
+bool
+parse_size_argument(const char* text, size_t& size)
+{
+    char* end_ptr;
+    unsigned long long value = std::strtoull(text, &end_ptr, 0);
+    if (end_ptr == text) {
+        return false;
+    }
+
+    switch (*end_ptr) {
+        case 'G': case 'g': value <<= 10; [[fallthrough]];
+        case 'M': case 'm': value <<= 10; [[fallthrough]];
+        case 'K': case 'k': value <<= 10; end_ptr++; break;
+        default: break;
+    }
+    size = static_cast<size_t>(value);
+    return *end_ptr == '\0' && size > 0;
+}
+
+LRUTraceReplay::LRUTraceReplay(const std::vector<LRUTraceRecord>& records)
+{
+    std::unordered_map<uint64_t, uint32_t> slots;
+    steps_.reserve(records.size());
+
+    for (const auto& record : records) {
+        StepOp op;
+        switch (record.op()) {
+            case LRUTraceOp::Alloc: op = StepOp::Alloc; break;
+            case LRUTraceOp::Free: op = StepOp::Free; break;
+            case LRUTraceOp::Refresh: op = StepOp::Refresh; break;
+            default: continue; // evictions belong to the recording manager
+        }
+
+        auto slot_itr = slots.emplace(record.handle_id, static_cast<uint32_t>(slots.size())).first;
+        steps_.push_back({ slot_itr->second, record.size, op });
+    }
+    slot_count_ = slots.size();
+}
+
+namespace {
+
+// The replay drives either the real manager or the unfragmented reference
+// through the same four operations, keyed by the dense slot number.
+class ManagerCache {
+public:
+    ManagerCache(LRUMemoryManager& manager, size_t slot_count)
+        : manager_(manager)
+        , handles_(slot_count)
+    {}
+
+    bool is_live(uint32_t slot) const { return handles_[slot].hunk_ptr() != nullptr; }
+    bool alloc(uint32_t slot, uint32_t size) { return manager_.alloc(&handles_[slot], size) != nullptr; }
+    void free(uint32_t slot) { manager_.free(&handles_[slot]); }
+    bool refresh(uint32_t slot) { return manager_.get_buffer_and_refresh(&handles_[slot]) != nullptr; }
+
+private:
+    LRUMemoryManager& manager_;
+    std::vector<LRUMemoryManager::LRUMemoryHandle> handles_;
+};
+
+class UnfragmentedCache {
+public:
+    UnfragmentedCache(size_t pool_size, size_t slot_count)
+        : capacity_(pool_size - LRUMemoryManager::get_hunk_footprint(0)) // the head hunk
+        , used_(0)
+        , entries_(slot_count)
+    {}
+
+    bool is_live(uint32_t slot) const { return entries_[slot].footprint != 0; }
+
+    bool alloc(uint32_t slot, uint32_t size)
+    {
+        size_t footprint = LRUMemoryManager::get_hunk_footprint(size);
+        if (footprint > capacity_) {
+            lru_.clear();
+            for (auto& entry : entries_) {
+                entry.footprint = 0;
+            }
+            used_ = 0;
+            return false;
+        }
+        while (used_ + footprint > capacity_) {
+            free(lru_.back());
+        }
+        lru_.push_front(slot);
+        entries_[slot].lru_itr = lru_.begin();
+        entries_[slot].footprint = footprint;
+        used_ += footprint;
+        return true;
+    }
+
+    void free(uint32_t slot)
+    {
+        Entry& entry = entries_[slot];
+        lru_.erase(entry.lru_itr);
+        used_ -= entry.footprint;
+        entry.footprint = 0;
+    }
+
+    bool refresh(uint32_t slot)
+    {
+        Entry& entry = entries_[slot];
+        if (entry.footprint == 0) {
+            return false;
+        }
+        lru_.splice(lru_.begin(), lru_, entry.lru_itr);
+        return true;
+    }
+
+private:
+    struct Entry {
+        std::list<uint32_t>::iterator lru_itr;
+        size_t footprint = 0;
+    };
+
+    size_t capacity_;
+    size_t used_;
+    std::list<uint32_t> lru_;
+    std::vector<Entry> entries_;
+};
+
+}
+
+template<typename Cache, typename Observe>
+LRUReplayResult
+LRUTraceReplay::replay_steps(Cache& cache, uint64_t observe_interval, Observe&& observe) const
+{
+    LRUReplayResult result;
+    std::vector<uint32_t> sizes(slot_count_, 0);
+
+    uint64_t observer_ns = 0;
+    uint64_t start_ns = detail::now_ns();
+    for (const Step& step : steps_) {
+        switch (step.op) {
+            case StepOp::Alloc:
+                sizes[step.slot] = step.size;
+                if (!cache.is_live(step.slot) && step.size > 0) {
+                    result.allocs++;
+                    if (!cache.alloc(step.slot, step.size)) {
+                        result.failed_allocs++;
+                    }
+                }
+                break;
+
+            case StepOp::Free:
+                if (cache.is_live(step.slot)) {
+                    result.frees++;
+                    cache.free(step.slot);
+                }
+                break;
+
+            case StepOp::Refresh:
+                if (sizes[step.slot] == 0) {
+                    break; // never allocated, nothing to compare with
+                }
+                result.refreshes++;
+                if (cache.refresh(step.slot)) {
+                    result.hits++;
+                    result.hit_bytes += sizes[step.slot];
+                } else {
+                    result.misses++;
+                    result.miss_bytes += sizes[step.slot];
+                    result.allocs++;
+                    if (!cache.alloc(step.slot, sizes[step.slot])) {
+                        result.failed_allocs++;
+                    }
+                }
+                break;
+        }
+
+        result.steps++;
+        if (observe_interval && result.steps % observe_interval == 0) {
+            uint64_t observer_start_ns = detail::now_ns();
+            observe(result.steps);
+            observer_ns += detail::now_ns() - observer_start_ns;
+        }
+    }
+    result.elapsed_ns = detail::now_ns() - start_ns - observer_ns;
+
+    return result;
+}
+
+LRUReplayResult
+LRUTraceReplay::run(LRUMemoryManager& manager, uint64_t observe_interval, const Observer& observer) const
+{
+    ManagerCache cache(manager, slot_count_);
+    return replay_steps(cache, observe_interval, [&manager, &observer](uint64_t step) { observer(manager, step); });
+}
+
+LRUReplayResult
+LRUTraceReplay::run_unfragmented(size_t pool_size) const
+{
+    UnfragmentedCache cache(pool_size, slot_count_);
+    return replay_steps(cache, 0, [](uint64_t) {});
+}
+
+}
@@ -0,0 +1,108 @@
+#ifndef LRU_MEMORY_REPLAY__H
+#define LRU_MEMORY_REPLAY__H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "lrumemorytrace.h"
+
+namespace lrumm {
+
+class LRUMemoryManager;
+
+/**
+ * @brief Outcome of replaying a trace against one manager
+ */
+struct LRUReplayResult {
+    uint64_t steps = 0;         ///< Replayed operations
+    uint64_t refreshes = 0;     ///< Refresh requests of previously allocated handles
+    uint64_t hits = 0;          ///< Refreshes served from the pool
+    uint64_t misses = 0;        ///< Refreshes that had to allocate again
+    uint64_t hit_bytes = 0;     ///< Payload bytes of the hits
+    uint64_t miss_bytes = 0;    ///< Payload bytes of the misses
+    uint64_t allocs = 0;        ///< Allocations issued, including the refills after a miss
+    uint64_t failed_allocs = 0; ///< Allocations the manager could not satisfy
+    uint64_t frees = 0;         ///< Explicit frees
+    uint64_t elapsed_ns = 0;    ///< Wall time of the replay loop, without the observer calls
+
+    double hit_ratio() const
+    {
+        return refreshes ? static_cast<double>(hits) / static_cast<double>(refreshes) : 0.0;
+    }
+
+    double byte_hit_ratio() const
+    {
+        uint64_t bytes = hit_bytes + miss_bytes;
+        return bytes ? static_cast<double>(hit_bytes) / static_cast<double>(bytes) : 0.0;
+    }
+};
+
+/**
+ * @brief Names of the manager configurations a trace can be replayed under
+ */
+const std::vector<const char*>& replay_policy_names();
+
+/**
+ * @brief Configures a fresh manager for the named policy, returns false for an unknown name
+ */
+bool apply_replay_policy(LRUMemoryManager& manager, const char* policy);
+
+/**
+ * @brief Parses a byte count with an optional K, M or G suffix
+ */
+bool parse_size_argument(const char* text, size_t& size);
+
+/**
+ * @brief Replays a recorded trace as a sequence of cache accesses
+ *
+ * The recorded handle ids are mapped to dense slots up front, so the replay loop
+ * only touches the manager and two flat arrays. A refresh of a handle the replaying
+ * manager has dropped counts as a miss and allocates the handle again with its last
+ * known size, the way the recorded application refills its cache. A recorded alloc
+ * of a handle that is still live in the replay is skipped, as it only reflects a
+ * miss of the recording process. Recorded evictions are ignored: the replaying
+ * manager makes its own decisions.
+ */
+class LRUTraceReplay {
+public:
+    using Observer = std::function<void(const LRUMemoryManager&, uint64_t step)>;
+
+    explicit LRUTraceReplay(const std::vector<LRUTraceRecord>& records);
+
+    size_t slot_count() const { return slot_count_; }
+    size_t step_count() const { return steps_.size(); }
+
+    /**
+     * @brief Replays all steps; the observer, if any, is called every observe_interval steps
+     */
+    LRUReplayResult run(LRUMemoryManager& manager, uint64_t observe_interval = 0, const Observer& observer = {}) const;
+
+    /**
+     * @brief Replays all steps through a byte-budget LRU that never fragments
+     *
+     * Every buffer is charged its full hunk footprint, so the only difference to run()
+     * with the same pool size is the placement: this is the hit ratio a key-only
+     * simulator would predict.
+     */
+    LRUReplayResult run_unfragmented(size_t pool_size) const;
+
+private:
+    enum class StepOp : uint8_t { Alloc, Free, Refresh };
+
+    struct Step {
+        uint32_t slot;
+        uint32_t size;
+        StepOp op;
+    };
+
+    template<typename Cache, typename Observe>
+    LRUReplayResult replay_steps(Cache& cache, uint64_t observe_interval, Observe&& observe) const;
+
+    std::vector<Step> steps_;
+    size_t slot_count_ = 0;
+};
+
+}
+#endif // LRU_MEMORY_REPLAY__H
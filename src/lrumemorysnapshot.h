@@ -0,0 +1,36 @@
+#ifndef LRU_MEMORY_SNAPSHOT__H
+#define LRU_MEMORY_SNAPSHOT__H
+
+#include <cstdint>
+
+namespace lrumm {
+
+/**
+ * @brief Header of a warm-start snapshot file
+ *
+ * The header is followed by hunk_count records in recency order, least recent
+ * first, and then the payloads of the hunks in the same order, back to back.
+ */
+struct LRUSnapshotHeader {
+    static constexpr char MAGIC[8] = { 'L', 'R', 'U', 'S', 'N', 'A', 'P', 'S' };
+    static constexpr uint32_t VERSION = 1;
+
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    uint64_t hunk_count;
+    uint64_t payload_size; ///< Sum of the payload sizes
+};
+static_assert(sizeof(LRUSnapshotHeader) == 32, "LRUSnapshotHeader must stay 32 bytes");
+
+/**
+ * @brief One snapshot hunk: the caller key of its handle and its payload size
+ */
+struct LRUSnapshotRecord {
+    uint64_t key;
+    uint64_t size;
+};
+static_assert(sizeof(LRUSnapshotRecord) == 16, "LRUSnapshotRecord must stay 16 bytes");
+
+}
+#endif // LRU_MEMORY_SNAPSHOT__H
@@ -0,0 +1,281 @@
+#ifndef LRU_MEMORY_STATS__H
+#define LRU_MEMORY_STATS__H
+
+#include <cstddef>
+#include <cstdint>
+
+#ifndef LRUMM_ENABLE_STATS
+#define LRUMM_ENABLE_STATS 0
+#endif
+
+#ifndef LRUMM_THREADED_STATS
+#define LRUMM_THREADED_STATS 0
+#endif
+
+#ifndef LRUMM_STATS_SHARDS
+#define LRUMM_STATS_SHARDS 16
+#endif
+
+#include <array>
+
+#if LRUMM_THREADED_STATS
+#include <atomic>
+#endif
+
+namespace lrumm {
+
+/**
+ * @brief Percentiles of one sampled latency histogram, in nanoseconds
+ */
+struct LRULatencySummary {
+    uint64_t samples = 0; ///< Number of recorded samples
+    uint64_t p50 = 0;
+    uint64_t p99 = 0;
+    uint64_t p999 = 0;
+    uint64_t max = 0;
+};
+
+/**
+ * @brief Snapshot of the memory manager counters
+ *
+ * All counters are zero unless the library is built with LRUMM_ENABLE_STATS,
+ * the latency summaries are filled only with LRUMM_ENABLE_LATENCY.
+ */
+struct LRUMemoryStats {
+    uint64_t hits = 0;                ///< Refreshes of a live handle
+    uint64_t misses = 0;              ///< Refreshes of an evicted (or never allocated) handle
+    uint64_t allocs = 0;              ///< Successful allocations
+    uint64_t frees = 0;               ///< Explicit frees, evictions are not included
+    uint64_t evictions = 0;           ///< Hunks evicted to make room for an allocation
+    uint64_t evictions_fragmentation = 0; ///< Evictions while the total free space would have fit the allocation
+    uint64_t evictions_capacity = 0;  ///< Evictions while the total free space was too small
+    uint64_t evicted_bytes = 0;       ///< Hunk bytes released by evictions
+    uint64_t failed_allocs = 0;       ///< Allocations that failed with nothing left to evict
+    uint64_t hunks_scanned = 0;       ///< Hunks visited while searching for free space
+    uint64_t tier_stores = 0;         ///< Evicted payloads kept by the second tier
+    uint64_t tier_stored_bytes = 0;   ///< Payload bytes kept by the second tier
+    uint64_t tier_loads = 0;          ///< Misses served by loading the payload back from the second tier
+    uint64_t seals = 0;               ///< Payloads sealed while deduplication was enabled
+    uint64_t seal_shares = 0;         ///< Seals that found an identical hunk and now share it
+    uint64_t seal_shared_bytes = 0;   ///< Hunk bytes released by sharing
+    uint64_t large_allocs = 0;        ///< Allocations placed in the large object region
+    uint64_t large_evictions = 0;     ///< Evictions of large objects, included in evictions
+    uint64_t pool_shrinks = 0;        ///< resize_pool() calls that released part of the pool
+    uint64_t pool_grows = 0;          ///< resize_pool() calls that took part of it back
+    uint64_t relinks_skipped = 0;     ///< Refreshes that left the hunk in place within its recency epoch
+    uint64_t peak_allocated_size = 0; ///< High-water mark of the allocated size
+
+    uint64_t free_bytes = 0;          ///< Unallocated bytes of the pool
+    uint64_t free_gap_count = 0;      ///< Number of free gaps between (and after) the hunks
+    uint64_t largest_free_gap = 0;    ///< Largest free gap
+    std::array<uint64_t, 64> gap_histogram{}; ///< Free gaps per power of two size, [2^i, 2^(i+1))
+
+    LRULatencySummary alloc_latency;       ///< alloc() latency
+    LRULatencySummary free_latency;        ///< free() latency
+    LRULatencySummary refresh_latency;     ///< get_buffer_and_refresh() latency
+    LRULatencySummary eviction_latency;    ///< Latency of the allocations that had to evict
+    LRULatencySummary evictions_per_alloc; ///< Hunks evicted per allocation (a count, not nanoseconds)
+
+    double hit_ratio() const
+    {
+        uint64_t refreshes = hits + misses;
+        return refreshes ? static_cast<double>(hits) / static_cast<double>(refreshes) : 0.0;
+    }
+
+    /**
+     * @brief Share of the free space that is not usable by the largest possible allocation
+     */
+    double external_fragmentation() const
+    {
+        return free_bytes ? 1.0 - static_cast<double>(largest_free_gap) / static_cast<double>(free_bytes) : 0.0;
+    }
+
+    double hunks_scanned_per_alloc() const
+    {
+        uint64_t attempts = allocs + failed_allocs;
+        return attempts ? static_cast<double>(hunks_scanned) / static_cast<double>(attempts) : 0.0;
+    }
+};
+
+namespace detail {
+
+#if LRUMM_THREADED_STATS
+/**
+ * @brief Counter with relaxed atomic increments, so a snapshot may be taken from any thread
+ */
+class StatsCounter {
+public:
+    StatsCounter& operator+=(uint64_t value)
+    {
+        value_.fetch_add(value, std::memory_order_relaxed);
+        return *this;
+    }
+    StatsCounter& operator-=(uint64_t value)
+    {
+        value_.fetch_sub(value, std::memory_order_relaxed);
+        return *this;
+    }
+    StatsCounter& operator=(uint64_t value)
+    {
+        value_.store(value, std::memory_order_relaxed);
+        return *this;
+    }
+    operator uint64_t() const { return value_.load(std::memory_order_relaxed); }
+private:
+    std::atomic<uint64_t> value_{0};
+};
+#else
+using StatsCounter = uint64_t;
+#endif
+
+struct StatsCounters {
+    StatsCounter hits{};
+    StatsCounter misses{};
+    StatsCounter allocs{};
+    StatsCounter frees{};
+    StatsCounter evictions{};
+    StatsCounter evictions_fragmentation{};
+    StatsCounter evictions_capacity{};
+    StatsCounter evicted_bytes{};
+    StatsCounter failed_allocs{};
+    StatsCounter hunks_scanned{};
+    StatsCounter tier_stores{};
+    StatsCounter tier_stored_bytes{};
+    StatsCounter tier_loads{};
+    StatsCounter seals{};
+    StatsCounter seal_shares{};
+    StatsCounter seal_shared_bytes{};
+    StatsCounter large_allocs{};
+    StatsCounter large_evictions{};
+    StatsCounter pool_shrinks{};
+    StatsCounter pool_grows{};
+    StatsCounter relinks_skipped{};
+
+    void accumulate_to(LRUMemoryStats& stats) const
+    {
+        stats.hits += hits;
+        stats.misses += misses;
+        stats.allocs += allocs;
+        stats.frees += frees;
+        stats.evictions += evictions;
+        stats.evictions_fragmentation += evictions_fragmentation;
+        stats.evictions_capacity += evictions_capacity;
+        stats.evicted_bytes += evicted_bytes;
+        stats.failed_allocs += failed_allocs;
+        stats.hunks_scanned += hunks_scanned;
+        stats.tier_stores += tier_stores;
+        stats.tier_stored_bytes += tier_stored_bytes;
+        stats.tier_loads += tier_loads;
+        stats.seals += seals;
+        stats.seal_shares += seal_shares;
+        stats.seal_shared_bytes += seal_shared_bytes;
+        stats.large_allocs += large_allocs;
+        stats.large_evictions += large_evictions;
+        stats.pool_shrinks += pool_shrinks;
+        stats.pool_grows += pool_grows;
+        stats.relinks_skipped += relinks_skipped;
+    }
+
+    void reset()
+    {
+        hits = 0;
+        misses = 0;
+        allocs = 0;
+        frees = 0;
+        evictions = 0;
+        evictions_fragmentation = 0;
+        evictions_capacity = 0;
+        evicted_bytes = 0;
+        failed_allocs = 0;
+        hunks_scanned = 0;
+        tier_stores = 0;
+        tier_stored_bytes = 0;
+        tier_loads = 0;
+        seals = 0;
+        seal_shares = 0;
+        seal_shared_bytes = 0;
+        large_allocs = 0;
+        large_evictions = 0;
+        pool_shrinks = 0;
+        pool_grows = 0;
+        relinks_skipped = 0;
+    }
+};
+
+/**
+ * @brief Counter storage of one manager
+ *
+ * In threaded builds threads are assigned round-robin to LRUMM_STATS_SHARDS cache
+ * line aligned shards: up to that many threads get a shard of their own, further
+ * threads share them. A snapshot sums the fixed number of shards.
+ */
+class StatsRegistry {
+public:
+#if LRUMM_THREADED_STATS
+    StatsCounters& local() { return shards_[shard_index()]; }
+#else
+    StatsCounters& local() { return counters_; }
+#endif
+
+    void update_peak(size_t allocated_size)
+    {
+        if (allocated_size > peak_allocated_size_) {
+            peak_allocated_size_ = allocated_size;
+        }
+    }
+
+    void snapshot(LRUMemoryStats& stats) const
+    {
+#if LRUMM_THREADED_STATS
+        for (const auto& shard : shards_) {
+            shard.accumulate_to(stats);
+        }
+#else
+        counters_.accumulate_to(stats);
+#endif
+        stats.peak_allocated_size = peak_allocated_size_;
+    }
+
+    void reset(size_t allocated_size)
+    {
+#if LRUMM_THREADED_STATS
+        for (auto& shard : shards_) {
+            shard.reset();
+        }
+#else
+        counters_.reset();
+#endif
+        peak_allocated_size_ = allocated_size;
+    }
+
+private:
+#if LRUMM_THREADED_STATS
+    struct alignas(64) StatsShard: StatsCounters {};
+
+    static size_t shard_index()
+    {
+        static std::atomic<size_t> next_index{0};
+        thread_local const size_t index = next_index.fetch_add(1, std::memory_order_relaxed) % LRUMM_STATS_SHARDS;
+        return index;
+    }
+
+    std::array<StatsShard, LRUMM_STATS_SHARDS> shards_;
+#else
+    StatsCounters counters_;
+#endif
+    StatsCounter peak_allocated_size_{};
+};
+
+}
+
+}
+
+#if LRUMM_ENABLE_STATS
+#define LRUMM_STAT_ADD(stats, field, value) ((stats).local().field += (value))
+#define LRUMM_STAT_PEAK(stats, value) ((stats).update_peak(value))
+#else
+#define LRUMM_STAT_ADD(stats, field, value) ((void)sizeof(value))
+#define LRUMM_STAT_PEAK(stats, value) ((void)sizeof(value))
+#endif
+
+#endif // LRU_MEMORY_STATS__H
@@ -0,0 +1,636 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "lrumemorycodec.h"
+#include "lrumemorymanager.h"
+#include "lrumemorytier.h"
+
+namespace lrumm {
+
+static constexpr uint64_t REGION_ALIGNMENT = 16;
+static constexpr size_t BATCH_ALIGNMENT = 4096; ///< Batches are page aligned, as direct I/O requires
+
+int
+detail::open_spill_file(const char* path, int extra_flags)
+{
+    Expects(path != nullptr);
+
+    int fd;
+    struct stat path_stat;
+    if (::stat(path, &path_stat) == 0 && S_ISDIR(path_stat.st_mode)) {
+        // An anonymous spill file disappears with the process
+        std::string file_template = std::string(path) + "/lrumm-spill-XXXXXX";
+        fd = ::mkostemp(&file_template[0], O_CLOEXEC | extra_flags);
+        if (fd >= 0) {
+            ::unlink(file_template.c_str());
+        }
+    } else {
+        fd = ::open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC | extra_flags, 0600);
+    }
+
+    if (fd < 0) {
+        LOG_ERROR("Failed to open spill file %s: %s.\n", path, std::strerror(errno));
+    }
+    return fd;
+}
+
+uint64_t
+detail::ExtentAllocator::allocate(uint64_t length)
+{
+    // Reuse the smallest released extent that fits
+    auto itr = free_by_length_.lower_bound(length);
+    if (itr != free_by_length_.end()) {
+        uint64_t free_length = itr->first;
+        uint64_t offset = itr->second;
+        free_by_length_.erase(itr);
+        free_by_offset_.erase(offset);
+        if (free_length > length) {
+            free_by_offset_.emplace(offset + length, free_length - length);
+            free_by_length_.emplace(free_length - length, offset + length);
+        }
+        return offset;
+    }
+
+    // Otherwise place it at the end
+    if (capacity_ > 0 && end_ + length > capacity_) {
+        return NO_EXTENT;
+    }
+    uint64_t offset = end_;
+    end_ += length;
+    return offset;
+}
+
+void
+detail::ExtentAllocator::release(uint64_t offset, uint64_t length)
+{
+    auto erase_free = [this](std::map<uint64_t, uint64_t>::iterator free_itr) {
+        auto range = free_by_length_.equal_range(free_itr->second);
+        for (auto itr = range.first; itr != range.second; ++itr) {
+            if (itr->second == free_itr->first) {
+                free_by_length_.erase(itr);
+                break;
+            }
+        }
+        return free_by_offset_.erase(free_itr);
+    };
+
+    // Merge with the free neighbours
+    auto next_itr = free_by_offset_.lower_bound(offset);
+    if (next_itr != free_by_offset_.end() && next_itr->first == offset + length) {
+        length += next_itr->second;
+        next_itr = erase_free(next_itr);
+    }
+    if (next_itr != free_by_offset_.begin()) {
+        auto prev_itr = std::prev(next_itr);
+        if (prev_itr->first + prev_itr->second == offset) {
+            offset = prev_itr->first;
+            length += prev_itr->second;
+            erase_free(prev_itr);
+        }
+    }
+
+    // A free extent at the end moves the end back instead
+    if (offset + length == end_) {
+        end_ = offset;
+        return;
+    }
+    free_by_offset_.emplace(offset, length);
+    free_by_length_.emplace(length, offset);
+}
+
+LRUFileTier::LRUFileTier(const char* path, uint64_t capacity, size_t block_size)
+    : block_size_(block_size > 0 ? block_size : 1)
+    , extents_(capacity)
+{
+    fd_ = detail::open_spill_file(path);
+}
+
+LRUFileTier::~LRUFileTier() noexcept
+{
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+}
+
+uint64_t
+LRUFileTier::store(const void* data_ptr, size_t size)
+{
+    if (fd_ < 0 || size == 0) {
+        return NO_LOCATOR;
+    }
+
+    uint64_t length = (size + block_size_ - 1) / block_size_ * block_size_;
+    uint64_t offset = extents_.allocate(length);
+    if (offset == detail::ExtentAllocator::NO_EXTENT) {
+        return NO_LOCATOR;
+    }
+
+    const uint8_t* src_ptr = static_cast<const uint8_t*>(data_ptr);
+    size_t written = 0;
+    while (written < size) {
+        ssize_t result = ::pwrite(fd_, src_ptr + written, size - written, static_cast<off_t>(offset + written));
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result <= 0) {
+            LOG_ERROR("Failed to write %zu bytes to the spill file: %s.\n", size, std::strerror(errno));
+            extents_.release(offset, length);
+            return NO_LOCATOR;
+        }
+        written += static_cast<size_t>(result);
+    }
+
+    uint64_t locator;
+    if (free_slots_.empty()) {
+        locator = stored_.size();
+        stored_.emplace_back();
+    } else {
+        locator = free_slots_.back();
+        free_slots_.pop_back();
+    }
+    stored_[locator] = Extent{ offset, size, length };
+    stored_bytes_ += size;
+    return locator;
+}
+
+bool
+LRUFileTier::load(uint64_t locator, void* buffer_ptr, size_t size)
+{
+    Expects(locator < stored_.size());
+    Expects(size <= stored_[locator].size);
+
+    uint8_t* dst_ptr = static_cast<uint8_t*>(buffer_ptr);
+    uint64_t offset = stored_[locator].offset;
+    size_t read_size = 0;
+    bool is_read = true;
+    while (read_size < size) {
+        ssize_t result = ::pread(fd_, dst_ptr + read_size, size - read_size, static_cast<off_t>(offset + read_size));
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result <= 0) {
+            LOG_ERROR("Failed to read %zu bytes from the spill file: %s.\n", size, std::strerror(errno));
+            is_read = false;
+            break;
+        }
+        read_size += static_cast<size_t>(result);
+    }
+
+    release(locator);
+    return is_read;
+}
+
+void
+LRUFileTier::release(uint64_t locator)
+{
+    Expects(locator < stored_.size() && stored_[locator].length > 0); // LRUFileTier::release: not stored.
+
+    Extent& extent = stored_[locator];
+    extents_.release(extent.offset, extent.length);
+    stored_bytes_ -= extent.size;
+    extent = Extent();
+    free_slots_.push_back(locator);
+}
+
+size_t
+LRUFileTier::stored_size(uint64_t locator) const
+{
+    Expects(locator < stored_.size());
+    return stored_[locator].size;
+}
+
+LRUCompressedTier::LRUCompressedTier(size_t region_size, LRUMemoryTier* backing_tier_ptr)
+    : region_ptr_(static_cast<uint8_t*>(std::malloc(region_size)))
+    , region_size_(region_size)
+    , backing_tier_ptr_(backing_tier_ptr)
+    , extents_(region_size)
+{
+    Expects(region_size > 0);
+    if (!region_ptr_) {
+        LOG_ERROR("Failed to allocate compressed tier region of size %zu.\n", region_size);
+    }
+}
+
+LRUCompressedTier::~LRUCompressedTier() noexcept
+{
+    std::free(region_ptr_);
+}
+
+uint64_t
+LRUCompressedTier::store(const void* data_ptr, size_t size)
+{
+    if (!region_ptr_ || size == 0 || size > region_size_) {
+        return store_backing(data_ptr, size);
+    }
+
+    // Only payloads that shrink by at least an eighth are worth the decompression
+    scratch_.resize(size - size / 8);
+    size_t compressed_size = lz_compress(data_ptr, size, scratch_.data(), scratch_.size());
+    if (compressed_size == 0) {
+        return store_backing(data_ptr, size);
+    }
+
+    // The oldest entries make room, the newest victims are the likeliest to come back
+    uint64_t length = (compressed_size + REGION_ALIGNMENT - 1) & ~(REGION_ALIGNMENT - 1);
+    uint64_t offset = extents_.allocate(length);
+    while (offset == detail::ExtentAllocator::NO_EXTENT && write_back_oldest()) {
+        offset = extents_.allocate(length);
+    }
+    if (offset == detail::ExtentAllocator::NO_EXTENT) {
+        return store_backing(data_ptr, size);
+    }
+    std::memcpy(region_ptr_ + offset, scratch_.data(), compressed_size);
+
+    uint64_t locator;
+    if (free_slots_.empty()) {
+        locator = stored_.size();
+        stored_.emplace_back();
+    } else {
+        locator = free_slots_.back();
+        free_slots_.pop_back();
+    }
+    stored_[locator] = Entry{ offset, size, compressed_size, length };
+    stored_bytes_ += size;
+    compressed_bytes_ += compressed_size;
+    link_newest(locator);
+    return locator;
+}
+
+bool
+LRUCompressedTier::write_back_oldest()
+{
+    if (!backing_tier_ptr_ || oldest_ == NO_LOCATOR) {
+        return false;
+    }
+    uint64_t locator = oldest_;
+    Entry& entry = stored_[locator];
+    uint64_t backing_locator = backing_tier_ptr_->store(region_ptr_ + entry.offset, entry.compressed_size);
+    if (backing_locator == NO_LOCATOR) {
+        return false;
+    }
+
+    unlink(locator);
+    extents_.release(entry.offset, entry.length);
+    stored_bytes_ -= entry.size;
+    compressed_bytes_ -= entry.compressed_size;
+    entry.offset = entry.length = 0;
+    entry.backing_locator = backing_locator;
+    return true;
+}
+
+void
+LRUCompressedTier::link_newest(uint64_t locator)
+{
+    stored_[locator].older = newest_;
+    if (newest_ != NO_LOCATOR) {
+        stored_[newest_].newer = locator;
+    } else {
+        oldest_ = locator;
+    }
+    newest_ = locator;
+    region_count_++;
+}
+
+void
+LRUCompressedTier::unlink(uint64_t locator)
+{
+    Entry& entry = stored_[locator];
+    (entry.older != NO_LOCATOR ? stored_[entry.older].newer : oldest_) = entry.newer;
+    (entry.newer != NO_LOCATOR ? stored_[entry.newer].older : newest_) = entry.older;
+    entry.older = entry.newer = NO_LOCATOR;
+    region_count_--;
+}
+
+uint64_t
+LRUCompressedTier::store_backing(const void* data_ptr, size_t size)
+{
+    if (!backing_tier_ptr_) {
+        return NO_LOCATOR;
+    }
+    uint64_t locator = backing_tier_ptr_->store(data_ptr, size);
+    return locator == NO_LOCATOR ? NO_LOCATOR : locator | BACKING_LOCATOR;
+}
+
+bool
+LRUCompressedTier::load(uint64_t locator, void* buffer_ptr, size_t size)
+{
+    if (locator & BACKING_LOCATOR) {
+        return backing_tier_ptr_->load(locator & ~BACKING_LOCATOR, buffer_ptr, size);
+    }
+    Expects(locator < stored_.size());
+    Expects(size == stored_[locator].size);
+
+    Entry& entry = stored_[locator];
+    const uint8_t* compressed_ptr = region_ptr_ + entry.offset;
+    if (entry.backing_locator != NO_LOCATOR) {
+        scratch_.resize(entry.compressed_size);
+        bool is_read = backing_tier_ptr_->load(entry.backing_locator, scratch_.data(), entry.compressed_size);
+        entry.backing_locator = NO_LOCATOR; // released by the backing tier
+        if (!is_read) {
+            release(locator);
+            return false;
+        }
+        compressed_ptr = scratch_.data();
+    }
+    bool is_decompressed = lz_decompress(compressed_ptr, entry.compressed_size, buffer_ptr, size);
+    if (!is_decompressed) {
+        LOG_ERROR("Failed to decompress a payload of %zu bytes.\n", size);
+    }
+    release(locator);
+    return is_decompressed;
+}
+
+void
+LRUCompressedTier::release(uint64_t locator)
+{
+    if (locator & BACKING_LOCATOR) {
+        backing_tier_ptr_->release(locator & ~BACKING_LOCATOR);
+        return;
+    }
+    Expects(locator < stored_.size() && stored_[locator].size > 0); // LRUCompressedTier::release: not stored.
+
+    Entry& entry = stored_[locator];
+    if (entry.backing_locator != NO_LOCATOR) {
+        backing_tier_ptr_->release(entry.backing_locator);
+    } else if (entry.length > 0) {
+        unlink(locator);
+        extents_.release(entry.offset, entry.length);
+        stored_bytes_ -= entry.size;
+        compressed_bytes_ -= entry.compressed_size;
+    }
+    entry = Entry();
+    free_slots_.push_back(locator);
+}
+
+size_t
+LRUCompressedTier::stored_size(uint64_t locator) const
+{
+    if (locator & BACKING_LOCATOR) {
+        return backing_tier_ptr_->stored_size(locator & ~BACKING_LOCATOR);
+    }
+    Expects(locator < stored_.size());
+    return stored_[locator].size;
+}
+
+LRUAsyncFileTier::LRUAsyncFileTier(const char* path, std::unique_ptr<LRUIOEngine> engine_ptr, size_t batch_size,
+    unsigned batch_count, uint64_t capacity, size_t block_size)
+    : engine_ptr_(std::move(engine_ptr))
+    , batch_size_((batch_size + BATCH_ALIGNMENT - 1) & ~(BATCH_ALIGNMENT - 1))
+    , block_size_(block_size > 0 ? block_size : 1)
+    , extents_(capacity)
+{
+    Expects(engine_ptr_ != nullptr);
+    Expects(batch_size > 0 && batch_count > 0);
+
+    fd_ = detail::open_spill_file(path);
+    batches_.resize(batch_count);
+    for (uint32_t index = batch_count; index > 0; --index) {
+        batches_[index - 1].buffer_ptr = static_cast<uint8_t*>(std::aligned_alloc(BATCH_ALIGNMENT, batch_size_));
+        if (!batches_[index - 1].buffer_ptr) {
+            LOG_ERROR("Failed to allocate spill batch of size %zu.\n", batch_size_);
+            std::abort();
+        }
+        free_batches_.push_back(index - 1);
+    }
+}
+
+LRUAsyncFileTier::~LRUAsyncFileTier() noexcept
+{
+    sync();
+    for (auto& batch : batches_) {
+        std::free(batch.buffer_ptr);
+    }
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+}
+
+uint64_t
+LRUAsyncFileTier::store(const void* data_ptr, size_t size)
+{
+    if (fd_ < 0 || size == 0 || size > batch_size_) {
+        return NO_LOCATOR;
+    }
+    if (engine_ptr_->in_flight() > 0) {
+        wait_for_completion(0); // recycle the batches already written
+    }
+
+    uint64_t length = (size + block_size_ - 1) / block_size_ * block_size_;
+    uint32_t batch_index = acquire_batch();
+    if (batches_[batch_index].used + std::min<uint64_t>(length, batch_size_) > batch_size_) {
+        submit_batch(batch_index);
+        batch_index = acquire_batch();
+    }
+    Batch& batch = batches_[batch_index];
+
+    uint64_t locator;
+    if (free_slots_.empty()) {
+        locator = stored_.size();
+        stored_.emplace_back();
+    } else {
+        locator = free_slots_.back();
+        free_slots_.pop_back();
+    }
+    Entry& entry = stored_[locator];
+    entry.offset = batch.used;
+    entry.size = size;
+    entry.length = std::min<uint64_t>(length, batch_size_);
+    entry.batch = batch_index;
+    entry.state = EntryState::Staged;
+
+    std::memcpy(batch.buffer_ptr + batch.used, data_ptr, size);
+    batch.used += entry.length;
+    batch.locators.push_back(locator);
+    stored_bytes_ += size;
+    return locator;
+}
+
+bool
+LRUAsyncFileTier::load(uint64_t locator, void* buffer_ptr, size_t size)
+{
+    start_load(locator, buffer_ptr, size);
+    return finish_load(locator);
+}
+
+bool
+LRUAsyncFileTier::start_load(uint64_t locator, void* buffer_ptr, size_t size)
+{
+    Expects(locator < stored_.size());
+    Entry& entry = stored_[locator];
+    Expects(size <= entry.size);
+
+    if (entry.state == EntryState::Staged) {
+        std::memcpy(buffer_ptr, batches_[entry.batch].buffer_ptr + entry.offset, size);
+        entry.state = EntryState::Loaded;
+    } else if (entry.state == EntryState::OnDisk) {
+        while (!engine_ptr_->submit_read(fd_, buffer_ptr, size, entry.offset, locator)) {
+            wait_for_completion();
+        }
+        entry.read_size = size;
+        entry.state = EntryState::Loading;
+    }
+    return true;
+}
+
+bool
+LRUAsyncFileTier::finish_load(uint64_t locator)
+{
+    Expects(locator < stored_.size());
+    while (stored_[locator].state == EntryState::Loading) {
+        wait_for_completion();
+    }
+    bool is_loaded = stored_[locator].state == EntryState::Loaded;
+    release(locator);
+    return is_loaded;
+}
+
+void
+LRUAsyncFileTier::release(uint64_t locator)
+{
+    Expects(locator < stored_.size() && stored_[locator].state != EntryState::Free); // LRUAsyncFileTier::release: not stored.
+
+    // A read in flight still writes into the caller buffer
+    while (stored_[locator].state == EntryState::Loading) {
+        wait_for_completion();
+    }
+
+    Entry& entry = stored_[locator];
+    stored_bytes_ -= entry.size;
+    if (entry.batch != NO_BATCH) {
+        entry.is_released = true; // its part of the batch is released once the batch is written
+        return;
+    }
+    if (entry.length > 0) {
+        extents_.release(entry.offset, entry.length);
+    }
+    free_slot(locator);
+}
+
+size_t
+LRUAsyncFileTier::stored_size(uint64_t locator) const
+{
+    Expects(locator < stored_.size());
+    return stored_[locator].size;
+}
+
+void
+LRUAsyncFileTier::flush()
+{
+    if (filling_batch_ != NO_BATCH && batches_[filling_batch_].used > 0) {
+        submit_batch(filling_batch_);
+    }
+}
+
+void
+LRUAsyncFileTier::sync()
+{
+    flush();
+    while (engine_ptr_->in_flight() > 0) {
+        wait_for_completion();
+    }
+}
+
+uint32_t
+LRUAsyncFileTier::acquire_batch()
+{
+    if (filling_batch_ == NO_BATCH) {
+        while (free_batches_.empty()) {
+            wait_for_completion(); // every batch is being written
+        }
+        filling_batch_ = free_batches_.back();
+        free_batches_.pop_back();
+    }
+    return filling_batch_;
+}
+
+void
+LRUAsyncFileTier::submit_batch(uint32_t batch_index)
+{
+    Batch& batch = batches_[batch_index];
+    filling_batch_ = NO_BATCH;
+
+    batch.file_offset = extents_.allocate(batch.used);
+    if (batch.file_offset == detail::ExtentAllocator::NO_EXTENT) {
+        // The file is full, the staged payloads are lost
+        for (uint64_t locator : batch.locators) {
+            Entry& entry = stored_[locator];
+            if (entry.is_released) {
+                free_slot(locator);
+                continue;
+            }
+            entry.batch = NO_BATCH;
+            entry.length = 0;
+            entry.state = EntryState::Failed;
+        }
+        batch.used = 0;
+        batch.locators.clear();
+        free_batches_.push_back(batch_index);
+        return;
+    }
+
+    while (!engine_ptr_->submit_write(fd_, batch.buffer_ptr, batch.used, batch.file_offset, WRITE_TAG | batch_index)) {
+        wait_for_completion();
+    }
+    batch_writes_++;
+}
+
+void
+LRUAsyncFileTier::wait_for_completion(size_t min_count)
+{
+    LRUIOCompletion completions[16];
+    size_t count = engine_ptr_->poll(completions, std::size(completions), min_count);
+    for (size_t i = 0; i < count; ++i) {
+        complete(completions[i]);
+    }
+}
+
+void
+LRUAsyncFileTier::complete(const LRUIOCompletion& completion)
+{
+    if (!(completion.tag & WRITE_TAG)) {
+        Entry& entry = stored_[completion.tag];
+        entry.state = completion.result == static_cast<int64_t>(entry.read_size) ? EntryState::Loaded : EntryState::Failed;
+        return;
+    }
+
+    uint32_t batch_index = static_cast<uint32_t>(completion.tag & ~WRITE_TAG);
+    Batch& batch = batches_[batch_index];
+    bool is_written = completion.result == static_cast<int64_t>(batch.used);
+    if (!is_written) {
+        LOG_ERROR("Failed to write %zu bytes to the spill file: %s.\n", batch.used,
+            completion.result < 0 ? std::strerror(static_cast<int>(-completion.result)) : "short write");
+    }
+
+    for (uint64_t locator : batch.locators) {
+        Entry& entry = stored_[locator];
+        entry.offset += batch.file_offset;
+        entry.batch = NO_BATCH;
+        if (entry.is_released) {
+            extents_.release(entry.offset, entry.length);
+            free_slot(locator);
+        } else if (entry.state == EntryState::Staged) {
+            entry.state = is_written ? EntryState::OnDisk : EntryState::Failed;
+        }
+    }
+    batch.used = 0;
+    batch.locators.clear();
+    free_batches_.push_back(batch_index);
+}
+
+void
+LRUAsyncFileTier::free_slot(uint64_t locator)
+{
+    stored_[locator] = Entry();
+    free_slots_.push_back(locator);
+}
+
+}
@@ -0,0 +1,305 @@
+#ifndef LRU_MEMORY_TIER__H
+#define LRU_MEMORY_TIER__H
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "lrumemoryasyncio.h"
+
+namespace lrumm {
+
+namespace detail {
+
+/**
+ * @brief Places extents in a linear space, such as a file or a memory region
+ *
+ * An extent reuses the smallest released extent that fits, otherwise it is placed
+ * at the end. Released extents are coalesced with their free neighbours, and one
+ * that reaches the end moves the end back.
+ */
+class ExtentAllocator {
+public:
+    static constexpr uint64_t NO_EXTENT = UINT64_MAX;
+
+    /**
+     * @brief A capacity of 0 lets the end grow without a limit
+     */
+    explicit ExtentAllocator(uint64_t capacity = 0) : capacity_(capacity) {}
+
+    uint64_t allocate(uint64_t length);
+    void release(uint64_t offset, uint64_t length);
+
+    uint64_t end() const { return end_; }
+
+private:
+    uint64_t capacity_;
+    uint64_t end_ = 0;
+    std::map<uint64_t, uint64_t> free_by_offset_;     ///< Free extents below the end, offset to length
+    std::multimap<uint64_t, uint64_t> free_by_length_; ///< The same extents, length to offset
+};
+
+}
+
+/**
+ * @brief Second storage tier that keeps the payloads of evicted hunks
+ *
+ * The manager stores the payload of a victim before releasing its hunk and keeps
+ * the returned locator in the handle; a refresh of the handle allocates a new
+ * hunk and loads the payload back into it. Tiers are used by the thread that
+ * owns the manager.
+ */
+class LRUMemoryTier {
+public:
+    static constexpr uint64_t NO_LOCATOR = UINT64_MAX;
+
+    virtual ~LRUMemoryTier() = default;
+
+    /**
+     * @brief Keeps a copy of the payload, returns its locator or NO_LOCATOR when it was not kept
+     */
+    virtual uint64_t store(const void* data_ptr, size_t size) = 0;
+
+    /**
+     * @brief Copies the payload into the buffer and releases the locator, also when the read fails
+     */
+    virtual bool load(uint64_t locator, void* buffer_ptr, size_t size) = 0;
+
+    /**
+     * @brief Drops a stored payload without reading it
+     */
+    virtual void release(uint64_t locator) = 0;
+
+    virtual size_t stored_size(uint64_t locator) const = 0;
+
+    /**
+     * @brief Starts loading the payload into the buffer, finish_load() completes it
+     *
+     * Returns false when the tier has no asynchronous loads, load() is used then.
+     */
+    virtual bool start_load(uint64_t locator, void* buffer_ptr, size_t size)
+    {
+        (void)locator;
+        (void)buffer_ptr;
+        (void)size;
+        return false;
+    }
+
+    /**
+     * @brief Waits for a load started by start_load() and releases the locator, false when it failed
+     */
+    virtual bool finish_load(uint64_t locator)
+    {
+        (void)locator;
+        return false;
+    }
+};
+
+namespace detail {
+
+/**
+ * @brief Opens a spill file; for a directory, an anonymous file in it. -1 on failure.
+ */
+int open_spill_file(const char* path, int extra_flags = 0);
+
+}
+
+/**
+ * @brief Spills evicted payloads into a local file
+ *
+ * Payloads are written at the end of a log; released extents are coalesced and
+ * reused (best fit) before the log grows. When path is a directory, an anonymous
+ * file is created in it. A capacity of 0 lets the file grow without a limit,
+ * otherwise payloads that do not fit are not kept.
+ */
+class LRUFileTier : public LRUMemoryTier {
+public:
+    explicit LRUFileTier(const char* path, uint64_t capacity = 0, size_t block_size = 512);
+    ~LRUFileTier() noexcept override;
+
+    LRUFileTier(const LRUFileTier&) = delete;
+    LRUFileTier& operator=(const LRUFileTier&) = delete;
+
+    bool is_open() const { return fd_ >= 0; }
+
+    uint64_t store(const void* data_ptr, size_t size) override;
+    bool load(uint64_t locator, void* buffer_ptr, size_t size) override;
+    void release(uint64_t locator) override;
+    size_t stored_size(uint64_t locator) const override;
+
+    size_t stored_count() const { return stored_.size() - free_slots_.size(); }
+    uint64_t stored_bytes() const { return stored_bytes_; }  ///< Payload bytes currently kept
+    uint64_t log_size() const { return extents_.end(); }    ///< End of the used part of the file
+
+private:
+    struct Extent {
+        uint64_t offset = 0;
+        uint64_t size = 0;    ///< Payload size
+        uint64_t length = 0;  ///< Extent length, rounded up to the block size
+    };
+
+    int fd_ = -1;
+    uint64_t block_size_;
+    uint64_t stored_bytes_ = 0;
+    detail::ExtentAllocator extents_;  ///< Space of the file
+    std::vector<Extent> stored_;       ///< Indexed by locator
+    std::vector<uint64_t> free_slots_; ///< Unused locators
+};
+
+/**
+ * @brief Keeps evicted payloads compressed in a separate memory region
+ *
+ * Payloads are compressed with lz_compress and placed in a region of region_size
+ * bytes, reusing released space the way the spill file does. A payload that does
+ * not shrink by at least an eighth, or that does not fit the region, goes to the
+ * optional backing tier instead (an LRUFileTier, for example) or is not kept.
+ * When the region is full, the oldest entries are written back to the backing
+ * tier, still compressed, until the new one fits; their locators stay valid.
+ */
+class LRUCompressedTier : public LRUMemoryTier {
+public:
+    explicit LRUCompressedTier(size_t region_size, LRUMemoryTier* backing_tier_ptr = nullptr);
+    ~LRUCompressedTier() noexcept override;
+
+    LRUCompressedTier(const LRUCompressedTier&) = delete;
+    LRUCompressedTier& operator=(const LRUCompressedTier&) = delete;
+
+    uint64_t store(const void* data_ptr, size_t size) override;
+    bool load(uint64_t locator, void* buffer_ptr, size_t size) override;
+    void release(uint64_t locator) override;
+    size_t stored_size(uint64_t locator) const override;
+
+    size_t stored_count() const { return region_count_; }            ///< Payloads kept in the region
+    uint64_t stored_bytes() const { return stored_bytes_; }          ///< Uncompressed bytes kept in the region
+    uint64_t compressed_bytes() const { return compressed_bytes_; }  ///< Their size in the region
+    uint64_t region_used() const { return extents_.end(); }          ///< End of the used part of the region
+
+private:
+    static constexpr uint64_t BACKING_LOCATOR = uint64_t(1) << 63; ///< Marks locators of the backing tier
+
+    struct Entry {
+        uint64_t offset = 0;
+        uint64_t size = 0;             ///< Payload size
+        uint64_t compressed_size = 0;
+        uint64_t length = 0;           ///< Extent length in the region, 0 once written back
+        uint64_t backing_locator = NO_LOCATOR; ///< Compressed payload in the backing tier after a writeback
+        uint64_t older = NO_LOCATOR;   ///< Neighbours in the store order of the entries in the region
+        uint64_t newer = NO_LOCATOR;
+    };
+
+    uint64_t store_backing(const void* data_ptr, size_t size);
+    bool write_back_oldest();
+    void link_newest(uint64_t locator);
+    void unlink(uint64_t locator);
+
+    uint8_t* region_ptr_;
+    size_t region_size_;
+    LRUMemoryTier* backing_tier_ptr_;
+    uint64_t stored_bytes_ = 0;
+    uint64_t compressed_bytes_ = 0;
+    size_t region_count_ = 0;
+    uint64_t oldest_ = NO_LOCATOR;     ///< Next entry to write back
+    uint64_t newest_ = NO_LOCATOR;
+    detail::ExtentAllocator extents_;  ///< Space of the region
+    std::vector<Entry> stored_;        ///< Indexed by locator
+    std::vector<uint64_t> free_slots_; ///< Unused locators
+    std::vector<uint8_t> scratch_;     ///< Compression output before it is placed
+};
+
+/**
+ * @brief Spills evicted payloads into a local file through an asynchronous I/O engine
+ *
+ * Stored payloads are copied into a staging batch that is written with one large
+ * sequential write when it is full or on flush(), so an eviction costs a copy.
+ * Payloads of a batch not yet on disk are loaded from the batch. start_load()
+ * submits the read of a payload and returns at once, which the manager uses to
+ * prefetch into reserved hunks. Payloads larger than a batch are not kept.
+ */
+class LRUAsyncFileTier : public LRUMemoryTier {
+public:
+    LRUAsyncFileTier(const char* path, std::unique_ptr<LRUIOEngine> engine_ptr, size_t batch_size = 4 * 1024 * 1024,
+        unsigned batch_count = 4, uint64_t capacity = 0, size_t block_size = 512);
+    ~LRUAsyncFileTier() noexcept override;
+
+    LRUAsyncFileTier(const LRUAsyncFileTier&) = delete;
+    LRUAsyncFileTier& operator=(const LRUAsyncFileTier&) = delete;
+
+    bool is_open() const { return fd_ >= 0; }
+    const char* engine_name() const { return engine_ptr_->name(); }
+
+    uint64_t store(const void* data_ptr, size_t size) override;
+    bool load(uint64_t locator, void* buffer_ptr, size_t size) override;
+    void release(uint64_t locator) override;
+    size_t stored_size(uint64_t locator) const override;
+    bool start_load(uint64_t locator, void* buffer_ptr, size_t size) override;
+    bool finish_load(uint64_t locator) override;
+
+    /**
+     * @brief Starts writing the staged payloads without waiting for a full batch
+     */
+    void flush();
+
+    /**
+     * @brief Flushes and waits until all the reads and writes completed
+     */
+    void sync();
+
+    size_t stored_count() const { return stored_.size() - free_slots_.size(); }
+    uint64_t stored_bytes() const { return stored_bytes_; }  ///< Payload bytes currently kept
+    uint64_t log_size() const { return extents_.end(); }    ///< End of the used part of the file
+    uint64_t batch_writes() const { return batch_writes_; } ///< Batches written so far
+
+private:
+    static constexpr uint32_t NO_BATCH = UINT32_MAX;
+    static constexpr uint64_t WRITE_TAG = uint64_t(1) << 63; ///< Marks the tags of batch writes
+
+    enum class EntryState : uint8_t {
+        Free,
+        Staged,   ///< In a batch that is being filled or written
+        OnDisk,
+        Loading,  ///< A read into the caller buffer is in flight
+        Loaded,   ///< Copied into the caller buffer, waiting for finish_load()
+        Failed,   ///< The write or the read failed, the payload is lost
+    };
+
+    struct Entry {
+        uint64_t offset = 0;      ///< In the batch while staged, in the file afterwards
+        uint64_t size = 0;        ///< Payload size
+        uint64_t length = 0;      ///< Extent length, rounded up to the block size
+        uint64_t read_size = 0;   ///< Bytes requested by the read in flight, at most size
+        uint32_t batch = NO_BATCH;
+        EntryState state = EntryState::Free;
+        bool is_released = false; ///< Released while in a batch, the slot is reused once the batch is written
+    };
+
+    struct Batch {
+        uint8_t* buffer_ptr = nullptr;
+        size_t used = 0;
+        uint64_t file_offset = 0;
+        std::vector<uint64_t> locators; ///< Entries staged in the batch
+    };
+
+    uint32_t acquire_batch();
+    void submit_batch(uint32_t batch_index);
+    void complete(const LRUIOCompletion& completion);
+    void wait_for_completion(size_t min_count = 1);
+    void free_slot(uint64_t locator);
+
+    int fd_ = -1;
+    std::unique_ptr<LRUIOEngine> engine_ptr_;
+    size_t batch_size_;
+    uint64_t block_size_;
+    uint64_t stored_bytes_ = 0;
+    uint64_t batch_writes_ = 0;
+    uint32_t filling_batch_ = NO_BATCH;
+    std::vector<Batch> batches_;
+    std::vector<uint32_t> free_batches_;
+    detail::ExtentAllocator extents_;  ///< Space of the file
+    std::vector<Entry> stored_;        ///< Indexed by locator
+    std::vector<uint64_t> free_slots_; ///< Unused locators
+};
+
+}
+#endif // LRU_MEMORY_TIER__H
@@ -0,0 +1,202 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+
+#include "lrumemorymanager.h"
+#include "lrumemorytrace.h"
+
+namespace lrumm {
+
+static constexpr auto TRACE_WRITER_IDLE_SLEEP = std::chrono::milliseconds(1);
+
+static bool
+parse_trace_op(const char* name, size_t length, LRUTraceOp& op)
+{
+    static const struct {
+        const char* name;
+        LRUTraceOp op;
+    } op_names[] = {
+        { "alloc", LRUTraceOp::Alloc },
+        { "free", LRUTraceOp::Free },
+        { "refresh", LRUTraceOp::Refresh },
+        { "evict", LRUTraceOp::Evict },
+    };
+
+    for (const auto& op_name : op_names) {
+        if (std::strlen(op_name.name) == length && std::strncmp(op_name.name, name, length) == 0) {
+            op = op_name.op;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool
+read_binary_trace(std::FILE* file_ptr, std::vector<LRUTraceRecord>& records)
+{
+    LRUTraceFileHeader header;
+    if (std::fread(&header, sizeof(header), 1, file_ptr) != 1
+            || header.version != LRUTraceFileHeader::VERSION
+            || header.record_size != sizeof(LRUTraceRecord)) {
+        return false;
+    }
+
+    LRUTraceRecord buffer[4096];
+    size_t count;
+    while ((count = std::fread(buffer, sizeof(LRUTraceRecord), std::size(buffer), file_ptr)) > 0) {
+        records.insert(records.end(), buffer, buffer + count);
+    }
+    return true;
+}
+
+static bool
+read_csv_trace(std::FILE* file_ptr, std::vector<LRUTraceRecord>& records)
+{
+    char line[256];
+    size_t line_number = 0;
+    while (std::fgets(line, sizeof(line), file_ptr)) {
+        line_number++;
+        const char* line_ptr = line;
+        while (*line_ptr == ' ' || *line_ptr == '\t') {
+            line_ptr++;
+        }
+        if (*line_ptr == '\0' || *line_ptr == '\n' || *line_ptr == '\r' || *line_ptr == '#'
+                || std::strncmp(line_ptr, "op", 2) == 0) {
+            continue;
+        }
+
+        const char* comma_ptr = std::strchr(line_ptr, ',');
+        LRUTraceOp op;
+        if (!comma_ptr || !parse_trace_op(line_ptr, comma_ptr - line_ptr, op)) {
+            LOG_ERROR("Malformed trace line %zu.\n", line_number);
+            return false;
+        }
+
+        char* end_ptr;
+        uint64_t handle_id = std::strtoull(comma_ptr + 1, &end_ptr, 0);
+        uint64_t size = 0, delta_ns = 0;
+        if (*end_ptr == ',') {
+            size = std::strtoull(end_ptr + 1, &end_ptr, 0);
+        }
+        if (*end_ptr == ',') {
+            delta_ns = std::strtoull(end_ptr + 1, &end_ptr, 0);
+        }
+        records.push_back(LRUTraceRecord::make(op, handle_id, size, delta_ns));
+    }
+    return true;
+}
+
+bool
+read_trace(const char* path, std::vector<LRUTraceRecord>& records)
+{
+    Expects(path != nullptr);
+
+    std::FILE* file_ptr = std::fopen(path, "rb");
+    if (!file_ptr) {
+        LOG_ERROR("Failed to open trace file %s.\n", path);
+        return false;
+    }
+
+    char magic[sizeof(LRUTraceFileHeader::MAGIC)] = {};
+    bool is_binary = std::fread(magic, sizeof(magic), 1, file_ptr) == 1
+        && std::memcmp(magic, LRUTraceFileHeader::MAGIC, sizeof(magic)) == 0;
+    std::rewind(file_ptr);
+
+    bool result = is_binary ? read_binary_trace(file_ptr, records) : read_csv_trace(file_ptr, records);
+    std::fclose(file_ptr);
+    return result;
+}
+
+LRUTraceRecorder::LRUTraceRecorder(const char* path, size_t ring_capacity, uint32_t sample_rate)
+    : ring_mask_(0)
+    , sample_rate_(sample_rate > 0 ? sample_rate : 1)
+{
+    Expects(path != nullptr);
+    Expects(ring_capacity > 0);
+
+    // Round the ring capacity up to a power of two
+    size_t capacity = 1;
+    while (capacity < ring_capacity) {
+        capacity <<= 1;
+    }
+    ring_.reset(new LRUTraceRecord[capacity]);
+    ring_mask_ = capacity - 1;
+
+    file_ptr_ = std::fopen(path, "wb");
+    if (!file_ptr_) {
+        LOG_ERROR("Failed to open trace file %s.\n", path);
+        return;
+    }
+
+    LRUTraceFileHeader header;
+    std::memcpy(header.magic, LRUTraceFileHeader::MAGIC, sizeof(header.magic));
+    header.version = LRUTraceFileHeader::VERSION;
+    header.record_size = sizeof(LRUTraceRecord);
+    header.sample_rate = sample_rate_;
+    header.reserved = 0;
+    std::fwrite(&header, sizeof(header), 1, file_ptr_);
+
+    writer_thread_ = std::thread(&LRUTraceRecorder::writer_loop, this);
+}
+
+LRUTraceRecorder::~LRUTraceRecorder() noexcept
+{
+    if (!file_ptr_) {
+        return;
+    }
+
+    stop_.store(true, std::memory_order_release);
+    writer_thread_.join();
+
+    // Records pushed after the writer has seen the stop flag
+    drain();
+    std::fclose(file_ptr_);
+}
+
+void
+LRUTraceRecorder::flush()
+{
+    if (!file_ptr_) {
+        return;
+    }
+
+    // Wait until the writer thread caught up with everything pushed so far
+    size_t head = head_.load(std::memory_order_relaxed);
+    while (tail_.load(std::memory_order_acquire) < head) {
+        std::this_thread::sleep_for(TRACE_WRITER_IDLE_SLEEP);
+    }
+    std::fflush(file_ptr_);
+}
+
+size_t
+LRUTraceRecorder::drain()
+{
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    size_t head = head_.load(std::memory_order_acquire);
+    size_t count = head - tail;
+
+    while (tail != head) {
+        // Write the contiguous part up to the end of the ring
+        size_t first = tail & ring_mask_;
+        size_t span = std::min(head - tail, ring_mask_ + 1 - first);
+        std::fwrite(&ring_[first], sizeof(LRUTraceRecord), span, file_ptr_);
+        tail += span;
+        tail_.store(tail, std::memory_order_release);
+    }
+    return count;
+}
+
+void
+LRUTraceRecorder::writer_loop()
+{
+    while (!stop_.load(std::memory_order_acquire)) {
+        if (drain() == 0) {
+            std::this_thread::sleep_for(TRACE_WRITER_IDLE_SLEEP);
+        }
+    }
+    drain();
+}
+
+}
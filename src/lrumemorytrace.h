@@ -0,0 +1,149 @@
+#ifndef LRU_MEMORY_TRACE__H
+#define LRU_MEMORY_TRACE__H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "lrumemoryhistogram.h"
+
+namespace lrumm {
+
+enum class LRUTraceOp : uint8_t {
+    Alloc = 1,   ///< alloc() request, size is the requested size
+    Free = 2,    ///< explicit free() or flush()
+    Refresh = 3, ///< get_buffer_and_refresh(), size is 0 when the handle was not allocated
+    Evict = 4,   ///< hunk evicted by an allocation, size is its payload size
+};
+
+/**
+ * @brief One recorded operation, 16 bytes on disk
+ */
+struct LRUTraceRecord {
+    static constexpr unsigned OP_BITS = 4;
+    static constexpr uint32_t MAX_DELTA_NS = (uint32_t(1) << (32 - OP_BITS)) - 1;
+
+    uint64_t handle_id;  ///< Identity of the handle in the recorded process
+    uint32_t size;       ///< Operation size, see LRUTraceOp
+    uint32_t op_delta;   ///< Low OP_BITS: LRUTraceOp, the rest: ns since the previous record (saturated)
+
+    LRUTraceOp op() const { return static_cast<LRUTraceOp>(op_delta & ((1u << OP_BITS) - 1)); }
+    uint32_t delta_ns() const { return op_delta >> OP_BITS; }
+
+    static LRUTraceRecord make(LRUTraceOp op, uint64_t handle_id, uint64_t size, uint64_t delta_ns)
+    {
+        LRUTraceRecord record;
+        record.handle_id = handle_id;
+        record.size = size > UINT32_MAX ? UINT32_MAX : static_cast<uint32_t>(size);
+        record.op_delta = (static_cast<uint32_t>(delta_ns > MAX_DELTA_NS ? MAX_DELTA_NS : delta_ns) << OP_BITS)
+            | static_cast<uint32_t>(op);
+        return record;
+    }
+};
+static_assert(sizeof(LRUTraceRecord) == 16, "LRUTraceRecord must stay 16 bytes");
+
+/**
+ * @brief Header at the beginning of a binary trace file
+ */
+struct LRUTraceFileHeader {
+    static constexpr char MAGIC[8] = { 'L', 'R', 'U', 'T', 'R', 'A', 'C', 'E' };
+    static constexpr uint32_t VERSION = 1;
+
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t sample_rate; ///< 1 out of sample_rate handles was recorded
+    uint32_t reserved;
+};
+static_assert(sizeof(LRUTraceFileHeader) == 24, "LRUTraceFileHeader must stay 24 bytes");
+
+/**
+ * @brief Records the manager operations into a binary trace file
+ *
+ * The owning thread of the manager pushes records into a single producer, single
+ * consumer lock-free ring; a helper thread drains it into the file. When the ring
+ * is full the record is dropped and counted instead of blocking the manager.
+ * With sample_rate > 1 only the operations of one handle out of sample_rate are
+ * recorded, so the sampled handles keep complete lifecycles.
+ */
+class LRUTraceRecorder {
+public:
+    explicit LRUTraceRecorder(const char* path, size_t ring_capacity = 1 << 16, uint32_t sample_rate = 1);
+    ~LRUTraceRecorder() noexcept;
+
+    LRUTraceRecorder(const LRUTraceRecorder&) = delete;
+    LRUTraceRecorder& operator=(const LRUTraceRecorder&) = delete;
+
+    bool is_open() const { return file_ptr_ != nullptr; }
+
+    void record(LRUTraceOp op, const void* handle_ptr, size_t size);
+    void flush();
+
+    uint64_t recorded_count() const { return head_.load(std::memory_order_relaxed); }
+    uint64_t dropped_count() const { return dropped_count_.load(std::memory_order_relaxed); }
+
+private:
+    bool is_sampled(uint64_t handle_id) const;
+    size_t drain();
+    void writer_loop();
+
+    std::FILE* file_ptr_ = nullptr;
+    std::unique_ptr<LRUTraceRecord[]> ring_;
+    size_t ring_mask_;
+    uint32_t sample_rate_;
+    uint64_t last_ns_ = 0;
+
+    alignas(64) std::atomic<size_t> head_{0}; ///< Next slot written by the producer
+    alignas(64) std::atomic<size_t> tail_{0}; ///< Next slot read by the writer thread
+    std::atomic<uint64_t> dropped_count_{0};
+    std::atomic<bool> stop_{false};
+    std::thread writer_thread_;
+};
+
+/**
+ * @brief Loads a trace, either in the binary recorder format or as CSV text
+ *
+ * The CSV format has one operation per line: op,handle_id,size[,delta_ns] where op
+ * is alloc, free, refresh or evict. Empty lines, lines starting with '#' and a
+ * header line starting with "op" are skipped.
+ */
+bool read_trace(const char* path, std::vector<LRUTraceRecord>& records);
+
+inline
+bool
+LRUTraceRecorder::is_sampled(uint64_t handle_id) const
+{
+    if (sample_rate_ == 1) {
+        return true;
+    }
+    // Fibonacci hashing spreads the aligned handle addresses
+    return ((handle_id * 0x9E3779B97F4A7C15ull) >> 32) % sample_rate_ == 0;
+}
+
+inline
+void
+LRUTraceRecorder::record(LRUTraceOp op, const void* handle_ptr, size_t size)
+{
+    auto handle_id = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(handle_ptr));
+    if (!is_sampled(handle_id)) {
+        return;
+    }
+
+    size_t head = head_.load(std::memory_order_relaxed);
+    if (head - tail_.load(std::memory_order_acquire) > ring_mask_) {
+        dropped_count_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    uint64_t now_ns = detail::now_ns();
+    ring_[head & ring_mask_] = LRUTraceRecord::make(op, handle_id, size, last_ns_ ? now_ns - last_ns_ : 0);
+    last_ns_ = now_ns;
+    head_.store(head + 1, std::memory_order_release);
+}
+
+}
+#endif // LRU_MEMORY_TRACE__H
@@ -0,0 +1,171 @@
+#include <algorithm>
+#include <cstring>
+
+#include "lrumemorywriter.h"
+
+namespace lrumm {
+
+LRUAppendWriter::LRUAppendWriter(LRUMemoryManager& manager, Handle* handle_ptr, size_t initial_capacity)
+    : manager_(manager)
+    , handle_ptr_(handle_ptr)
+{
+    Expects(handle_ptr != nullptr && handle_ptr->hunk_ptr() == nullptr);
+    Expects(initial_capacity > 0);
+
+    write_ptr_ = static_cast<uint8_t*>(manager_.alloc(handle_ptr_, initial_capacity));
+    if (!write_ptr_) {
+        is_lost_ = true;
+        return;
+    }
+    chunk_sizes_.push_back(0);
+    available_ = handle_ptr_->size();
+}
+
+LRUAppendWriter::~LRUAppendWriter() noexcept
+{
+    if (chunk_count() > 1) {
+        lose(); // the chunks go with the writer, the head of the stream alone is useless
+    }
+}
+
+bool
+LRUAppendWriter::append(const void* data_ptr, size_t size)
+{
+    if (!ensure(size)) {
+        return false;
+    }
+    std::memcpy(write_ptr_, data_ptr, size);
+    commit(size);
+    return true;
+}
+
+void*
+LRUAppendWriter::prepare(size_t min_size, size_t& available)
+{
+    available = 0;
+    if (!ensure(min_size)) {
+        return nullptr;
+    }
+    available = available_;
+    return write_ptr_;
+}
+
+void
+LRUAppendWriter::commit(size_t size)
+{
+    Expects(!is_lost_ && size <= available_);
+    write_ptr_ += size;
+    available_ -= size;
+    chunk_sizes_.back() += size;
+    size_ += size;
+}
+
+bool
+LRUAppendWriter::finish(bool compact)
+{
+    if (is_lost_ || !is_intact()) {
+        lose();
+        return false;
+    }
+
+    // Shrinking always succeeds, the unused tail is free again
+    manager_.resize_in_place(chunk_handle(chunk_count() - 1), chunk_sizes_.back());
+    available_ = 0;
+    if (chunk_count() == 1 || !compact) {
+        return true;
+    }
+
+    // Free space only, an eviction could hit the chunks being copied
+    Handle compact_handle;
+    auto* buffer_ptr = static_cast<uint8_t*>(manager_.real_alloc(&compact_handle, size_, 0, false));
+    if (!buffer_ptr) {
+        return true; // no gap fits, the data stays chained
+    }
+
+    for (size_t index = 0; index < chunk_count(); ++index) {
+        std::memcpy(buffer_ptr, chunk_data(index), chunk_sizes_[index]);
+        buffer_ptr += chunk_sizes_[index];
+    }
+    chunks_.clear();
+    manager_.free(handle_ptr_);
+    manager_.transfer_hunk(&compact_handle, handle_ptr_);
+    chunk_sizes_.assign(1, size_);
+    write_ptr_ = nullptr;
+    return true;
+}
+
+void*
+LRUAppendWriter::chunk_data(size_t index)
+{
+    Expects(index < chunk_count());
+    return manager_.get_buffer_and_refresh(chunk_handle(index));
+}
+
+LRUAppendWriter::Handle*
+LRUAppendWriter::chunk_handle(size_t index)
+{
+    return index == 0 ? handle_ptr_ : &chunks_[index - 1];
+}
+
+bool
+LRUAppendWriter::ensure(size_t min_size)
+{
+    if (is_lost_) {
+        return false;
+    }
+    Handle* last_handle_ptr = chunk_handle(chunk_count() - 1);
+    if (!last_handle_ptr->hunk_ptr()) {
+        lose(); // evicted between two writes
+        return false;
+    }
+    if (available_ >= min_size) {
+        return true;
+    }
+
+    // Grow in place, doubling when the following free space allows
+    size_t used = chunk_sizes_.back();
+    size_t capacity = last_handle_ptr->size();
+    if (manager_.resize_in_place(last_handle_ptr, std::max(capacity * 2, used + min_size))
+        || manager_.resize_in_place(last_handle_ptr, used + min_size)) {
+        available_ = last_handle_ptr->size() - used;
+        manager_.get_buffer_and_refresh(last_handle_ptr);
+        return true;
+    }
+
+    // Chain a new chunk after trimming the current one
+    manager_.resize_in_place(last_handle_ptr, used);
+    Handle& chunk = chunks_.emplace_back();
+    write_ptr_ = static_cast<uint8_t*>(manager_.alloc(&chunk, std::max(capacity, min_size)));
+    if (!write_ptr_ || !is_intact()) {
+        lose();
+        return false;
+    }
+    chunk_sizes_.push_back(0);
+    available_ = chunk.size();
+    return true;
+}
+
+bool
+LRUAppendWriter::is_intact() const
+{
+    if (!handle_ptr_->hunk_ptr()) {
+        return false;
+    }
+    return std::all_of(chunks_.begin(), chunks_.end(), [](const Handle& chunk) { return chunk.hunk_ptr() != nullptr; });
+}
+
+void
+LRUAppendWriter::lose()
+{
+    chunks_.clear();
+    if (handle_ptr_->hunk_ptr()) {
+        manager_.free(handle_ptr_);
+    }
+    chunk_sizes_.clear();
+    write_ptr_ = nullptr;
+    available_ = 0;
+    size_ = 0;
+    is_lost_ = true;
+}
+
+}
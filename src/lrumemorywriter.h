@@ -0,0 +1,84 @@
+#ifndef LRU_MEMORY_WRITER__H
+#define LRU_MEMORY_WRITER__H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include "lrumemorymanager.h"
+
+namespace lrumm {
+
+/**
+ * @brief Fills a handle with data of unknown final size
+ *
+ * The handle is allocated with the initial capacity. When it is full, its hunk
+ * grows in place into the free space that follows; when that space is taken,
+ * the data continues in a chained chunk owned by the writer, which grows the
+ * same way. finish() trims the unused tails and optionally compacts the chunks
+ * into the hunk of the handle. The chunks are ordinary hunks: an eviction of
+ * any of them before finish() loses the stream.
+ *
+ * The chained chunks belong to the writer, so a chained stream lives only as
+ * long as the writer does. Destroying the writer while the stream has more than
+ * one chunk frees the handle as well, rather than leave it holding the head of
+ * the stream alone.
+ */
+class LRUAppendWriter {
+public:
+    using Handle = LRUMemoryManager::LRUMemoryHandle;
+
+    LRUAppendWriter(LRUMemoryManager& manager, Handle* handle_ptr, size_t initial_capacity = 4096);
+    ~LRUAppendWriter() noexcept;
+
+    LRUAppendWriter(const LRUAppendWriter&) = delete;
+    LRUAppendWriter& operator=(const LRUAppendWriter&) = delete;
+
+    /**
+     * @brief Copies size bytes to the end of the stream, false when the stream is lost
+     */
+    bool append(const void* data_ptr, size_t size);
+
+    /**
+     * @brief Returns room for at least min_size bytes at the end of the stream, nullptr when lost
+     *
+     * A decoder writes into it and calls commit() with the bytes written, so the
+     * data is produced in place. available receives the size of the room.
+     */
+    void* prepare(size_t min_size, size_t& available);
+    void commit(size_t size);
+
+    /**
+     * @brief Trims the chunks and, with compact, moves the data into one hunk of the handle
+     *
+     * Compaction copies the data when there is more than one chunk. The copy only
+     * takes free space, it never evicts; when no gap fits, the data stays chained.
+     * Returns false when the stream was lost, the handle is not allocated then.
+     */
+    bool finish(bool compact = true);
+
+    bool is_lost() const { return is_lost_; }
+    size_t size() const { return size_; }           ///< Bytes written
+    size_t chunk_count() const { return chunk_sizes_.size(); }
+    void* chunk_data(size_t index);                  ///< Refreshes the chunk; the first one is the hunk of the handle
+    size_t chunk_size(size_t index) const { return chunk_sizes_[index]; }
+
+private:
+    Handle* chunk_handle(size_t index);
+    bool ensure(size_t min_size);
+    bool is_intact() const;
+    void lose();
+
+    LRUMemoryManager& manager_;
+    Handle* handle_ptr_;
+    std::deque<Handle> chunks_;       ///< Chained chunks after the first one, never moved
+    std::vector<size_t> chunk_sizes_; ///< Bytes written per chunk
+    uint8_t* write_ptr_ = nullptr;    ///< End of the data in the last chunk
+    size_t available_ = 0;            ///< Room left in the last chunk
+    size_t size_ = 0;
+    bool is_lost_ = false;
+};
+
+}
+#endif // LRU_MEMORY_WRITER__H
@@ -0,0 +1,242 @@
+#include "gtest/gtest.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "lrumemoryasyncio.h"
+#include "lrumemorymanager.h"
+#include "lrumemorytier.h"
+
+namespace {
+
+// The tier files live on tmpfs where there is one
+std::string spill_path(const char* name)
+{
+    struct stat dir_stat;
+    std::string dir = ::stat("/dev/shm", &dir_stat) == 0 && S_ISDIR(dir_stat.st_mode) ? "/dev/shm/" : testing::TempDir();
+    return dir + name;
+}
+
+void fill_pattern(void* buffer_ptr, size_t size, uint8_t seed)
+{
+    auto* bytes = static_cast<uint8_t*>(buffer_ptr);
+    for (size_t i = 0; i < size; ++i) {
+        bytes[i] = static_cast<uint8_t>(seed + i * 7);
+    }
+}
+
+bool has_pattern(const void* buffer_ptr, size_t size, uint8_t seed)
+{
+    std::vector<uint8_t> expected(size);
+    fill_pattern(expected.data(), size, seed);
+    return std::memcmp(buffer_ptr, expected.data(), size) == 0;
+}
+
+void check_engine_round_trip(lrumm::LRUIOEngine& engine, const std::string& path)
+{
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+    ASSERT_GE(fd, 0);
+
+    std::vector<uint8_t> first(8192), second(4096);
+    fill_pattern(first.data(), first.size(), 1);
+    fill_pattern(second.data(), second.size(), 2);
+    ASSERT_TRUE(engine.submit_write(fd, first.data(), first.size(), 0, 10));
+    ASSERT_TRUE(engine.submit_write(fd, second.data(), second.size(), 8192, 11));
+    EXPECT_EQ(engine.in_flight(), 2u);
+
+    lrumm::LRUIOCompletion completions[4];
+    size_t count = 0;
+    while (count < 2) {
+        count += engine.poll(completions + count, 4 - count, 1);
+    }
+    EXPECT_EQ(engine.in_flight(), 0u);
+    for (size_t i = 0; i < count; ++i) {
+        EXPECT_EQ(completions[i].result, completions[i].tag == 10 ? 8192 : 4096);
+    }
+
+    // the read past the end of the file completes short
+    std::vector<uint8_t> buffer(8192);
+    ASSERT_TRUE(engine.submit_read(fd, buffer.data(), buffer.size(), 4096, 20));
+    ASSERT_EQ(engine.poll(completions, 4, 1), 1u);
+    EXPECT_EQ(completions[0].tag, 20u);
+    EXPECT_EQ(completions[0].result, 8192);
+    EXPECT_TRUE(has_pattern(buffer.data(), 4096, static_cast<uint8_t>(1 + 4096 * 7)));
+    EXPECT_TRUE(has_pattern(buffer.data() + 4096, 4096, 2));
+
+    ASSERT_TRUE(engine.submit_read(fd, buffer.data(), buffer.size(), 8192, 21));
+    ASSERT_EQ(engine.poll(completions, 4, 1), 1u);
+    EXPECT_EQ(completions[0].result, 4096);
+    EXPECT_EQ(engine.poll(completions, 4, 0), 0u);
+
+    ::close(fd);
+    std::remove(path.c_str());
+}
+
+}
+
+TEST(LRUMemoryAsyncIOTest, ThreadPoolEngine)
+{
+    auto engine_ptr = lrumm::make_thread_pool_engine(2, 4);
+    EXPECT_STREQ(engine_ptr->name(), "thread_pool");
+    check_engine_round_trip(*engine_ptr, spill_path("lrumm_asyncio_threads_test.spill"));
+}
+
+TEST(LRUMemoryAsyncIOTest, UringEngine)
+{
+    auto engine_ptr = lrumm::make_uring_engine(4);
+    if (!engine_ptr) {
+        GTEST_SKIP() << "io_uring is not available.";
+    }
+    EXPECT_STREQ(engine_ptr->name(), "io_uring");
+    check_engine_round_trip(*engine_ptr, spill_path("lrumm_asyncio_uring_test.spill"));
+}
+
+TEST(LRUMemoryAsyncIOTest, BatchedWrites)
+{
+    const std::string path = spill_path("lrumm_asyncio_batch_test.spill");
+    lrumm::LRUAsyncFileTier tier(path.c_str(), lrumm::make_io_engine(), 8192, 2);
+    ASSERT_TRUE(tier.is_open());
+
+    // four 2000 byte payloads take 2048 bytes each, one batch
+    std::vector<uint8_t> payload(2000);
+    uint64_t locators[5];
+    for (int i = 0; i < 4; ++i) {
+        fill_pattern(payload.data(), payload.size(), static_cast<uint8_t>(i));
+        locators[i] = tier.store(payload.data(), payload.size());
+        ASSERT_NE(locators[i], lrumm::LRUMemoryTier::NO_LOCATOR);
+    }
+    EXPECT_EQ(tier.batch_writes(), 0u);
+
+    // staged payloads load from the batch
+    std::vector<uint8_t> buffer(2000);
+    EXPECT_TRUE(tier.load(locators[3], buffer.data(), buffer.size()));
+    EXPECT_TRUE(has_pattern(buffer.data(), buffer.size(), 3));
+
+    // the fifth does not fit, the batch is written with one write
+    fill_pattern(payload.data(), payload.size(), 4);
+    locators[4] = tier.store(payload.data(), payload.size());
+    EXPECT_EQ(tier.batch_writes(), 1u);
+    tier.sync();
+    EXPECT_EQ(tier.batch_writes(), 2u);
+    EXPECT_EQ(tier.log_size(), 8192u + 2048u);
+    EXPECT_EQ(tier.stored_count(), 4u);
+
+    // a read may ask for the first part of a payload only
+    EXPECT_TRUE(tier.load(locators[0], buffer.data(), 1000));
+    EXPECT_TRUE(has_pattern(buffer.data(), 1000, 0));
+    EXPECT_TRUE(tier.load(locators[4], buffer.data(), buffer.size()));
+    EXPECT_TRUE(has_pattern(buffer.data(), buffer.size(), 4));
+    EXPECT_EQ(tier.stored_bytes(), 4000u);
+
+    // too large for a batch
+    std::vector<uint8_t> large(8193);
+    EXPECT_EQ(tier.store(large.data(), large.size()), lrumm::LRUMemoryTier::NO_LOCATOR);
+
+    tier.release(locators[1]);
+    tier.release(locators[2]);
+    EXPECT_EQ(tier.stored_count(), 0u);
+    std::remove(path.c_str());
+}
+
+TEST(LRUMemoryAsyncIOTest, PrefetchIntoReservedHunk)
+{
+    using Manager = lrumm::LRUMemoryManager;
+    const std::string path = spill_path("lrumm_asyncio_prefetch_test.spill");
+
+    lrumm::LRUAsyncFileTier tier(path.c_str(), lrumm::make_io_engine(), 4096, 2);
+    Manager manager(2048);
+    manager.set_tier(&tier);
+
+    Manager::LRUMemoryHandle handles[3];
+    for (int i = 0; i < 3; ++i) {
+        fill_pattern(manager.alloc(&handles[i], 900), 900, static_cast<uint8_t>(i));
+    }
+    ASSERT_TRUE(handles[0].is_spilled());
+    tier.sync(); // the payload is read from the file, not the batch
+
+    EXPECT_TRUE(manager.prefetch(&handles[0]));
+    EXPECT_FALSE(handles[0].is_spilled());
+    EXPECT_NE(handles[0].hunk_ptr(), nullptr);
+    EXPECT_TRUE(handles[1].is_spilled()) << "The reserved hunk evicts the least recent.";
+    EXPECT_FALSE(manager.prefetch(&handles[2])) << "Not spilled.";
+
+    void* buffer_ptr = manager.get_buffer_and_refresh(&handles[0]);
+    ASSERT_NE(buffer_ptr, nullptr);
+    EXPECT_FALSE(handles[0].is_loading());
+    EXPECT_TRUE(has_pattern(buffer_ptr, 900, 0));
+
+#if LRUMM_ENABLE_STATS
+    auto stats = manager.get_stats();
+    EXPECT_EQ(stats.tier_loads, 1u);
+    EXPECT_EQ(stats.hits, 1u);
+#endif
+
+    // a prefetch still in flight is completed before its hunk is evicted or freed
+    tier.sync();
+    EXPECT_TRUE(manager.prefetch(&handles[1]));
+    EXPECT_TRUE(handles[2].is_spilled());
+    manager.free(&handles[1]);
+    EXPECT_TRUE(manager.prefetch(&handles[2]));
+    manager.flush();
+    tier.sync(); // the slots of payloads released from a batch are reused once it is written
+    EXPECT_EQ(tier.stored_count(), 0u);
+
+    manager.set_tier(nullptr);
+    std::remove(path.c_str());
+}
+
+TEST(LRUMemoryAsyncIOTest, LoadFromFd)
+{
+    using Manager = lrumm::LRUMemoryManager;
+    const std::string path = testing::TempDir() + "lrumm_load_from_fd_test.bin";
+
+    std::vector<uint8_t> content(3 * Manager::DIRECT_IO_ALIGNMENT);
+    fill_pattern(content.data(), content.size(), 9);
+    std::FILE* file_ptr = std::fopen(path.c_str(), "wb");
+    ASSERT_NE(file_ptr, nullptr);
+    ASSERT_EQ(std::fwrite(content.data(), 1, content.size(), file_ptr), content.size());
+    std::fclose(file_ptr);
+
+    Manager manager(64 * 1024);
+    Manager::LRUMemoryHandle handle;
+    int fd = ::open(path.c_str(), O_RDONLY);
+    ASSERT_GE(fd, 0);
+
+    // buffered, straight into the hunk at any offset
+    void* buffer_ptr = manager.load_from_fd(&handle, fd, 100, 5000);
+    ASSERT_NE(buffer_ptr, nullptr);
+    EXPECT_EQ(std::memcmp(buffer_ptr, content.data() + 100, 5000), 0);
+    manager.free(&handle);
+
+    auto engine_ptr = lrumm::make_io_engine(4, 1);
+    buffer_ptr = manager.load_from_fd(&handle, fd, 4096, 8192, engine_ptr.get());
+    ASSERT_NE(buffer_ptr, nullptr);
+    EXPECT_EQ(std::memcmp(buffer_ptr, content.data() + 4096, 8192), 0);
+    manager.free(&handle);
+
+    // past the end of the file
+    EXPECT_EQ(manager.load_from_fd(&handle, fd, 10000, 5000), nullptr);
+    EXPECT_EQ(handle.hunk_ptr(), nullptr);
+    ::close(fd);
+
+    fd = ::open(path.c_str(), O_RDONLY | O_DIRECT);
+    if (fd >= 0) {
+        // whole blocks into a block aligned payload, the short last block is read up to the end of the file
+        buffer_ptr = manager.load_from_fd(&handle, fd, 4096, 5000);
+        ASSERT_NE(buffer_ptr, nullptr);
+        EXPECT_EQ(reinterpret_cast<uintptr_t>(buffer_ptr) % Manager::DIRECT_IO_ALIGNMENT, 0u);
+        EXPECT_EQ(handle.size(), 2 * Manager::DIRECT_IO_ALIGNMENT);
+        EXPECT_EQ(std::memcmp(buffer_ptr, content.data() + 4096, 8192), 0);
+        manager.free(&handle);
+
+        EXPECT_EQ(manager.load_from_fd(&handle, fd, 100, 5000), nullptr) << "Unaligned offset.";
+        ::close(fd);
+    }
+    std::remove(path.c_str());
+}
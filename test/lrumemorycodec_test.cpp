@@ -0,0 +1,94 @@
+#include "gtest/gtest.h"
+
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "lrumemorycodec.h"
+
+namespace {
+
+std::vector<uint8_t> round_trip(const std::vector<uint8_t>& input, size_t& compressed_size)
+{
+    std::vector<uint8_t> compressed(input.size() + input.size() / 16 + 16);
+    compressed_size = lrumm::lz_compress(input.data(), input.size(), compressed.data(), compressed.size());
+    std::vector<uint8_t> output(input.size());
+    EXPECT_TRUE(lrumm::lz_decompress(compressed.data(), compressed_size, output.data(), output.size()));
+    return output;
+}
+
+}
+
+TEST(LRUCodecTest, RoundTrip)
+{
+    // text-like data with long repeats, overlapping runs, random bytes and the empty input
+    std::string text;
+    for (int i = 0; i < 200; ++i) {
+        text += "record " + std::to_string(i % 17) + ": the quick brown fox jumps over the lazy dog\n";
+    }
+    std::vector<uint8_t> repetitive(text.begin(), text.end());
+    std::vector<uint8_t> run(5000, 'a');
+    std::vector<uint8_t> random_bytes(3000);
+    std::mt19937 gen(7);
+    for (auto& byte : random_bytes) {
+        byte = static_cast<uint8_t>(gen());
+    }
+
+    size_t compressed_size = 0;
+    EXPECT_EQ(round_trip(repetitive, compressed_size), repetitive);
+    EXPECT_LT(compressed_size, repetitive.size() / 4);
+
+    EXPECT_EQ(round_trip(run, compressed_size), run);
+    EXPECT_LT(compressed_size, 64u);
+
+    EXPECT_EQ(round_trip(random_bytes, compressed_size), random_bytes);
+    EXPECT_GT(compressed_size, random_bytes.size());
+
+    EXPECT_EQ(round_trip({}, compressed_size), std::vector<uint8_t>());
+}
+
+TEST(LRUCodecTest, RejectsSmallOutputAndMalformedInput)
+{
+    std::vector<uint8_t> random_bytes(1000);
+    std::mt19937 gen(11);
+    for (auto& byte : random_bytes) {
+        byte = static_cast<uint8_t>(gen());
+    }
+    std::vector<uint8_t> compressed(1000);
+    EXPECT_EQ(lrumm::lz_compress(random_bytes.data(), random_bytes.size(), compressed.data(), 900), 0u)
+        << "Incompressible input does not fit a smaller output.";
+
+    std::vector<uint8_t> run(1000, 'b');
+    size_t compressed_size = lrumm::lz_compress(run.data(), run.size(), compressed.data(), compressed.size());
+    ASSERT_GT(compressed_size, 0u);
+
+    std::vector<uint8_t> output(1000);
+    EXPECT_FALSE(lrumm::lz_decompress(compressed.data(), compressed_size / 2, output.data(), output.size()));
+    EXPECT_FALSE(lrumm::lz_decompress(compressed.data(), compressed_size, output.data(), output.size() - 1));
+
+    // a match reaching before the start of the output
+    const uint8_t bad_offset[] = { 0x10, 'x', 0x05, 0x00 };
+    EXPECT_FALSE(lrumm::lz_decompress(bad_offset, sizeof(bad_offset), output.data(), 5));
+}
+
+TEST(LRUCodecTest, HashBytes)
+{
+    std::vector<uint8_t> bytes(1000);
+    std::mt19937 gen(5);
+    for (auto& byte : bytes) {
+        byte = static_cast<uint8_t>(gen());
+    }
+    const uint64_t hash = lrumm::hash_bytes(bytes.data(), bytes.size());
+    std::vector<uint8_t> copy(bytes);
+    EXPECT_EQ(lrumm::hash_bytes(copy.data(), copy.size()), hash);
+
+    // every byte and the length take part, both in the lanes and in the tail
+    for (size_t pos : {0, 500, 995, 999}) {
+        copy[pos] ^= 1;
+        EXPECT_NE(lrumm::hash_bytes(copy.data(), copy.size()), hash) << pos;
+        copy[pos] ^= 1;
+    }
+    EXPECT_NE(lrumm::hash_bytes(bytes.data(), 999), hash);
+    EXPECT_NE(lrumm::hash_bytes(bytes.data(), 0), lrumm::hash_bytes(bytes.data(), 1));
+}
@@ -0,0 +1,122 @@
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "lrumemorymanager.h"
+#include "lrumemoryexport.h"
+
+namespace {
+
+size_t count_lines(const char* text)
+{
+    return static_cast<size_t>(std::count(text, text + std::strlen(text), '\n'));
+}
+
+}
+
+TEST(LRUExportTest, ExportStateFormats)
+{
+    lrumm::LRUMemoryManager manager(2048);
+    lrumm::LRUMemoryManager::LRUMemoryHandle handle;
+    manager.alloc(&handle, 100);
+    manager.get_buffer_and_refresh(&handle);
+
+    size_t json_size = manager.export_state(lrumm::LRUExportFormat::Json, nullptr, 0);
+    std::vector<char> json(json_size + 1);
+    EXPECT_EQ(manager.export_state(lrumm::LRUExportFormat::Json, json.data(), json.size()), json_size);
+    EXPECT_EQ(std::strlen(json.data()), json_size);
+    EXPECT_EQ(json.front(), '{');
+    EXPECT_NE(std::strstr(json.data(), "\"pool_size\":2048"), nullptr);
+
+    std::vector<char> prometheus(4096);
+    size_t prometheus_size = manager.export_state(lrumm::LRUExportFormat::Prometheus, prometheus.data(), prometheus.size());
+    ASSERT_LT(prometheus_size, prometheus.size());
+    EXPECT_NE(std::strstr(prometheus.data(), "lrumm_pool_size_bytes 2048\n"), nullptr);
+    EXPECT_NE(std::strstr(prometheus.data(), "# TYPE lrumm_hits_total counter\n"), nullptr);
+#if LRUMM_ENABLE_STATS
+    EXPECT_NE(std::strstr(json.data(), "\"hits\":1,"), nullptr);
+    EXPECT_NE(std::strstr(prometheus.data(), "lrumm_allocs_total 1\n"), nullptr);
+#endif
+
+    // truncated like snprintf
+    char small[16];
+    EXPECT_EQ(manager.export_state(lrumm::LRUExportFormat::Json, small, sizeof(small)), json_size);
+    EXPECT_EQ(std::strlen(small), sizeof(small) - 1);
+}
+
+TEST(LRUExportTest, ExportHunksInChunks)
+{
+    lrumm::LRUMemoryManager manager(4096);
+    std::vector<lrumm::LRUMemoryManager::LRUMemoryHandle> handles(8);
+    for (auto& handle : handles) {
+        manager.alloc(&handle, 64);
+    }
+
+    char buffer[1024];
+    lrumm::LRUExportCursor cursor;
+    std::vector<size_t> chunks;
+    while (!cursor.is_done) {
+        ASSERT_GT(manager.export_hunks(cursor, 3, buffer, sizeof(buffer)), 0u);
+        chunks.push_back(count_lines(buffer));
+    }
+    EXPECT_EQ(chunks, (std::vector<size_t>{ 3, 3, 2 }));
+    EXPECT_EQ(manager.export_hunks(cursor, 3, buffer, sizeof(buffer)), 0u);
+
+    // a line that does not fit is left for the next call
+    lrumm::LRUExportCursor small_cursor;
+    EXPECT_EQ(manager.export_hunks(small_cursor, 3, buffer, 8), 0u);
+    EXPECT_FALSE(small_cursor.is_done);
+}
+
+TEST(LRUExportTest, ExportHunksAfterRelease)
+{
+    lrumm::LRUMemoryManager manager(4096);
+    std::vector<lrumm::LRUMemoryManager::LRUMemoryHandle> handles(8);
+    for (auto& handle : handles) {
+        manager.alloc(&handle, 64);
+    }
+
+    char buffer[1024];
+    lrumm::LRUExportCursor cursor;
+    manager.export_hunks(cursor, 3, buffer, sizeof(buffer));
+    EXPECT_EQ(count_lines(buffer), 3u);
+
+    // release the hunk the cursor points at, the walk continues with its successor
+    manager.free(&handles[3]);
+    manager.export_hunks(cursor, 10, buffer, sizeof(buffer));
+    EXPECT_TRUE(cursor.is_done);
+    EXPECT_EQ(count_lines(buffer), 4u);
+
+    std::string expected_offset = "{\"offset\":" + std::to_string(lrumm::LRUMemoryManager::get_hunk_footprint(0)
+        + 4 * lrumm::LRUMemoryManager::get_hunk_footprint(64)) + ",";
+    EXPECT_EQ(std::strncmp(buffer, expected_offset.c_str(), expected_offset.size()), 0) << buffer;
+}
+
+TEST(LRUExportTest, ExportHunksAfterChainedReleases)
+{
+    lrumm::LRUMemoryManager manager(4096);
+    std::vector<lrumm::LRUMemoryManager::LRUMemoryHandle> handles(8);
+    for (auto& handle : handles) {
+        manager.alloc(&handle, 64);
+    }
+
+    char buffer[1024];
+    lrumm::LRUExportCursor cursor;
+    manager.export_hunks(cursor, 3, buffer, sizeof(buffer));
+
+    // the successor of the released hunk is released as well, and the space before them reused
+    manager.free(&handles[3]);
+    manager.free(&handles[1]);
+    manager.free(&handles[4]);
+    manager.alloc(&handles[1], 64);
+    manager.export_hunks(cursor, 10, buffer, sizeof(buffer));
+    EXPECT_TRUE(cursor.is_done);
+    EXPECT_EQ(count_lines(buffer), 3u);
+
+    std::string expected_offset = "{\"offset\":" + std::to_string(lrumm::LRUMemoryManager::get_hunk_footprint(0)
+        + 5 * lrumm::LRUMemoryManager::get_hunk_footprint(64)) + ",";
+    EXPECT_EQ(std::strncmp(buffer, expected_offset.c_str(), expected_offset.size()), 0) << buffer;
+}
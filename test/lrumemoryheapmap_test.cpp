@@ -0,0 +1,66 @@
+#include "gtest/gtest.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "lrumemorymanager.h"
+#include "lrumemoryheapmap.h"
+
+TEST(LRUHeapMapTest, SnapshotLayoutAndRecency)
+{
+    lrumm::LRUMemoryManager manager(2048);
+    lrumm::LRUMemoryManager::LRUMemoryHandle handle0, handle1, handle2;
+    manager.alloc(&handle0, 100);
+    manager.alloc(&handle1, 200);
+    manager.alloc(&handle2, 100);
+    manager.free(&handle1);
+    manager.get_buffer_and_refresh(&handle0);
+
+    size_t map_size = manager.write_heap_map(nullptr, 0);
+    EXPECT_EQ(map_size, sizeof(lrumm::LRUHeapMapHeader) + 4 * sizeof(lrumm::LRUHeapMapRange));
+
+    std::vector<uint8_t> buffer(map_size);
+    EXPECT_EQ(manager.write_heap_map(buffer.data(), buffer.size()), map_size);
+
+    lrumm::LRUHeapMap heap_map;
+    ASSERT_TRUE(lrumm::read_heap_map(buffer.data(), buffer.size(), heap_map));
+    EXPECT_EQ(heap_map.pool_size, 2048u);
+    EXPECT_EQ(heap_map.allocated_size, manager.get_allocated_memory_size());
+
+    const size_t head_size = lrumm::LRUMemoryManager::get_hunk_footprint(0);
+    const size_t small_size = lrumm::LRUMemoryManager::get_hunk_footprint(100);
+    const size_t large_size = lrumm::LRUMemoryManager::get_hunk_footprint(200);
+
+    ASSERT_EQ(heap_map.hunks.size(), 2u);
+    EXPECT_EQ(heap_map.hunks[0].offset, head_size) << "The refreshed hunk ranks first.";
+    EXPECT_EQ(heap_map.hunks[0].size, small_size);
+    EXPECT_EQ(heap_map.hunks[1].offset, head_size + small_size + large_size);
+
+    ASSERT_EQ(heap_map.gaps.size(), 2u);
+    EXPECT_EQ(heap_map.gaps[0].offset, head_size + small_size);
+    EXPECT_EQ(heap_map.gaps[0].size, large_size);
+    EXPECT_EQ(heap_map.gaps[1].offset, head_size + 2 * small_size + large_size);
+    EXPECT_EQ(heap_map.gaps[1].size, 2048 - heap_map.gaps[1].offset);
+
+    EXPECT_FALSE(lrumm::read_heap_map(buffer.data(), buffer.size() - 1, heap_map));
+}
+
+TEST(LRUHeapMapTest, SnapshotFile)
+{
+    const std::string path = testing::TempDir() + "lrumm_heapmap_test.bin";
+    lrumm::LRUMemoryManager manager(4096);
+    std::vector<lrumm::LRUMemoryManager::LRUMemoryHandle> handles(8);
+    for (auto& handle : handles) {
+        manager.alloc(&handle, 64);
+    }
+    ASSERT_TRUE(manager.write_heap_map(path.c_str()));
+
+    lrumm::LRUHeapMap heap_map;
+    ASSERT_TRUE(lrumm::read_heap_map(path.c_str(), heap_map));
+    std::remove(path.c_str());
+    EXPECT_EQ(heap_map.hunks.size(), handles.size());
+    EXPECT_EQ(heap_map.gaps.size(), 1u) << "Only the tail of the pool is free.";
+
+    EXPECT_FALSE(manager.write_heap_map("/nonexistent-directory/heapmap.bin"));
+}
@@ -0,0 +1,120 @@
+#include "gtest/gtest.h"
+
+#include "lrumemorymanager.h"
+#include "lrumemoryhistogram.h"
+
+TEST(LRULogHistogramTest, SmallValuesAreExact)
+{
+    for (uint64_t value = 0; value < lrumm::LRULogHistogram::SUB_BUCKET_COUNT * 2; ++value) {
+        size_t index = lrumm::LRULogHistogram::bucket_index(value);
+        EXPECT_EQ(lrumm::LRULogHistogram::bucket_lower_bound(index), value);
+        EXPECT_EQ(lrumm::LRULogHistogram::bucket_upper_bound(index), value);
+    }
+}
+
+TEST(LRULogHistogramTest, BucketBoundsContainValue)
+{
+    for (uint64_t value : { 17ull, 100ull, 1000ull, 123456789ull, ~0ull }) {
+        size_t index = lrumm::LRULogHistogram::bucket_index(value);
+        ASSERT_LT(index, lrumm::LRULogHistogram::BUCKET_COUNT);
+        EXPECT_LE(lrumm::LRULogHistogram::bucket_lower_bound(index), value);
+        EXPECT_GE(lrumm::LRULogHistogram::bucket_upper_bound(index), value);
+
+        // relative error is bounded by the sub-bucket resolution
+        uint64_t width = lrumm::LRULogHistogram::bucket_upper_bound(index) - lrumm::LRULogHistogram::bucket_lower_bound(index);
+        EXPECT_LE(width, value / lrumm::LRULogHistogram::SUB_BUCKET_COUNT);
+    }
+}
+
+TEST(LRULogHistogramTest, Percentiles)
+{
+    lrumm::LRULogHistogram histogram;
+    EXPECT_EQ(histogram.value_at_percentile(50.0), 0u) << "Empty histogram.";
+
+    for (uint64_t value = 1; value <= 1000; ++value) {
+        histogram.record(value);
+    }
+
+    EXPECT_EQ(histogram.count(), 1000u);
+    EXPECT_EQ(histogram.max(), 1000u);
+    EXPECT_NEAR(static_cast<double>(histogram.value_at_percentile(50.0)), 500.0, 500.0 / 8);
+    EXPECT_NEAR(static_cast<double>(histogram.value_at_percentile(99.0)), 990.0, 990.0 / 8);
+    EXPECT_EQ(histogram.value_at_percentile(100.0), 1000u);
+}
+
+TEST(LRULogHistogramTest, Merge)
+{
+    lrumm::LRULogHistogram histogram0, histogram1;
+    histogram0.record(10);
+    histogram1.record(20000);
+
+    histogram0.merge(histogram1);
+    EXPECT_EQ(histogram0.count(), 2u);
+    EXPECT_EQ(histogram0.max(), 20000u);
+
+    histogram0.reset();
+    EXPECT_EQ(histogram0.count(), 0u);
+}
+
+#if LRUMM_ENABLE_LATENCY
+
+TEST(LRUMemoryLatencyTest, RecordsSampledOperations)
+{
+    lrumm::LRUMemoryManager manager(2048);
+    manager.set_latency_sample_period(1);
+
+    lrumm::LRUMemoryManager::LRUMemoryHandle handle0, handle1, handle2;
+    manager.alloc(&handle0, 900);
+    manager.alloc(&handle1, 900);
+    manager.get_buffer_and_refresh(&handle1);
+    manager.alloc(&handle2, 900); // evicts handle0
+    manager.free(&handle2);
+
+    auto stats = manager.get_stats();
+    EXPECT_EQ(stats.alloc_latency.samples, 3u);
+    EXPECT_EQ(stats.refresh_latency.samples, 1u);
+    EXPECT_EQ(stats.free_latency.samples, 1u);
+    EXPECT_EQ(stats.eviction_latency.samples, 1u);
+    EXPECT_EQ(stats.evictions_per_alloc.samples, 3u);
+    EXPECT_EQ(stats.evictions_per_alloc.max, 1u);
+    EXPECT_LE(stats.alloc_latency.p50, stats.alloc_latency.p99);
+    EXPECT_LE(stats.alloc_latency.p99, stats.alloc_latency.p999);
+
+    manager.reset_stats();
+    EXPECT_EQ(manager.get_stats().alloc_latency.samples, 0u);
+}
+
+TEST(LRUMemoryLatencyTest, SamplesOneOperationPerPeriod)
+{
+    lrumm::LRUMemoryManager manager(2048);
+    manager.set_latency_sample_period(4);
+
+    lrumm::LRUMemoryManager::LRUMemoryHandle handle;
+    manager.alloc(&handle, 100);
+    for (int i = 0; i < 15; ++i) {
+        manager.get_buffer_and_refresh(&handle);
+    }
+
+    auto stats = manager.get_stats();
+    EXPECT_EQ(stats.alloc_latency.samples, 0u);
+    EXPECT_EQ(stats.refresh_latency.samples, 3u);
+}
+
+TEST(LRUMemoryLatencyTest, PeriodicMixSamplesEveryOperation)
+{
+    lrumm::LRUMemoryManager manager(2048);
+    manager.set_latency_sample_period(2);
+
+    // the mix repeats every two operations, both are sampled
+    lrumm::LRUMemoryManager::LRUMemoryHandle handle;
+    for (int i = 0; i < 8; ++i) {
+        manager.alloc(&handle, 100);
+        manager.free(&handle);
+    }
+
+    auto stats = manager.get_stats();
+    EXPECT_EQ(stats.alloc_latency.samples, 4u);
+    EXPECT_EQ(stats.free_latency.samples, 4u);
+}
+
+#endif // LRUMM_ENABLE_LATENCY
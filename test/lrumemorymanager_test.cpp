@@ -1,5 +1,7 @@
 #include "gtest/gtest.h"
 
+#include <vector>
+
 #include "lrumemorymanager.h"
 
 class LRUMemoryManagerTest: public ::testing::Test {
@@ -411,6 +413,426 @@ constexpr size_t kExpectedSize0 = 250, kExpectedSize1 = 50, kExpectedSize2 = 150
     ++itr;
     EXPECT_EQ(itr, sut_.end()) << "Should be last.";}
 
+#if LRUMM_ENABLE_STATS
+
+TEST_F(LRUMemoryManagerTest, StatsCountOperations)
+{
+    lrumm::LRUMemoryManager::LRUMemoryHandle handle0, handle1;
+    sut_.alloc(&handle0, 100);
+    sut_.alloc(&handle1, 200);
+
+    sut_.get_buffer_and_refresh(&handle0);
+    sut_.free(&handle1);
+    sut_.get_buffer_and_refresh(&handle1);
+
+    auto stats = sut_.get_stats();
+    EXPECT_EQ(stats.allocs, 2u);
+    EXPECT_EQ(stats.frees, 1u);
+    EXPECT_EQ(stats.hits, 1u);
+    EXPECT_EQ(stats.misses, 1u);
+    EXPECT_EQ(stats.evictions, 0u);
+    EXPECT_EQ(stats.failed_allocs, 0u);
+    EXPECT_GT(stats.hunks_scanned, 0u);
+    EXPECT_DOUBLE_EQ(stats.hit_ratio(), 0.5);
+    EXPECT_GT(stats.peak_allocated_size, sut_.get_allocated_memory_size()) << "Peak should include the freed hunk.";
+}
+
+TEST_F(LRUMemoryManagerTest, StatsCountEvictions)
+{
+    lrumm::LRUMemoryManager::LRUMemoryHandle handle0, handle1, handle2;
+    sut_.alloc(&handle0, 900);
+    size_t evicted_size = sut_.get_allocated_memory_size();
+    sut_.alloc(&handle1, 900);
+    evicted_size = sut_.get_allocated_memory_size() - evicted_size;
+    sut_.alloc(&handle2, 900);
+
+    auto stats = sut_.get_stats();
+    EXPECT_EQ(stats.allocs, 3u);
+    EXPECT_EQ(stats.evictions, 1u);
+    EXPECT_EQ(stats.evicted_bytes, evicted_size);
+    EXPECT_EQ(stats.frees, 0u) << "Evictions are not explicit frees.";
+
+    lrumm::LRUMemoryManager::LRUMemoryHandle handle3;
+    EXPECT_EQ(sut_.alloc(&handle3, 4096), nullptr);
+    stats = sut_.get_stats();
+    EXPECT_EQ(stats.failed_allocs, 1u);
+    EXPECT_EQ(stats.evictions, 3u);
+}
+
+TEST_F(LRUMemoryManagerTest, StatsReset)
+{
+    lrumm::LRUMemoryManager::LRUMemoryHandle handle;
+    sut_.alloc(&handle, 100);
+    sut_.get_buffer_and_refresh(&handle);
+
+    sut_.reset_stats();
+
+    auto stats = sut_.get_stats();
+    EXPECT_EQ(stats.allocs, 0u);
+    EXPECT_EQ(stats.hits, 0u);
+    EXPECT_EQ(stats.hunks_scanned, 0u);
+    EXPECT_EQ(stats.peak_allocated_size, sut_.get_allocated_memory_size());
+}
+
+TEST_F(LRUMemoryManagerTest, StatsFreeGaps)
+{
+    auto stats = sut_.get_stats();
+    EXPECT_EQ(stats.free_gap_count, 1u);
+    EXPECT_EQ(stats.free_bytes, 2048 - sut_.get_allocated_memory_size());
+    EXPECT_EQ(stats.largest_free_gap, stats.free_bytes);
+
+    lrumm::LRUMemoryManager::LRUMemoryHandle handle0, handle1, handle2, handle3;
+    sut_.alloc(&handle0, 100);
+    sut_.alloc(&handle1, 100);
+    sut_.alloc(&handle2, 100);
+    size_t hunk_size = (sut_.get_allocated_memory_size() - (2048 - stats.free_bytes)) / 3;
+    sut_.free(&handle1);
+
+    // one hole in the middle plus the trailing free space
+    stats = sut_.get_stats();
+    size_t trailing_gap = stats.free_bytes - hunk_size;
+    EXPECT_EQ(stats.free_gap_count, 2u);
+    EXPECT_EQ(stats.gap_histogram[63 - __builtin_clzll(hunk_size)], 1u);
+    EXPECT_EQ(stats.gap_histogram[63 - __builtin_clzll(trailing_gap)], 1u);
+    EXPECT_EQ(stats.largest_free_gap, trailing_gap);
+    EXPECT_GT(stats.external_fragmentation(), 0.0);
+
+    // filling the trailing gap leaves the hole as the largest one
+    sut_.alloc(&handle3, trailing_gap - lrumm::LRUMemoryManager::get_hunk_footprint(0));
+    stats = sut_.get_stats();
+    EXPECT_EQ(stats.free_gap_count, 1u);
+    EXPECT_EQ(stats.largest_free_gap, hunk_size);
+    sut_.free(&handle3);
+
+    // releasing the neighbours merges everything into a single gap again
+    sut_.free(&handle0);
+    sut_.free(&handle2);
+    stats = sut_.get_stats();
+    EXPECT_EQ(stats.free_gap_count, 1u);
+    EXPECT_EQ(stats.largest_free_gap, stats.free_bytes);
+}
+
+TEST_F(LRUMemoryManagerTest, StatsEvictionReasons)
+{
+    lrumm::LRUMemoryManager::LRUMemoryHandle handle0, handle1, handle2;
+    sut_.alloc(&handle0, 100);
+    sut_.alloc(&handle1, 100);
+    sut_.alloc(&handle2, 100);
+    sut_.free(&handle1);
+
+    // fits into the total free space, but not into any single gap
+    auto stats = sut_.get_stats();
+    lrumm::LRUMemoryManager::LRUMemoryHandle handle3;
+    EXPECT_NE(sut_.alloc(&handle3, stats.free_bytes - 128), nullptr);
+
+    stats = sut_.get_stats();
+    EXPECT_EQ(stats.evictions, 2u);
+    EXPECT_EQ(stats.evictions_fragmentation, 2u);
+    EXPECT_EQ(stats.evictions_capacity, 0u);
+
+    // does not fit into the free space at all
+    lrumm::LRUMemoryManager::LRUMemoryHandle handle4;
+    EXPECT_NE(sut_.alloc(&handle4, 1000), nullptr);
+    stats = sut_.get_stats();
+    EXPECT_EQ(stats.evictions_capacity, 1u);
+}
+
+#endif // LRUMM_ENABLE_STATS
+
+TEST_F(LRUMemoryManagerTest, SealSharesIdenticalPayloads)
+{
+    lrumm::LRUMemoryManager::LRUMemoryHandle handle1, handle2, handle3;
+    memset(sut_.alloc(&handle1, 100), 'x', 100);
+    EXPECT_FALSE(sut_.seal(&handle1)) << "Deduplication is disabled.";
+    EXPECT_FALSE(handle1.is_sealed());
+
+    // hunks allocated from now on have their padding zeroed
+    sut_.set_dedup_enabled(true);
+    sut_.free(&handle1);
+    memset(sut_.alloc(&handle1, 100), 'x', 100);
+    memset(sut_.alloc(&handle2, 100), 'x', 100);
+    memset(sut_.alloc(&handle3, 100), 'y', 100);
+    size_t allocated_size = sut_.get_allocated_memory_size();
+
+    EXPECT_FALSE(sut_.seal(&handle1));
+    EXPECT_TRUE(sut_.seal(&handle2));
+    EXPECT_FALSE(sut_.seal(&handle3));
+
+    EXPECT_TRUE(handle2.is_shared());
+    EXPECT_EQ(handle2.hunk_ptr(), handle1.hunk_ptr());
+    EXPECT_EQ(sut_.get_allocated_memory_size(), allocated_size - lrumm::LRUMemoryManager::get_hunk_footprint(100));
+    EXPECT_EQ(sut_.get_buffer_and_refresh(&handle2), sut_.get_buffer_and_refresh(&handle1));
+
+#if LRUMM_ENABLE_STATS
+    auto stats = sut_.get_stats();
+    EXPECT_EQ(stats.seals, 3u);
+    EXPECT_EQ(stats.seal_shares, 1u);
+    EXPECT_EQ(stats.seal_shared_bytes, lrumm::LRUMemoryManager::get_hunk_footprint(100));
+#endif
+
+    // the hunk outlives the handle it was allocated for
+    sut_.free(&handle1);
+    auto* buffer_ptr = static_cast<const char*>(sut_.get_buffer_and_refresh(&handle2));
+    ASSERT_NE(buffer_ptr, nullptr);
+    EXPECT_EQ(buffer_ptr[99], 'x');
+    EXPECT_FALSE(handle2.is_shared());
+    EXPECT_EQ(&*sut_.begin(false), &handle2);
+
+    sut_.free(&handle2);
+    sut_.free(&handle3);
+    EXPECT_EQ(sut_.get_allocated_memory_size(), lrumm::LRUMemoryManager::get_hunk_footprint(0));
+}
+
+TEST_F(LRUMemoryManagerTest, SealMatchesResizedPayloads)
+{
+    sut_.set_dedup_enabled(true);
+    lrumm::LRUMemoryManager::LRUMemoryHandle handle1, handle2, handle3;
+    memset(sut_.alloc(&handle1, 100), 'x', 100);
+    EXPECT_FALSE(sut_.seal(&handle1));
+
+    // shrinking leaves payload bytes in the padding
+    memset(sut_.alloc(&handle2, 110), 'x', 110);
+    ASSERT_TRUE(sut_.resize_in_place(&handle2, 100));
+    EXPECT_TRUE(sut_.seal(&handle2));
+
+    // growing takes free space that held an older payload
+    memset(sut_.alloc(&handle3, 150), 'y', 150);
+    sut_.free(&handle3);
+    sut_.alloc(&handle3, 20);
+    ASSERT_TRUE(sut_.resize_in_place(&handle3, 100));
+    memset(sut_.get_buffer_and_refresh(&handle3), 'x', 100);
+    EXPECT_TRUE(sut_.seal(&handle3));
+    EXPECT_EQ(handle3.hunk_ptr(), handle1.hunk_ptr());
+}
+
+TEST(LRUMemoryManagerAlignedTest, AlignedAllocationLeavesTheSkippedBytesFree)
+{
+    using Manager = lrumm::LRUMemoryManager;
+    Manager manager(4 * Manager::DIRECT_IO_ALIGNMENT);
+    Manager::LRUMemoryHandle first, aligned, small;
+
+    void* first_ptr = manager.alloc(&first, 100);
+    void* aligned_ptr = manager.alloc_aligned(&aligned, 1000);
+    ASSERT_NE(aligned_ptr, nullptr);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(aligned_ptr) % Manager::DIRECT_IO_ALIGNMENT, 0u);
+    EXPECT_EQ(aligned.size(), Manager::get_hunk_footprint(1000) - Manager::get_hunk_footprint(0));
+
+    // the bytes skipped before the aligned hunk take a smaller allocation
+    void* small_ptr = manager.alloc(&small, 200);
+    ASSERT_NE(small_ptr, nullptr);
+    EXPECT_LT(small_ptr, aligned_ptr);
+#if LRUMM_ENABLE_STATS
+    EXPECT_EQ(manager.get_stats().free_gap_count, 2u);
+#endif
+
+    manager.free(&first);
+    manager.free(&aligned);
+    manager.free(&small);
+    EXPECT_EQ(manager.get_allocated_memory_size(), Manager::get_hunk_footprint(0));
+#if LRUMM_ENABLE_STATS
+    EXPECT_EQ(manager.get_stats().free_gap_count, 1u);
+#endif
+
+    // the pool is empty again, the next allocation goes to the start
+    EXPECT_EQ(manager.alloc(&first, 100), first_ptr);
+    manager.free(&first);
+}
+
+TEST_F(LRUMemoryManagerTest, ResizeInPlace)
+{
+    lrumm::LRUMemoryManager::LRUMemoryHandle handle1, handle2;
+    void* buffer_ptr = sut_.alloc(&handle1, 100);
+    sut_.alloc(&handle2, 100);
+
+    // shrinking leaves a gap the hunk can grow back into, but not past the next hunk
+    EXPECT_TRUE(sut_.resize_in_place(&handle1, 20));
+    EXPECT_EQ(handle1.size(), lrumm::LRUMemoryManager::get_hunk_footprint(20) - lrumm::LRUMemoryManager::get_hunk_footprint(0));
+#if LRUMM_ENABLE_STATS
+    EXPECT_EQ(sut_.get_stats().free_gap_count, 2u);
+#endif
+    EXPECT_TRUE(sut_.resize_in_place(&handle1, 100));
+    EXPECT_FALSE(sut_.resize_in_place(&handle1, 200));
+    EXPECT_EQ(sut_.get_buffer_and_refresh(&handle1), buffer_ptr);
+
+    // the last hunk grows up to the end of the pool
+    EXPECT_TRUE(sut_.resize_in_place(&handle2, 2048 - 2 * 48 - lrumm::LRUMemoryManager::get_hunk_footprint(100)));
+    EXPECT_EQ(sut_.get_allocated_memory_size(), 2048u);
+    EXPECT_FALSE(sut_.resize_in_place(&handle2, 2048));
+#if LRUMM_ENABLE_STATS
+    EXPECT_EQ(sut_.get_stats().free_gap_count, 0u);
+#endif
+    sut_.free(&handle1);
+    sut_.free(&handle2);
+}
+
+TEST_F(LRUMemoryManagerTest, EvictionReleasesAllReferences)
+{
+    sut_.set_dedup_enabled(true);
+    lrumm::LRUMemoryManager::LRUMemoryHandle handles[3], large;
+    for (auto& handle : handles) {
+        memset(sut_.alloc(&handle, 500), 'z', 500);
+        sut_.seal(&handle);
+    }
+    EXPECT_EQ(handles[2].hunk_ptr(), handles[0].hunk_ptr());
+
+    // the shared hunk is evicted once, for every reference
+    memset(sut_.alloc(&large, 1900), 'z', 500);
+    for (auto& handle : handles) {
+        EXPECT_EQ(handle.hunk_ptr(), nullptr);
+        EXPECT_FALSE(handle.is_sealed());
+        EXPECT_EQ(sut_.get_buffer_and_refresh(&handle), nullptr);
+    }
+
+    // the evicted hunk is no longer a match
+    sut_.free(&large);
+    memset(sut_.alloc(&handles[0], 500), 'z', 500);
+    EXPECT_FALSE(sut_.seal(&handles[0]));
+    memset(sut_.alloc(&handles[1], 500), 'z', 500);
+    EXPECT_TRUE(sut_.seal(&handles[1]));
+    sut_.flush();
+    EXPECT_EQ(handles[1].hunk_ptr(), nullptr);
+    EXPECT_FALSE(handles[1].is_sealed());
+}
+
+TEST_F(LRUMemoryManagerTest, ResizePool)
+{
+    lrumm::LRUMemoryManager::LRUMemoryHandle handles[4];
+    for (int i = 0; i < 3; ++i) {
+        sut_.alloc(&handles[i], 500);
+    }
+
+    // the hunk reaching past the new end is evicted, the rest stay in place
+    EXPECT_FALSE(sut_.resize_pool(4096));
+    EXPECT_TRUE(sut_.resize_pool(1200));
+    EXPECT_EQ(sut_.get_pool_size(), 1200u);
+    EXPECT_EQ(sut_.get_pool_capacity(), 2048u);
+    EXPECT_EQ(handles[2].hunk_ptr(), nullptr);
+    EXPECT_NE(handles[1].hunk_ptr(), nullptr);
+
+    // allocations stay below the end
+    ASSERT_NE(sut_.alloc(&handles[3], 500), nullptr);
+    EXPECT_EQ(handles[0].hunk_ptr(), nullptr);
+#if LRUMM_ENABLE_STATS
+    auto stats = sut_.get_stats();
+    EXPECT_EQ(stats.free_bytes, 1200u - sut_.get_allocated_memory_size());
+    EXPECT_EQ(stats.free_gap_count, 1u);
+    EXPECT_EQ(stats.pool_shrinks, 1u);
+#endif
+
+    EXPECT_TRUE(sut_.resize_pool(2048));
+    ASSERT_NE(sut_.alloc(&handles[2], 800), nullptr);
+    EXPECT_NE(handles[1].hunk_ptr(), nullptr);
+    EXPECT_NE(handles[3].hunk_ptr(), nullptr);
+    sut_.flush();
+}
+
+TEST_F(LRUMemoryManagerTest, RecencyEpoch)
+{
+    lrumm::LRUMemoryManager::LRUMemoryHandle handles[4];
+    sut_.set_recency_epoch(100);
+    for (int i = 0; i < 3; ++i) {
+        sut_.alloc(&handles[i], 500);
+    }
+
+    // refreshed in the epoch it was linked in, the hunk stays the least recent
+    sut_.get_buffer_and_refresh(&handles[0]);
+    sut_.alloc(&handles[3], 500);
+    EXPECT_EQ(handles[0].hunk_ptr(), nullptr);
+    EXPECT_NE(handles[1].hunk_ptr(), nullptr);
+
+    // three operations per epoch: the second refresh of handle 1 stays, the one after the epoch ends moves it
+    sut_.set_recency_epoch(3);
+    sut_.get_buffer_and_refresh(&handles[1]);
+    sut_.get_buffer_and_refresh(&handles[1]);
+    sut_.get_buffer_and_refresh(&handles[2]);
+    sut_.get_buffer_and_refresh(&handles[1]);
+    std::vector<const lrumm::LRUMemoryManager::LRUMemoryHandle*> order;
+    for (const auto& handle : sut_) {
+        order.push_back(&handle);
+    }
+    EXPECT_EQ(order, (std::vector<const lrumm::LRUMemoryManager::LRUMemoryHandle*>{ &handles[1], &handles[2], &handles[3] }));
+#if LRUMM_ENABLE_STATS
+    EXPECT_EQ(sut_.get_stats().relinks_skipped, 2u);
+#endif
+
+    // exact LRU again
+    sut_.set_recency_epoch(0);
+    sut_.get_buffer_and_refresh(&handles[3]);
+    sut_.get_buffer_and_refresh(&handles[3]);
+    sut_.alloc(&handles[0], 500);
+    EXPECT_EQ(handles[2].hunk_ptr(), nullptr);
+    EXPECT_NE(handles[1].hunk_ptr(), nullptr);
+    sut_.flush();
+}
+
+TEST_F(LRUMemoryManagerTest, LargeObjectRegion)
+{
+    using Manager = lrumm::LRUMemoryManager;
+    Manager manager(16384);
+    manager.set_large_object_region(4096, 16384);
+
+    // 4096 byte payloads map two pages each
+    Manager::LRUMemoryHandle small[20], large[4];
+    for (auto& handle : small) {
+        manager.alloc(&handle, 500);
+    }
+    size_t pool_allocated_size = manager.get_allocated_memory_size();
+    for (int i : {0, 1}) {
+        void* buffer_ptr = manager.alloc(&large[i], 4096);
+        ASSERT_NE(buffer_ptr, nullptr);
+        EXPECT_EQ(reinterpret_cast<uintptr_t>(buffer_ptr) % Manager::DIRECT_IO_ALIGNMENT, 0u);
+        memset(buffer_ptr, 'l', 4096);
+    }
+    EXPECT_EQ(manager.get_allocated_memory_size(), pool_allocated_size);
+    EXPECT_EQ(manager.get_large_allocated_size(), 4 * Manager::DIRECT_IO_ALIGNMENT);
+    ASSERT_DEATH(large[0].next(), "") << "Large objects have no neighbours in the address order.";
+
+    // over the shared budget, the idle large object goes before the hot small hunks
+    for (auto& handle : small) {
+        manager.get_buffer_and_refresh(&handle);
+    }
+    ASSERT_NE(manager.alloc(&large[2], 4096), nullptr);
+    EXPECT_EQ(large[0].hunk_ptr(), nullptr);
+    for (auto& handle : small) {
+        EXPECT_NE(handle.hunk_ptr(), nullptr);
+    }
+
+    // once the small hunks are the idle ones, the large region grows past its own budget
+    for (int i = 0; i < 100; ++i) {
+        manager.get_buffer_and_refresh(&large[1]);
+        manager.get_buffer_and_refresh(&large[2]);
+    }
+    ASSERT_NE(manager.alloc(&large[3], 4096), nullptr);
+    for (int i = 0; i < 20; ++i) {
+        EXPECT_EQ(small[i].hunk_ptr() != nullptr, i >= 6) << i;
+    }
+    EXPECT_EQ(manager.get_large_allocated_size(), 6 * Manager::DIRECT_IO_ALIGNMENT);
+
+    // and the pool gives way to it while it stays over that budget
+    Manager::LRUMemoryHandle extra;
+    ASSERT_NE(manager.alloc(&extra, 500), nullptr);
+    EXPECT_EQ(small[6].hunk_ptr(), nullptr);
+    EXPECT_NE(small[7].hunk_ptr(), nullptr);
+
+    // large objects resize within their pages
+    EXPECT_FALSE(manager.resize_in_place(&large[3], 8192));
+    EXPECT_TRUE(manager.resize_in_place(&large[3], 100));
+    EXPECT_EQ(manager.get_large_allocated_size(), 6 * Manager::DIRECT_IO_ALIGNMENT);
+
+#if LRUMM_ENABLE_STATS
+    auto stats = manager.get_stats();
+    EXPECT_EQ(stats.large_allocs, 4u);
+    EXPECT_EQ(stats.large_evictions, 1u);
+    EXPECT_EQ(stats.evictions, 8u);
+#endif
+
+    manager.free(&large[1]);
+    EXPECT_EQ(manager.get_large_allocated_size(), 4 * Manager::DIRECT_IO_ALIGNMENT);
+    manager.flush();
+    EXPECT_EQ(manager.get_large_allocated_size(), 0u);
+    EXPECT_EQ(large[2].hunk_ptr(), nullptr);
+}
+
 #if __has_feature(address_sanitizer) || defined(__SANITIZE_ADDRESS__)
 
 // ASAN Positive Scenario Tests
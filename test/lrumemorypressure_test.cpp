@@ -0,0 +1,133 @@
+#include "gtest/gtest.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "lrumemorymanager.h"
+#include "lrumemorypressure.h"
+
+namespace {
+
+using Manager = lrumm::LRUMemoryManager;
+using lrumm::LRUPressureAction;
+
+void write_file(const std::string& path, const char* text)
+{
+    std::FILE* file_ptr = std::fopen(path.c_str(), "w");
+    ASSERT_NE(file_ptr, nullptr);
+    std::fputs(text, file_ptr);
+    std::fclose(file_ptr);
+}
+
+void write_pressure(const std::string& path, double avg10)
+{
+    char text[256];
+    std::snprintf(text, sizeof(text), "some avg10=%.2f avg60=0.00 avg300=0.00 total=100\n"
+        "full avg10=0.00 avg60=0.00 avg300=0.00 total=0\n", avg10);
+    write_file(path, text);
+}
+
+}
+
+TEST(LRUPressureMonitorTest, ShrinksUnderPressureAndGrowsBack)
+{
+    const std::string pressure_path = testing::TempDir() + "lrumm_memory.pressure";
+    lrumm::LRUPressureConfig config;
+    config.pressure_path = pressure_path.c_str();
+    config.events_path = "/nonexistent-directory/memory.events";
+    config.min_pool_size = 16 * 1024;
+    config.clear_polls = 2;
+
+    Manager manager(64 * 1024);
+    lrumm::LRUPressureMonitor monitor(manager, config);
+    std::vector<Manager::LRUMemoryHandle> handles(60);
+    for (auto& handle : handles) {
+        manager.alloc(&handle, 1000);
+    }
+
+    write_pressure(pressure_path, 25.0);
+    EXPECT_EQ(monitor.poll(), LRUPressureAction::Shrink);
+    EXPECT_TRUE(monitor.is_available());
+    EXPECT_DOUBLE_EQ(monitor.avg10(), 25.0);
+    EXPECT_EQ(manager.get_pool_size(), 48u * 1024);
+    EXPECT_LE(manager.get_allocated_memory_size(), manager.get_pool_size());
+    EXPECT_EQ(handles[46].hunk_ptr(), nullptr) << "Past the new end.";
+    EXPECT_NE(handles[45].hunk_ptr(), nullptr);
+
+    // down to the minimum, then no further
+    while (monitor.poll() == LRUPressureAction::Shrink) {
+    }
+    EXPECT_EQ(manager.get_pool_size(), 16u * 1024);
+
+    // between the thresholds nothing changes; growing takes consecutive cleared polls
+    write_pressure(pressure_path, 5.0);
+    EXPECT_EQ(monitor.poll(), LRUPressureAction::None);
+    write_pressure(pressure_path, 0.5);
+    EXPECT_EQ(monitor.poll(), LRUPressureAction::None);
+    EXPECT_EQ(monitor.poll(), LRUPressureAction::Grow);
+    EXPECT_GT(manager.get_pool_size(), 16u * 1024);
+
+    size_t polls = 0;
+    while (manager.get_pool_size() < manager.get_pool_capacity() && polls++ < 100) {
+        monitor.poll();
+    }
+    EXPECT_EQ(manager.get_pool_size(), 64u * 1024);
+    EXPECT_EQ(monitor.poll(), LRUPressureAction::None);
+
+    // the pool takes the released pages back
+    for (auto& handle : handles) {
+        if (!handle.hunk_ptr()) {
+            ASSERT_NE(manager.alloc(&handle, 1000), nullptr);
+        }
+    }
+    EXPECT_NE(handles[0].hunk_ptr(), nullptr);
+
+#if LRUMM_ENABLE_STATS
+    auto stats = manager.get_stats();
+    EXPECT_EQ(stats.pool_shrinks, 5u);
+    EXPECT_GT(stats.pool_grows, 0u);
+#endif
+    manager.flush();
+    std::remove(pressure_path.c_str());
+}
+
+TEST(LRUPressureMonitorTest, LimitEventsShrink)
+{
+    const std::string events_path = testing::TempDir() + "lrumm_memory.events";
+    lrumm::LRUPressureConfig config;
+    config.pressure_path = "/nonexistent-directory/memory.pressure";
+    config.events_path = events_path.c_str();
+    config.clear_polls = 1;
+
+    Manager manager(64 * 1024);
+    lrumm::LRUPressureMonitor monitor(manager, config);
+
+    // the first poll takes the counts as they are
+    write_file(events_path, "low 7\nhigh 2\nmax 1\noom 0\noom_kill 0\n");
+    EXPECT_EQ(monitor.poll(), LRUPressureAction::None);
+    EXPECT_EQ(manager.get_pool_size(), 64u * 1024);
+
+    write_file(events_path, "low 9\nhigh 2\nmax 2\noom 0\noom_kill 0\n");
+    EXPECT_EQ(monitor.poll(), LRUPressureAction::Shrink);
+    EXPECT_EQ(manager.get_pool_size(), 48u * 1024);
+
+    // reclaim below the protection is no pressure
+    write_file(events_path, "low 12\nhigh 2\nmax 2\noom 0\noom_kill 0\n");
+    EXPECT_EQ(monitor.poll(), LRUPressureAction::Grow);
+    EXPECT_EQ(manager.get_pool_size(), 64u * 1024);
+    std::remove(events_path.c_str());
+}
+
+TEST(LRUPressureMonitorTest, MissingFiles)
+{
+    lrumm::LRUPressureConfig config;
+    config.pressure_path = "/nonexistent-directory/memory.pressure";
+    config.events_path = "/nonexistent-directory/memory.events";
+
+    Manager manager(4096);
+    lrumm::LRUPressureMonitor monitor(manager, config);
+    EXPECT_EQ(monitor.poll(), LRUPressureAction::None);
+    EXPECT_FALSE(monitor.is_available());
+    EXPECT_EQ(manager.get_pool_size(), 4096u);
+}
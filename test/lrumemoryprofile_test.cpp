@@ -0,0 +1,112 @@
+#include "gtest/gtest.h"
+
+#include <cstdio>
+#include <vector>
+
+#include "lrumemorymanager.h"
+#include "lrumemoryprofile.h"
+
+namespace {
+
+const lrumm::LRUSiteStats* find_tagged_site(const std::vector<lrumm::LRUSiteStats>& sites, const char* tag)
+{
+    for (const auto& site : sites) {
+        if (site.tag == tag) {
+            return &site;
+        }
+    }
+    return nullptr;
+}
+
+}
+
+TEST(LRUSiteProfilerTest, TaggedSitesLiveFreedEvicted)
+{
+    using Manager = lrumm::LRUMemoryManager;
+    static const char* const DECODER_TAG = "decoder";
+    static const char* const PARSER_TAG = "parser";
+
+    // a period of one byte samples every allocation with its exact footprint
+    lrumm::LRUSiteProfiler profiler(1);
+    Manager manager(2048);
+    manager.set_site_profiler(&profiler);
+
+    Manager::LRUMemoryHandle handles[4];
+    profiler.set_site_tag(DECODER_TAG);
+    manager.alloc(&handles[0], 400);
+    manager.alloc(&handles[1], 400);
+    profiler.set_site_tag(PARSER_TAG);
+    manager.alloc(&handles[2], 600);
+    manager.free(&handles[1]);
+
+    // does not fit next to the others: evicts the oldest decoder buffer
+    manager.alloc(&handles[3], 840);
+    EXPECT_EQ(handles[0].hunk_ptr(), nullptr);
+
+    const uint64_t small_footprint = Manager::get_hunk_footprint(400);
+    const uint64_t medium_footprint = Manager::get_hunk_footprint(600);
+    const uint64_t large_footprint = Manager::get_hunk_footprint(840);
+
+    auto sites = profiler.sites();
+    ASSERT_EQ(sites.size(), 2u);
+    EXPECT_EQ(sites[0].tag, PARSER_TAG) << "Sites are sorted by live bytes.";
+
+    const auto* decoder_ptr = find_tagged_site(sites, DECODER_TAG);
+    ASSERT_NE(decoder_ptr, nullptr);
+    EXPECT_EQ(decoder_ptr->samples, 2u);
+    EXPECT_EQ(decoder_ptr->alloc_bytes, 2 * small_footprint);
+    EXPECT_EQ(decoder_ptr->live_bytes, 0u);
+    EXPECT_EQ(decoder_ptr->freed_bytes, small_footprint);
+    EXPECT_EQ(decoder_ptr->evicted_bytes, small_footprint);
+
+    const auto* parser_ptr = find_tagged_site(sites, PARSER_TAG);
+    ASSERT_NE(parser_ptr, nullptr);
+    EXPECT_EQ(parser_ptr->live_bytes, medium_footprint + large_footprint);
+
+    manager.flush();
+    sites = profiler.sites();
+    parser_ptr = find_tagged_site(sites, PARSER_TAG);
+    EXPECT_EQ(parser_ptr->live_bytes, 0u);
+    EXPECT_EQ(parser_ptr->freed_bytes, medium_footprint + large_footprint);
+
+    // a failed allocation is withdrawn
+    manager.alloc(&handles[0], 4096);
+    sites = profiler.sites();
+    EXPECT_EQ(find_tagged_site(sites, PARSER_TAG)->samples, 2u);
+    manager.set_site_profiler(nullptr);
+}
+
+TEST(LRUSiteProfilerTest, SampledEstimate)
+{
+    using Manager = lrumm::LRUMemoryManager;
+    constexpr size_t ALLOC_COUNT = 10000;
+
+    lrumm::LRUSiteProfiler profiler(4096);
+    Manager manager(4 * 1024 * 1024);
+    manager.set_site_profiler(&profiler);
+
+    std::vector<Manager::LRUMemoryHandle> handles(ALLOC_COUNT);
+    for (auto& handle : handles) {
+        manager.alloc(&handle, 256);
+    }
+
+    auto sites = profiler.sites();
+    ASSERT_EQ(sites.size(), 1u) << "All allocations come from one call site.";
+    EXPECT_EQ(sites[0].tag, nullptr);
+    EXPECT_LT(sites[0].samples, ALLOC_COUNT / 5);
+
+    // the scaled estimate stays close to the real pool usage
+    double real_bytes = static_cast<double>(ALLOC_COUNT * Manager::get_hunk_footprint(256));
+    EXPECT_NEAR(static_cast<double>(sites[0].live_bytes), real_bytes, real_bytes * 0.15);
+
+    // a handle sampled before the profiler was detached is still released cleanly
+    manager.set_site_profiler(nullptr);
+    manager.flush();
+    EXPECT_NE(sites[0].live_bytes, 0u);
+
+    std::FILE* file_ptr = std::tmpfile();
+    ASSERT_NE(file_ptr, nullptr);
+    profiler.print_report(file_ptr);
+    EXPECT_GT(std::ftell(file_ptr), 0);
+    std::fclose(file_ptr);
+}
@@ -0,0 +1,171 @@
+#include "gtest/gtest.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "lrumemorymanager.h"
+#include "lrumemoryreplay.h"
+#include "lrumemorytrace.h"
+
+namespace {
+
+std::string write_text_file(const char* name, const char* contents)
+{
+    std::string path = testing::TempDir() + name;
+    std::FILE* file_ptr = std::fopen(path.c_str(), "w");
+    std::fputs(contents, file_ptr);
+    std::fclose(file_ptr);
+    return path;
+}
+
+}
+
+TEST(LRUTraceReplayTest, ReadCsvTrace)
+{
+    auto path = write_text_file("lrumm_replay_test.csv",
+        "op,handle_id,size,delta_ns\n"
+        "# comment\n"
+        "alloc,1,100,5\n"
+        "refresh,1,0\n"
+        "evict,1,100\n"
+        "free,0x10,64\n");
+
+    std::vector<lrumm::LRUTraceRecord> records;
+    ASSERT_TRUE(lrumm::read_trace(path.c_str(), records));
+    std::remove(path.c_str());
+
+    ASSERT_EQ(records.size(), 4u);
+    EXPECT_EQ(records[0].op(), lrumm::LRUTraceOp::Alloc);
+    EXPECT_EQ(records[0].size, 100u);
+    EXPECT_EQ(records[0].delta_ns(), 5u);
+    EXPECT_EQ(records[1].op(), lrumm::LRUTraceOp::Refresh);
+    EXPECT_EQ(records[2].op(), lrumm::LRUTraceOp::Evict);
+    EXPECT_EQ(records[3].op(), lrumm::LRUTraceOp::Free);
+    EXPECT_EQ(records[3].handle_id, 16u);
+}
+
+TEST(LRUTraceReplayTest, RejectMalformedCsv)
+{
+    auto path = write_text_file("lrumm_replay_bad_test.csv", "resize,1,100\n");
+
+    std::vector<lrumm::LRUTraceRecord> records;
+    EXPECT_FALSE(lrumm::read_trace(path.c_str(), records));
+    std::remove(path.c_str());
+}
+
+TEST(LRUTraceReplayTest, ReadRecordedTrace)
+{
+    const std::string path = testing::TempDir() + "lrumm_replay_test.bin";
+    {
+        lrumm::LRUMemoryManager manager(2048);
+        lrumm::LRUTraceRecorder recorder(path.c_str());
+        manager.set_trace_recorder(&recorder);
+
+        lrumm::LRUMemoryManager::LRUMemoryHandle handle;
+        manager.alloc(&handle, 100);
+        manager.get_buffer_and_refresh(&handle);
+        manager.free(&handle);
+        manager.set_trace_recorder(nullptr);
+    }
+
+    std::vector<lrumm::LRUTraceRecord> records;
+    ASSERT_TRUE(lrumm::read_trace(path.c_str(), records));
+    std::remove(path.c_str());
+    EXPECT_EQ(records.size(), 3u);
+}
+
+TEST(LRUTraceReplayTest, ReplayCountsHitsAndRefills)
+{
+    // three 900 byte buffers accessed round robin: a 2 KiB pool only keeps one
+    std::vector<lrumm::LRUTraceRecord> records;
+    for (uint64_t id = 1; id <= 3; ++id) {
+        records.push_back(lrumm::LRUTraceRecord::make(lrumm::LRUTraceOp::Alloc, id, 900, 0));
+    }
+    for (int round = 0; round < 2; ++round) {
+        for (uint64_t id = 1; id <= 3; ++id) {
+            records.push_back(lrumm::LRUTraceRecord::make(lrumm::LRUTraceOp::Refresh, id, 900, 0));
+        }
+    }
+    records.push_back(lrumm::LRUTraceRecord::make(lrumm::LRUTraceOp::Evict, 1, 900, 0));
+    records.push_back(lrumm::LRUTraceRecord::make(lrumm::LRUTraceOp::Free, 3, 900, 0));
+
+    lrumm::LRUTraceReplay trace_replay(records);
+    EXPECT_EQ(trace_replay.slot_count(), 3u);
+    EXPECT_EQ(trace_replay.step_count(), records.size() - 1) << "Evictions are not replayed.";
+
+    lrumm::LRUMemoryManager small_manager(2048);
+    auto small_result = trace_replay.run(small_manager);
+    EXPECT_EQ(small_result.refreshes, 6u);
+    EXPECT_EQ(small_result.hits, 0u);
+    EXPECT_EQ(small_result.misses, 6u);
+    EXPECT_EQ(small_result.allocs, 9u) << "Every miss allocates again.";
+    EXPECT_EQ(small_result.frees, 1u);
+
+    lrumm::LRUMemoryManager large_manager(8192);
+    uint64_t observed = 0;
+    auto large_result = trace_replay.run(large_manager, 2, [&observed](const lrumm::LRUMemoryManager&, uint64_t) { observed++; });
+    EXPECT_EQ(large_result.hits, 6u);
+    EXPECT_DOUBLE_EQ(large_result.hit_ratio(), 1.0);
+    EXPECT_DOUBLE_EQ(large_result.byte_hit_ratio(), 1.0);
+    EXPECT_EQ(large_result.allocs, 3u);
+    EXPECT_EQ(observed, large_result.steps / 2);
+}
+
+TEST(LRUTraceReplayTest, UnfragmentedReference)
+{
+    // freeing the first buffer leaves a hole too small for the fourth one,
+    // so the real pool evicts the second buffer although the bytes would fit
+    using lrumm::LRUTraceOp;
+    std::vector<lrumm::LRUTraceRecord> records = {
+        lrumm::LRUTraceRecord::make(LRUTraceOp::Alloc, 1, 400, 0),
+        lrumm::LRUTraceRecord::make(LRUTraceOp::Alloc, 2, 900, 0),
+        lrumm::LRUTraceRecord::make(LRUTraceOp::Alloc, 3, 400, 0),
+        lrumm::LRUTraceRecord::make(LRUTraceOp::Free, 1, 400, 0),
+        lrumm::LRUTraceRecord::make(LRUTraceOp::Alloc, 4, 500, 0),
+        lrumm::LRUTraceRecord::make(LRUTraceOp::Refresh, 2, 900, 0),
+    };
+    lrumm::LRUTraceReplay trace_replay(records);
+
+    lrumm::LRUMemoryManager manager(2048);
+    auto result = trace_replay.run(manager);
+    EXPECT_EQ(result.hits, 0u);
+    EXPECT_EQ(result.misses, 1u);
+
+    auto unfragmented_result = trace_replay.run_unfragmented(2048);
+    EXPECT_EQ(unfragmented_result.hits, 1u);
+    EXPECT_EQ(unfragmented_result.misses, 0u);
+    EXPECT_EQ(unfragmented_result.frees, 1u);
+
+    // a buffer larger than the pool flushes the reference the way it flushes the pool
+    std::vector<lrumm::LRUTraceRecord> oversized = {
+        lrumm::LRUTraceRecord::make(LRUTraceOp::Alloc, 1, 400, 0),
+        lrumm::LRUTraceRecord::make(LRUTraceOp::Alloc, 2, 4096, 0),
+        lrumm::LRUTraceRecord::make(LRUTraceOp::Refresh, 1, 400, 0),
+    };
+    auto oversized_result = lrumm::LRUTraceReplay(oversized).run_unfragmented(2048);
+    EXPECT_EQ(oversized_result.failed_allocs, 1u);
+    EXPECT_EQ(oversized_result.misses, 1u);
+}
+
+TEST(LRUTraceReplayTest, Policies)
+{
+    lrumm::LRUMemoryManager manager(2048);
+    for (const char* policy : lrumm::replay_policy_names()) {
+        EXPECT_TRUE(lrumm::apply_replay_policy(manager, policy)) << policy;
+    }
+    EXPECT_FALSE(lrumm::apply_replay_policy(manager, "random"));
+}
+
+TEST(LRUTraceReplayTest, ParseSizeArgument)
+{
+    size_t size = 0;
+    EXPECT_TRUE(lrumm::parse_size_argument("4096", size));
+    EXPECT_EQ(size, 4096u);
+    EXPECT_TRUE(lrumm::parse_size_argument("16M", size));
+    EXPECT_EQ(size, 16u << 20);
+    EXPECT_TRUE(lrumm::parse_size_argument("1g", size));
+    EXPECT_EQ(size, 1u << 30);
+    EXPECT_FALSE(lrumm::parse_size_argument("12x", size));
+    EXPECT_FALSE(lrumm::parse_size_argument("", size));
+}
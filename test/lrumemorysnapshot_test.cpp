@@ -0,0 +1,135 @@
+#include "gtest/gtest.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "lrumemorymanager.h"
+#include "lrumemorysnapshot.h"
+
+namespace {
+
+using Manager = lrumm::LRUMemoryManager;
+
+std::vector<const Manager::LRUMemoryHandle*> recency_order(Manager& manager)
+{
+    std::vector<const Manager::LRUMemoryHandle*> order;
+    for (auto it = manager.begin(); it != manager.end(); ++it) {
+        order.push_back(&*it);
+    }
+    return order;
+}
+
+}
+
+TEST(LRUSnapshotTest, RestoreRebindsByKeyInRecencyOrder)
+{
+    const std::string path = testing::TempDir() + "lrumm_snapshot_test.bin";
+
+    Manager::LRUMemoryHandle handles[4];
+    Manager manager(4096);
+    for (int i = 0; i < 4; ++i) {
+        std::memset(manager.alloc(&handles[i], 100 + i * 100), 'a' + i, 100 + i * 100);
+    }
+    manager.get_buffer_and_refresh(&handles[1]);
+    manager.free(&handles[2]);
+
+    auto key_of = [&handles](const Manager::LRUMemoryHandle& handle) { return static_cast<uint64_t>(&handle - handles); };
+    ASSERT_TRUE(manager.snapshot(path.c_str(), key_of));
+
+    // a fresh manager with new handles, key 3 is not bound
+    Manager::LRUMemoryHandle restored[4];
+    Manager restored_manager(4096);
+    ASSERT_TRUE(restored_manager.restore(path.c_str(), [&restored](uint64_t key, size_t) {
+        return key == 3 ? nullptr : &restored[key];
+    }));
+
+    EXPECT_EQ(restored[2].hunk_ptr(), nullptr);
+    EXPECT_EQ(restored[3].hunk_ptr(), nullptr);
+    for (int i : {0, 1}) {
+        auto* buffer_ptr = static_cast<const char*>(restored_manager.get_buffer_and_refresh(&restored[i]));
+        ASSERT_NE(buffer_ptr, nullptr);
+        EXPECT_EQ(restored[i].size(), handles[i].size());
+        EXPECT_EQ(buffer_ptr[0], 'a' + i);
+        EXPECT_EQ(buffer_ptr[99 + i * 100], 'a' + i);
+    }
+
+    // restore once more with every key, the order matches the snapshot
+    restored_manager.flush();
+    ASSERT_TRUE(restored_manager.restore(path.c_str(), [&restored](uint64_t key, size_t) { return &restored[key]; }));
+    std::vector<const Manager::LRUMemoryHandle*> expected_order;
+    for (const auto* handle_ptr : recency_order(manager)) {
+        expected_order.push_back(&restored[handle_ptr - handles]);
+    }
+    EXPECT_EQ(recency_order(restored_manager), expected_order);
+
+    restored_manager.flush();
+    manager.flush();
+    std::remove(path.c_str());
+}
+
+TEST(LRUSnapshotTest, SmallerPoolKeepsTheMostRecent)
+{
+    const std::string path = testing::TempDir() + "lrumm_snapshot_small_test.bin";
+
+    // more hunks than a vectored write takes at once
+    std::vector<Manager::LRUMemoryHandle> handles(1500);
+    Manager manager(1500 * Manager::get_hunk_footprint(16) + Manager::get_hunk_footprint(0));
+    for (size_t i = 0; i < handles.size(); ++i) {
+        std::memcpy(manager.alloc(&handles[i], 16), &i, sizeof(i));
+    }
+    ASSERT_TRUE(manager.snapshot(path.c_str(), [&handles](const Manager::LRUMemoryHandle& handle) {
+        return static_cast<uint64_t>(&handle - handles.data());
+    }));
+
+    // room for the last 100 only
+    std::vector<Manager::LRUMemoryHandle> restored(handles.size());
+    Manager restored_manager(100 * Manager::get_hunk_footprint(16) + Manager::get_hunk_footprint(0));
+    ASSERT_TRUE(restored_manager.restore(path.c_str(), [&restored](uint64_t key, size_t size) {
+        EXPECT_EQ(size, 16u);
+        return &restored[key];
+    }));
+    EXPECT_EQ(restored[1399].hunk_ptr(), nullptr);
+    for (size_t i = 1400; i < restored.size(); ++i) {
+        auto* buffer_ptr = restored_manager.get_buffer_and_refresh(&restored[i]);
+        ASSERT_NE(buffer_ptr, nullptr);
+        size_t value;
+        std::memcpy(&value, buffer_ptr, sizeof(value));
+        EXPECT_EQ(value, i);
+    }
+
+    restored_manager.flush();
+    manager.flush();
+    std::remove(path.c_str());
+}
+
+TEST(LRUSnapshotTest, RejectsMalformedFile)
+{
+    const std::string path = testing::TempDir() + "lrumm_snapshot_bad_test.bin";
+    Manager manager(2048);
+    Manager::LRUMemoryHandle handle;
+    manager.alloc(&handle, 100);
+    ASSERT_TRUE(manager.snapshot(path.c_str(), [](const Manager::LRUMemoryHandle&) { return uint64_t(7); }));
+
+    // a truncated payload fails before any hunk is allocated
+    std::FILE* file_ptr = std::fopen(path.c_str(), "rb");
+    ASSERT_NE(file_ptr, nullptr);
+    std::vector<char> content(4096);
+    size_t file_size = std::fread(content.data(), 1, content.size(), file_ptr);
+    std::fclose(file_ptr);
+    EXPECT_EQ(file_size, sizeof(lrumm::LRUSnapshotHeader) + sizeof(lrumm::LRUSnapshotRecord) + handle.size());
+
+    file_ptr = std::fopen(path.c_str(), "wb");
+    std::fwrite(content.data(), 1, file_size - 1, file_ptr);
+    std::fclose(file_ptr);
+
+    Manager restored_manager(2048);
+    bool is_bound = false;
+    EXPECT_FALSE(restored_manager.restore(path.c_str(), [&](uint64_t, size_t) { is_bound = true; return nullptr; }));
+    EXPECT_FALSE(is_bound);
+    EXPECT_FALSE(restored_manager.restore("/nonexistent-directory/snapshot.bin", nullptr));
+
+    manager.free(&handle);
+    std::remove(path.c_str());
+}
@@ -0,0 +1,270 @@
+#include "gtest/gtest.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "lrumemorymanager.h"
+#include "lrumemorytier.h"
+
+namespace {
+
+void fill_pattern(void* buffer_ptr, size_t size, uint8_t seed)
+{
+    auto* bytes = static_cast<uint8_t*>(buffer_ptr);
+    for (size_t i = 0; i < size; ++i) {
+        bytes[i] = static_cast<uint8_t>(seed + i * 7);
+    }
+}
+
+bool has_pattern(const void* buffer_ptr, size_t size, uint8_t seed)
+{
+    std::vector<uint8_t> expected(size);
+    fill_pattern(expected.data(), size, seed);
+    return std::memcmp(buffer_ptr, expected.data(), size) == 0;
+}
+
+}
+
+TEST(LRUMemoryTierTest, SpillAndReload)
+{
+    using Manager = lrumm::LRUMemoryManager;
+    const std::string path = testing::TempDir() + "lrumm_tier_test.spill";
+
+    lrumm::LRUFileTier tier(path.c_str());
+    ASSERT_TRUE(tier.is_open());
+    Manager manager(2048);
+    manager.set_tier(&tier);
+
+    // two 900 byte buffers fit the pool, the third evicts the first into the tier
+    Manager::LRUMemoryHandle handles[3];
+    for (int i = 0; i < 3; ++i) {
+        fill_pattern(manager.alloc(&handles[i], 900), 900, static_cast<uint8_t>(i));
+    }
+    EXPECT_EQ(handles[0].hunk_ptr(), nullptr);
+    EXPECT_TRUE(handles[0].is_spilled());
+    EXPECT_EQ(tier.stored_count(), 1u);
+
+    // the refresh loads it back, spilling the least recent of the others
+    void* buffer_ptr = manager.get_buffer_and_refresh(&handles[0]);
+    ASSERT_NE(buffer_ptr, nullptr);
+    EXPECT_FALSE(handles[0].is_spilled());
+    EXPECT_TRUE(has_pattern(buffer_ptr, 900, 0));
+    EXPECT_TRUE(handles[1].is_spilled());
+    EXPECT_EQ(tier.stored_count(), 1u);
+
+#if LRUMM_ENABLE_STATS
+    auto stats = manager.get_stats();
+    EXPECT_EQ(stats.tier_stores, 2u);
+    EXPECT_EQ(stats.tier_loads, 1u);
+    EXPECT_EQ(stats.misses, 1u);
+#endif
+
+    // freeing a spilled handle drops its payload
+    manager.free(&handles[1]);
+    EXPECT_FALSE(handles[1].is_spilled());
+    EXPECT_EQ(tier.stored_count(), 0u);
+    EXPECT_EQ(tier.log_size(), 0u);
+
+    manager.free(&handles[0]);
+    manager.free(&handles[2]);
+    std::remove(path.c_str());
+}
+
+TEST(LRUMemoryTierTest, SharedHunkSpillsOnce)
+{
+    using Manager = lrumm::LRUMemoryManager;
+    const std::string path = testing::TempDir() + "lrumm_tier_shared_test.spill";
+
+    lrumm::LRUFileTier tier(path.c_str());
+    ASSERT_TRUE(tier.is_open());
+    Manager manager(2048);
+    manager.set_tier(&tier);
+    manager.set_dedup_enabled(true);
+
+    Manager::LRUMemoryHandle owner, sharers[2], others[2];
+    fill_pattern(manager.alloc(&owner, 900), 900, 5);
+    manager.seal(&owner);
+    for (auto& sharer : sharers) {
+        fill_pattern(manager.alloc(&sharer, 900), 900, 5);
+        ASSERT_TRUE(manager.seal(&sharer));
+    }
+
+    // the shared hunk is the least recent one when the second buffer needs room
+    for (int i = 0; i < 2; ++i) {
+        fill_pattern(manager.alloc(&others[i], 900), 900, static_cast<uint8_t>(i));
+    }
+    for (auto* handle_ptr : { &owner, &sharers[0], &sharers[1] }) {
+        EXPECT_TRUE(handle_ptr->is_spilled());
+    }
+    EXPECT_EQ(tier.stored_count(), 1u) << "One copy for all the references.";
+
+    // a freed reference leaves the copy to the others, the first reload brings them all back
+    manager.free(&sharers[1]);
+    EXPECT_EQ(tier.stored_count(), 1u);
+    void* buffer_ptr = manager.get_buffer_and_refresh(&sharers[0]);
+    ASSERT_NE(buffer_ptr, nullptr);
+    EXPECT_TRUE(has_pattern(buffer_ptr, 900, 5));
+    EXPECT_TRUE(others[0].is_spilled());
+    EXPECT_EQ(tier.stored_count(), 1u) << "Only the buffer the reload evicted.";
+    EXPECT_TRUE(owner.is_shared());
+    EXPECT_EQ(owner.hunk_ptr(), sharers[0].hunk_ptr());
+    EXPECT_EQ(manager.get_buffer_and_refresh(&owner), buffer_ptr);
+
+    // and they are sealed again
+    Manager::LRUMemoryHandle late;
+    manager.free(&others[0]);
+    manager.free(&others[1]);
+    fill_pattern(manager.alloc(&late, 900), 900, 5);
+    EXPECT_TRUE(manager.seal(&late));
+    EXPECT_EQ(late.hunk_ptr(), owner.hunk_ptr());
+
+    manager.free(&owner);
+    manager.free(&sharers[0]);
+    manager.free(&late);
+    std::remove(path.c_str());
+}
+
+TEST(LRUMemoryTierTest, FileTierReusesReleasedExtents)
+{
+    const std::string path = testing::TempDir() + "lrumm_tier_reuse_test.spill";
+    lrumm::LRUFileTier tier(path.c_str(), 4096, 512);
+    ASSERT_TRUE(tier.is_open());
+
+    std::vector<uint8_t> payload(1000);
+    fill_pattern(payload.data(), payload.size(), 3);
+
+    uint64_t first = tier.store(payload.data(), 1000);
+    uint64_t second = tier.store(payload.data(), 1000);
+    uint64_t third = tier.store(payload.data(), 1000);
+    ASSERT_NE(third, lrumm::LRUMemoryTier::NO_LOCATOR);
+    EXPECT_EQ(tier.log_size(), 3 * 1024u);
+
+    // full: the log would pass the capacity
+    EXPECT_EQ(tier.store(payload.data(), 1500), lrumm::LRUMemoryTier::NO_LOCATOR);
+
+    // the released first extent takes a smaller payload, the log does not grow
+    tier.release(first);
+    uint64_t small = tier.store(payload.data(), 500);
+    ASSERT_NE(small, lrumm::LRUMemoryTier::NO_LOCATOR);
+    EXPECT_EQ(tier.log_size(), 3 * 1024u);
+    EXPECT_EQ(tier.stored_size(small), 500u);
+
+    std::vector<uint8_t> buffer(1000);
+    EXPECT_TRUE(tier.load(second, buffer.data(), 1000));
+    EXPECT_TRUE(has_pattern(buffer.data(), 1000, 3));
+
+    // releasing the tail extents shortens the log
+    tier.release(third);
+    EXPECT_EQ(tier.log_size(), 512u);
+    tier.release(small);
+    EXPECT_EQ(tier.log_size(), 0u);
+    EXPECT_EQ(tier.stored_bytes(), 0u);
+    std::remove(path.c_str());
+}
+
+TEST(LRUMemoryTierTest, AnonymousFileInDirectory)
+{
+    lrumm::LRUFileTier tier(testing::TempDir().c_str());
+    ASSERT_TRUE(tier.is_open());
+
+    char payload[64] = "spilled";
+    uint64_t locator = tier.store(payload, sizeof(payload));
+    char buffer[64] = {};
+    EXPECT_TRUE(tier.load(locator, buffer, sizeof(buffer)));
+    EXPECT_STREQ(buffer, "spilled");
+
+    lrumm::LRUFileTier missing_tier("/nonexistent-directory/tier.spill");
+    EXPECT_FALSE(missing_tier.is_open());
+    EXPECT_EQ(missing_tier.store(payload, sizeof(payload)), lrumm::LRUMemoryTier::NO_LOCATOR);
+}
+
+TEST(LRUMemoryTierTest, CompressedTier)
+{
+    using Manager = lrumm::LRUMemoryManager;
+    const std::string path = testing::TempDir() + "lrumm_tier_compressed_test.spill";
+
+    lrumm::LRUFileTier file_tier(path.c_str());
+    lrumm::LRUCompressedTier tier(4096, &file_tier);
+    Manager manager(2048);
+    manager.set_tier(&tier);
+
+    // a repetitive buffer is compressed, a random one goes to the backing file
+    Manager::LRUMemoryHandle compressible, incompressible, filler;
+    std::memset(manager.alloc(&compressible, 900), 'z', 900);
+    auto* random_ptr = static_cast<uint8_t*>(manager.alloc(&incompressible, 900));
+    uint32_t state = 1;
+    for (size_t i = 0; i < 900; ++i) {
+        state = state * 1103515245u + 12345u;
+        random_ptr[i] = static_cast<uint8_t>(state >> 16);
+    }
+    std::vector<uint8_t> random_payload(random_ptr, random_ptr + 900);
+
+    std::memset(manager.alloc(&filler, 1900), 'f', 1900);
+    EXPECT_TRUE(compressible.is_spilled());
+    EXPECT_TRUE(incompressible.is_spilled());
+    EXPECT_EQ(tier.stored_count(), 1u);
+    EXPECT_LT(tier.compressed_bytes(), 100u);
+    EXPECT_EQ(file_tier.stored_count(), 1u);
+
+    auto* buffer_ptr = static_cast<uint8_t*>(manager.get_buffer_and_refresh(&compressible));
+    ASSERT_NE(buffer_ptr, nullptr);
+    EXPECT_EQ(buffer_ptr[0], 'z');
+    EXPECT_EQ(buffer_ptr[899], 'z');
+    EXPECT_TRUE(filler.is_spilled());
+    EXPECT_EQ(tier.stored_count(), 1u) << "Only the filler is left in the region.";
+
+    buffer_ptr = static_cast<uint8_t*>(manager.get_buffer_and_refresh(&incompressible));
+    ASSERT_NE(buffer_ptr, nullptr);
+    EXPECT_EQ(std::memcmp(buffer_ptr, random_payload.data(), 900), 0);
+    EXPECT_EQ(file_tier.stored_count(), 0u);
+
+    manager.free(&filler);
+    EXPECT_EQ(tier.region_used(), 0u);
+    manager.set_tier(nullptr);
+    std::remove(path.c_str());
+}
+
+TEST(LRUMemoryTierTest, CompressedTierWritesBackOldest)
+{
+    const std::string path = testing::TempDir() + "lrumm_tier_writeback_test.spill";
+
+    lrumm::LRUFileTier file_tier(path.c_str());
+    lrumm::LRUCompressedTier tier(1024, &file_tier);
+
+    // a 64 byte pattern repeated 16 times compresses to a small part of the region
+    auto make_payload = [](uint8_t seed) {
+        std::vector<uint8_t> payload(1024);
+        for (size_t offset = 0; offset < payload.size(); offset += 64) {
+            fill_pattern(payload.data() + offset, 64, seed);
+        }
+        return payload;
+    };
+    std::vector<uint64_t> locators;
+    for (uint8_t seed = 0; seed < 20; ++seed) {
+        locators.push_back(tier.store(make_payload(seed).data(), 1024));
+        ASSERT_NE(locators.back(), lrumm::LRUMemoryTier::NO_LOCATOR);
+    }
+    size_t written_back = file_tier.stored_count();
+    ASSERT_GT(written_back, 0u);
+    EXPECT_EQ(tier.stored_count() + written_back, 20u);
+    EXPECT_LE(tier.region_used(), 1024u);
+
+    // the newest payloads are still in the region, the oldest come from the file
+    std::vector<uint8_t> buffer(1024);
+    EXPECT_TRUE(tier.load(locators[19], buffer.data(), buffer.size()));
+    EXPECT_EQ(buffer, make_payload(19));
+    EXPECT_EQ(file_tier.stored_count(), written_back);
+    EXPECT_TRUE(tier.load(locators[0], buffer.data(), buffer.size()));
+    EXPECT_EQ(buffer, make_payload(0));
+    EXPECT_EQ(file_tier.stored_count(), written_back - 1);
+
+    for (size_t i = 1; i < 19; ++i) {
+        tier.release(locators[i]);
+    }
+    EXPECT_EQ(file_tier.stored_count(), 0u);
+    EXPECT_EQ(tier.stored_count(), 0u);
+    EXPECT_EQ(tier.region_used(), 0u);
+    std::remove(path.c_str());
+}
@@ -0,0 +1,133 @@
+#include "gtest/gtest.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "lrumemorymanager.h"
+#include "lrumemorytrace.h"
+
+namespace {
+
+std::vector<lrumm::LRUTraceRecord> read_records(const std::string& path, lrumm::LRUTraceFileHeader& header)
+{
+    std::vector<lrumm::LRUTraceRecord> records;
+    std::FILE* file_ptr = std::fopen(path.c_str(), "rb");
+    if (!file_ptr) {
+        return records;
+    }
+    if (std::fread(&header, sizeof(header), 1, file_ptr) == 1) {
+        lrumm::LRUTraceRecord record;
+        while (std::fread(&record, sizeof(record), 1, file_ptr) == 1) {
+            records.push_back(record);
+        }
+    }
+    std::fclose(file_ptr);
+    return records;
+}
+
+}
+
+TEST(LRUTraceRecorderTest, RecordEncoding)
+{
+    auto record = lrumm::LRUTraceRecord::make(lrumm::LRUTraceOp::Evict, 42, 100, 1234);
+    EXPECT_EQ(record.op(), lrumm::LRUTraceOp::Evict);
+    EXPECT_EQ(record.handle_id, 42u);
+    EXPECT_EQ(record.size, 100u);
+    EXPECT_EQ(record.delta_ns(), 1234u);
+
+    auto saturated = lrumm::LRUTraceRecord::make(lrumm::LRUTraceOp::Alloc, 1, 1ull << 40, 1ull << 40);
+    EXPECT_EQ(saturated.op(), lrumm::LRUTraceOp::Alloc);
+    EXPECT_EQ(saturated.size, UINT32_MAX);
+    EXPECT_EQ(saturated.delta_ns(), lrumm::LRUTraceRecord::MAX_DELTA_NS);
+}
+
+TEST(LRUTraceRecorderTest, RecordsManagerOperations)
+{
+    const std::string path = testing::TempDir() + "lrumm_trace_test.bin";
+    lrumm::LRUMemoryManager::LRUMemoryHandle handle0, handle1, handle2;
+    {
+        lrumm::LRUMemoryManager manager(2048);
+        lrumm::LRUTraceRecorder recorder(path.c_str());
+        ASSERT_TRUE(recorder.is_open());
+        manager.set_trace_recorder(&recorder);
+
+        manager.alloc(&handle0, 900);
+        manager.alloc(&handle1, 900);
+        manager.get_buffer_and_refresh(&handle1);
+        manager.alloc(&handle2, 900); // evicts handle0
+        manager.get_buffer_and_refresh(&handle0);
+        manager.free(&handle2);
+        manager.flush();
+
+        EXPECT_EQ(recorder.recorded_count(), 8u);
+        EXPECT_EQ(recorder.dropped_count(), 0u);
+        manager.set_trace_recorder(nullptr);
+    }
+
+    lrumm::LRUTraceFileHeader header;
+    auto records = read_records(path, header);
+    std::remove(path.c_str());
+
+    EXPECT_EQ(std::memcmp(header.magic, lrumm::LRUTraceFileHeader::MAGIC, sizeof(header.magic)), 0);
+    EXPECT_EQ(header.version, lrumm::LRUTraceFileHeader::VERSION);
+    EXPECT_EQ(header.record_size, sizeof(lrumm::LRUTraceRecord));
+    ASSERT_EQ(records.size(), 8u);
+
+    auto id = [](const void* handle_ptr) { return static_cast<uint64_t>(reinterpret_cast<uintptr_t>(handle_ptr)); };
+    const struct {
+        lrumm::LRUTraceOp op;
+        uint64_t handle_id;
+    } expected[] = {
+        { lrumm::LRUTraceOp::Alloc, id(&handle0) },
+        { lrumm::LRUTraceOp::Alloc, id(&handle1) },
+        { lrumm::LRUTraceOp::Refresh, id(&handle1) },
+        { lrumm::LRUTraceOp::Alloc, id(&handle2) },
+        { lrumm::LRUTraceOp::Evict, id(&handle0) },
+        { lrumm::LRUTraceOp::Refresh, id(&handle0) },
+        { lrumm::LRUTraceOp::Free, id(&handle2) },
+        { lrumm::LRUTraceOp::Free, id(&handle1) },
+    };
+    for (size_t i = 0; i < records.size(); ++i) {
+        EXPECT_EQ(records[i].op(), expected[i].op) << "Record " << i;
+        EXPECT_EQ(records[i].handle_id, expected[i].handle_id) << "Record " << i;
+    }
+    EXPECT_EQ(records[0].size, 900u) << "Alloc records the requested size.";
+    EXPECT_EQ(records[0].delta_ns(), 0u) << "First record has no predecessor.";
+    EXPECT_EQ(records[5].size, 0u) << "Refresh of an evicted handle has no size.";
+}
+
+TEST(LRUTraceRecorderTest, SamplesByHandle)
+{
+    const std::string path = testing::TempDir() + "lrumm_trace_sampled_test.bin";
+    constexpr size_t kHandleCount = 256;
+    {
+        lrumm::LRUMemoryManager manager(64 * 1024);
+        lrumm::LRUTraceRecorder recorder(path.c_str(), 1024, 4);
+        manager.set_trace_recorder(&recorder);
+
+        std::vector<lrumm::LRUMemoryManager::LRUMemoryHandle> handles(kHandleCount);
+        for (auto& handle : handles) {
+            manager.alloc(&handle, 16);
+            manager.free(&handle);
+        }
+
+        // every sampled handle has both of its records
+        EXPECT_GT(recorder.recorded_count(), 0u);
+        EXPECT_LT(recorder.recorded_count(), 2 * kHandleCount);
+        EXPECT_EQ(recorder.recorded_count() % 2, 0u);
+        manager.set_trace_recorder(nullptr);
+    }
+
+    lrumm::LRUTraceFileHeader header;
+    auto records = read_records(path, header);
+    std::remove(path.c_str());
+    EXPECT_EQ(header.sample_rate, 4u);
+}
+
+TEST(LRUTraceRecorderTest, OpenFailure)
+{
+    lrumm::LRUTraceRecorder recorder("/nonexistent-directory/trace.bin");
+    EXPECT_FALSE(recorder.is_open());
+}
@@ -0,0 +1,157 @@
+#include "gtest/gtest.h"
+
+#include <cstring>
+#include <vector>
+
+#include "lrumemorymanager.h"
+#include "lrumemorywriter.h"
+
+namespace {
+
+using Manager = lrumm::LRUMemoryManager;
+
+std::vector<uint8_t> make_stream(size_t size)
+{
+    std::vector<uint8_t> stream(size);
+    for (size_t i = 0; i < size; ++i) {
+        stream[i] = static_cast<uint8_t>(i * 13 + i / 251);
+    }
+    return stream;
+}
+
+std::vector<uint8_t> read_chunks(lrumm::LRUAppendWriter& writer)
+{
+    std::vector<uint8_t> data;
+    for (size_t index = 0; index < writer.chunk_count(); ++index) {
+        auto* chunk_ptr = static_cast<const uint8_t*>(writer.chunk_data(index));
+        data.insert(data.end(), chunk_ptr, chunk_ptr + writer.chunk_size(index));
+    }
+    return data;
+}
+
+}
+
+TEST(LRUAppendWriterTest, GrowsInPlace)
+{
+    Manager manager(16 * 1024);
+    Manager::LRUMemoryHandle handle;
+    const auto stream = make_stream(1000);
+
+    lrumm::LRUAppendWriter writer(manager, &handle, 64);
+    const void* start_ptr = handle.hunk_ptr();
+    for (size_t pos = 0; pos < stream.size(); pos += 100) {
+        ASSERT_TRUE(writer.append(stream.data() + pos, 100));
+    }
+    EXPECT_EQ(writer.chunk_count(), 1u);
+    EXPECT_EQ(handle.hunk_ptr(), start_ptr) << "The hunk never moved.";
+
+    ASSERT_TRUE(writer.finish());
+    EXPECT_EQ(writer.size(), 1000u);
+    EXPECT_EQ(handle.size(), Manager::get_hunk_footprint(1000) - Manager::get_hunk_footprint(0));
+    EXPECT_EQ(manager.get_allocated_memory_size(), Manager::get_hunk_footprint(0) + Manager::get_hunk_footprint(1000));
+    EXPECT_EQ(std::memcmp(manager.get_buffer_and_refresh(&handle), stream.data(), stream.size()), 0);
+    manager.free(&handle);
+}
+
+TEST(LRUAppendWriterTest, ChainsBehindAnotherHunk)
+{
+    Manager manager(16 * 1024);
+    Manager::LRUMemoryHandle handle, blocker;
+    const auto stream = make_stream(3000);
+
+    lrumm::LRUAppendWriter writer(manager, &handle, 256);
+    manager.alloc(&blocker, 100); // right after the first chunk
+
+    // a decoder writing in place
+    size_t pos = 0;
+    while (pos < stream.size()) {
+        size_t available;
+        auto* output_ptr = static_cast<uint8_t*>(writer.prepare(200, available));
+        ASSERT_NE(output_ptr, nullptr);
+        ASSERT_GE(available, 200u);
+        size_t size = std::min<size_t>(200, stream.size() - pos);
+        std::memcpy(output_ptr, stream.data() + pos, size);
+        writer.commit(size);
+        pos += size;
+    }
+    EXPECT_EQ(writer.chunk_count(), 2u) << "The second chunk grew in place at the end of the pool.";
+
+    ASSERT_TRUE(writer.finish(false));
+    EXPECT_EQ(writer.chunk_count(), 2u);
+    EXPECT_EQ(read_chunks(writer), stream);
+    EXPECT_EQ(writer.chunk_size(0), 200u) << "The room left was too small for the next write.";
+}
+
+TEST(LRUAppendWriterTest, FinishCompacts)
+{
+    Manager manager(16 * 1024);
+    Manager::LRUMemoryHandle handle, blocker;
+    const auto stream = make_stream(3000);
+
+    lrumm::LRUAppendWriter writer(manager, &handle, 256);
+    manager.alloc(&blocker, 100);
+    ASSERT_TRUE(writer.append(stream.data(), 1000));
+    ASSERT_TRUE(writer.append(stream.data() + 1000, 2000));
+    EXPECT_GT(writer.chunk_count(), 1u);
+
+    ASSERT_TRUE(writer.finish());
+    EXPECT_EQ(writer.chunk_count(), 1u);
+    EXPECT_EQ(handle.size(), Manager::get_hunk_footprint(3000) - Manager::get_hunk_footprint(0));
+    EXPECT_EQ(std::memcmp(manager.get_buffer_and_refresh(&handle), stream.data(), stream.size()), 0);
+    EXPECT_EQ(manager.get_allocated_memory_size(),
+        Manager::get_hunk_footprint(0) + Manager::get_hunk_footprint(100) + Manager::get_hunk_footprint(3000));
+    manager.free(&handle);
+    manager.free(&blocker);
+}
+
+TEST(LRUAppendWriterTest, FinishKeepsChainWithoutGap)
+{
+    Manager manager(8192);
+    Manager::LRUMemoryHandle handle, blocker, other;
+    const auto stream = make_stream(3000);
+
+    lrumm::LRUAppendWriter writer(manager, &handle, 256);
+    manager.alloc(&blocker, 100);
+    ASSERT_TRUE(writer.append(stream.data(), 200));
+    ASSERT_TRUE(writer.append(stream.data() + 200, 2800));
+    manager.alloc(&other, 1800); // leaves less free space than the copy takes
+    ASSERT_EQ(writer.chunk_count(), 2u);
+
+    ASSERT_TRUE(writer.finish());
+    EXPECT_EQ(writer.chunk_count(), 2u);
+    EXPECT_EQ(read_chunks(writer), stream);
+    EXPECT_NE(blocker.hunk_ptr(), nullptr) << "Compaction evicted nothing.";
+    EXPECT_NE(other.hunk_ptr(), nullptr);
+}
+
+TEST(LRUAppendWriterTest, ChainedStreamGoesWithWriter)
+{
+    Manager manager(16 * 1024);
+    Manager::LRUMemoryHandle handle, blocker;
+    const auto stream = make_stream(3000);
+    {
+        lrumm::LRUAppendWriter writer(manager, &handle, 256);
+        manager.alloc(&blocker, 100);
+        ASSERT_TRUE(writer.append(stream.data(), stream.size()));
+        ASSERT_TRUE(writer.finish(false));
+        ASSERT_EQ(writer.chunk_count(), 2u);
+    }
+    EXPECT_EQ(handle.hunk_ptr(), nullptr);
+    EXPECT_EQ(manager.get_allocated_memory_size(), Manager::get_hunk_footprint(0) + Manager::get_hunk_footprint(100));
+}
+
+TEST(LRUAppendWriterTest, LostWhenEvicted)
+{
+    Manager manager(2048);
+    Manager::LRUMemoryHandle handle, other;
+    const auto stream = make_stream(500);
+
+    lrumm::LRUAppendWriter writer(manager, &handle, 500);
+    ASSERT_TRUE(writer.append(stream.data(), 500));
+    manager.alloc(&other, 1900); // evicts the stream
+    EXPECT_FALSE(writer.append(stream.data(), 10));
+    EXPECT_TRUE(writer.is_lost());
+    EXPECT_FALSE(writer.finish());
+    EXPECT_EQ(handle.hunk_ptr(), nullptr);
+    manager.free(&other);
+}
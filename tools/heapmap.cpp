@@ -0,0 +1,183 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "lrumemoryheapmap.h"
+#include "lrumemoryreplay.h"
+
+// Renders a heap map snapshot (LRUMemoryManager::write_heap_map) as a text or
+// SVG heat map. The arena is split into equal cells laid out row by row; every
+// cell shows how much of it is allocated and how recently its hunks were used.
+
+namespace {
+
+struct HeapMapOptions {
+    std::string input_path;
+    std::string svg_path;
+    size_t columns = 128;
+    size_t rows = 32;
+};
+
+struct Cell {
+    double used_bytes = 0.0; ///< Allocated bytes in the cell
+    double coldness = 0.0;   ///< Byte weighted recency rank, 0 most recent, 1 least recent
+};
+
+void print_usage(const char* program)
+{
+    std::fprintf(stderr,
+        "Usage: %s --input FILE [--svg FILE] [--columns N] [--rows N]\n"
+        "Prints a text heat map, or writes an SVG one with --svg.\n", program);
+}
+
+bool parse_options(int argc, char** argv, HeapMapOptions& options)
+{
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        size_t number = 0;
+
+        if (std::strcmp(arg, "--input") == 0 && value) {
+            options.input_path = value;
+        } else if (std::strcmp(arg, "--svg") == 0 && value) {
+            options.svg_path = value;
+        } else if (std::strcmp(arg, "--columns") == 0 && value && lrumm::parse_size_argument(value, number)) {
+            options.columns = number;
+        } else if (std::strcmp(arg, "--rows") == 0 && value && lrumm::parse_size_argument(value, number)) {
+            options.rows = number;
+        } else {
+            return false;
+        }
+        ++i;
+    }
+    return !options.input_path.empty();
+}
+
+std::vector<Cell> build_cells(const lrumm::LRUHeapMap& heap_map, size_t cell_count, double& cell_bytes)
+{
+    std::vector<Cell> cells(cell_count);
+    cell_bytes = static_cast<double>(heap_map.pool_size) / static_cast<double>(cell_count);
+    double rank_scale = heap_map.hunks.size() > 1 ? 1.0 / static_cast<double>(heap_map.hunks.size() - 1) : 0.0;
+
+    for (size_t rank = 0; rank < heap_map.hunks.size(); ++rank) {
+        const auto& hunk = heap_map.hunks[rank];
+        double coldness = static_cast<double>(rank) * rank_scale;
+        double start = static_cast<double>(hunk.offset);
+        double end = start + static_cast<double>(hunk.size);
+
+        // Spread the hunk over the cells it covers
+        size_t cell = static_cast<size_t>(start / cell_bytes);
+        while (cell < cell_count && start < end) {
+            double cell_end = static_cast<double>(cell + 1) * cell_bytes;
+            double covered = std::min(end, cell_end) - start;
+            cells[cell].used_bytes += covered;
+            cells[cell].coldness += covered * coldness;
+            start = cell_end;
+            cell++;
+        }
+    }
+
+    for (auto& cell : cells) {
+        if (cell.used_bytes > 0.0) {
+            cell.coldness /= cell.used_bytes;
+        }
+    }
+    return cells;
+}
+
+void print_summary(const lrumm::LRUHeapMap& heap_map)
+{
+    uint64_t free_bytes = 0;
+    uint64_t largest_gap = 0;
+    for (const auto& gap : heap_map.gaps) {
+        free_bytes += gap.size;
+        largest_gap = std::max(largest_gap, gap.size);
+    }
+    double fragmentation = free_bytes ? 1.0 - static_cast<double>(largest_gap) / static_cast<double>(free_bytes) : 0.0;
+
+    std::printf("pool %llu bytes, allocated %llu, %zu hunks, %zu gaps\n",
+        static_cast<unsigned long long>(heap_map.pool_size), static_cast<unsigned long long>(heap_map.allocated_size),
+        heap_map.hunks.size(), heap_map.gaps.size());
+    std::printf("free %llu bytes, largest gap %llu, external fragmentation %.4f\n",
+        static_cast<unsigned long long>(free_bytes), static_cast<unsigned long long>(largest_gap), fragmentation);
+}
+
+void print_text(const std::vector<Cell>& cells, double cell_bytes, size_t columns)
+{
+    // Hot to cold; cells that are mostly free print as '.'
+    static const char SHADES[] = "#*+-:";
+    constexpr size_t SHADE_COUNT = sizeof(SHADES) - 1;
+
+    std::printf("%.0f bytes per cell; '#' most recent .. ':' least recent, '.' mostly free\n", cell_bytes);
+    for (size_t index = 0; index < cells.size(); ++index) {
+        const Cell& cell = cells[index];
+        char shade = '.';
+        if (cell.used_bytes * 2 >= cell_bytes) {
+            shade = SHADES[std::min(SHADE_COUNT - 1, static_cast<size_t>(cell.coldness * SHADE_COUNT))];
+        }
+        std::putchar(shade);
+        if ((index + 1) % columns == 0) {
+            std::putchar('\n');
+        }
+    }
+}
+
+bool write_svg(const char* path, const std::vector<Cell>& cells, double cell_bytes, size_t columns)
+{
+    constexpr int CELL_PIXELS = 8;
+
+    std::FILE* file_ptr = std::fopen(path, "w");
+    if (!file_ptr) {
+        std::fprintf(stderr, "Failed to open %s.\n", path);
+        return false;
+    }
+
+    size_t rows = (cells.size() + columns - 1) / columns;
+    std::fprintf(file_ptr, "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"%zu\" height=\"%zu\" shape-rendering=\"crispEdges\">\n",
+        columns * CELL_PIXELS, rows * CELL_PIXELS);
+    for (size_t index = 0; index < cells.size(); ++index) {
+        const Cell& cell = cells[index];
+
+        // Red for recent, blue for old hunks, faded towards white by the free share of the cell
+        double occupancy = std::min(1.0, cell.used_bytes / cell_bytes);
+        double red = 220.0 - 180.0 * cell.coldness;
+        double green = 40.0 + 40.0 * cell.coldness;
+        double blue = 40.0 + 180.0 * cell.coldness;
+        auto fade = [occupancy](double channel) { return static_cast<int>(255.0 - (255.0 - channel) * occupancy); };
+
+        std::fprintf(file_ptr, "<rect x=\"%zu\" y=\"%zu\" width=\"%d\" height=\"%d\" fill=\"rgb(%d,%d,%d)\"/>\n",
+            (index % columns) * CELL_PIXELS, (index / columns) * CELL_PIXELS, CELL_PIXELS, CELL_PIXELS,
+            fade(red), fade(green), fade(blue));
+    }
+    std::fprintf(file_ptr, "</svg>\n");
+
+    return std::fclose(file_ptr) == 0;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    HeapMapOptions options;
+    if (!parse_options(argc, argv, options) || options.columns == 0 || options.rows == 0) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    lrumm::LRUHeapMap heap_map;
+    if (!lrumm::read_heap_map(options.input_path.c_str(), heap_map)) {
+        return 1;
+    }
+
+    double cell_bytes = 0.0;
+    auto cells = build_cells(heap_map, options.columns * options.rows, cell_bytes);
+
+    print_summary(heap_map);
+    if (!options.svg_path.empty()) {
+        return write_svg(options.svg_path.c_str(), cells, cell_bytes, options.columns) ? 0 : 1;
+    }
+    print_text(cells, cell_bytes, options.columns);
+    return 0;
+}
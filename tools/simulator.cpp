@@ -0,0 +1,178 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "lrumemorymanager.h"
+#include "lrumemoryreplay.h"
+#include "lrumemorytrace.h"
+
+// Offline hit ratio simulator: replays one trace through the real placement
+// engine under every requested policy and pool size, in parallel, and puts the
+// result next to a byte-budget LRU that never fragments. The gap between the two
+// is the cost of fragmentation that a key-only simulator cannot see.
+
+namespace {
+
+struct SimulatorOptions {
+    std::string trace_path;
+    std::vector<size_t> pool_sizes;
+    std::vector<const char*> policies;
+    unsigned thread_count = 0;
+    uint64_t fragmentation_interval = 4096;
+};
+
+struct Configuration {
+    size_t pool_size;
+    const char* policy; ///< nullptr for the unfragmented reference
+    lrumm::LRUReplayResult result;
+    lrumm::LRUMemoryStats stats;
+    double peak_fragmentation = 0.0;
+    bool is_valid = true;
+};
+
+void print_usage(const char* program)
+{
+    std::fprintf(stderr,
+        "Usage: %s --trace FILE [--pool-size SIZE]... [--policy NAME]...\n"
+        "          [--threads N] [--fragmentation-interval N]\n"
+        "SIZE accepts K, M and G suffixes (default 16M); all policies run by default:", program);
+    for (const char* policy : lrumm::replay_policy_names()) {
+        std::fprintf(stderr, " %s", policy);
+    }
+    std::fprintf(stderr, "\n");
+}
+
+bool parse_options(int argc, char** argv, SimulatorOptions& options)
+{
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        size_t number = 0;
+
+        if (std::strcmp(arg, "--trace") == 0 && value) {
+            options.trace_path = value;
+        } else if (std::strcmp(arg, "--pool-size") == 0 && value && lrumm::parse_size_argument(value, number)) {
+            options.pool_sizes.push_back(number);
+        } else if (std::strcmp(arg, "--policy") == 0 && value) {
+            options.policies.push_back(value);
+        } else if (std::strcmp(arg, "--threads") == 0 && value && lrumm::parse_size_argument(value, number)) {
+            options.thread_count = static_cast<unsigned>(number);
+        } else if (std::strcmp(arg, "--fragmentation-interval") == 0 && value && lrumm::parse_size_argument(value, number)) {
+            options.fragmentation_interval = number;
+        } else {
+            return false;
+        }
+        ++i;
+    }
+
+    if (options.pool_sizes.empty()) {
+        options.pool_sizes.push_back(16 * 1024 * 1024);
+    }
+    if (options.policies.empty()) {
+        options.policies = lrumm::replay_policy_names();
+    }
+    return !options.trace_path.empty();
+}
+
+void simulate(const lrumm::LRUTraceReplay& trace_replay, Configuration& configuration, uint64_t fragmentation_interval)
+{
+    if (!configuration.policy) {
+        configuration.result = trace_replay.run_unfragmented(configuration.pool_size);
+        return;
+    }
+
+    lrumm::LRUMemoryManager manager(configuration.pool_size);
+    if (!lrumm::apply_replay_policy(manager, configuration.policy)) {
+        configuration.is_valid = false;
+        return;
+    }
+
+    double& peak_fragmentation = configuration.peak_fragmentation;
+    auto observe_fragmentation = [&peak_fragmentation](const lrumm::LRUMemoryManager& observed, uint64_t) {
+        peak_fragmentation = std::max(peak_fragmentation, observed.get_stats().external_fragmentation());
+    };
+    configuration.result = trace_replay.run(manager, fragmentation_interval, observe_fragmentation);
+    configuration.stats = manager.get_stats();
+}
+
+void print_results(const std::vector<Configuration>& configurations)
+{
+    std::printf("%-12s %-14s %9s %9s %10s %10s %10s %8s %9s\n", "pool", "policy", "hit", "byte_hit", "evictions",
+        "frag_evict", "cap_evict", "failed", "peak_frag");
+
+    for (const Configuration& configuration : configurations) {
+        if (!configuration.is_valid) {
+            std::printf("%-12zu %-14s unknown policy\n", configuration.pool_size, configuration.policy);
+            continue;
+        }
+        const auto& result = configuration.result;
+        if (!configuration.policy) {
+            std::printf("%-12zu %-14s %9.4f %9.4f %10s %10s %10s %8llu %9s\n", configuration.pool_size, "unfragmented",
+                result.hit_ratio(), result.byte_hit_ratio(), "-", "-", "-",
+                static_cast<unsigned long long>(result.failed_allocs), "-");
+            continue;
+        }
+        const auto& stats = configuration.stats;
+        std::printf("%-12zu %-14s %9.4f %9.4f %10llu %10llu %10llu %8llu %9.4f\n", configuration.pool_size,
+            configuration.policy, result.hit_ratio(), result.byte_hit_ratio(),
+            static_cast<unsigned long long>(stats.evictions),
+            static_cast<unsigned long long>(stats.evictions_fragmentation),
+            static_cast<unsigned long long>(stats.evictions_capacity),
+            static_cast<unsigned long long>(result.failed_allocs), configuration.peak_fragmentation);
+    }
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    SimulatorOptions options;
+    if (!parse_options(argc, argv, options)) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    std::vector<lrumm::LRUTraceRecord> records;
+    if (!lrumm::read_trace(options.trace_path.c_str(), records)) {
+        return 1;
+    }
+
+    lrumm::LRUTraceReplay trace_replay(records);
+    std::printf("trace %s: %zu steps, %zu handles\n", options.trace_path.c_str(), trace_replay.step_count(),
+        trace_replay.slot_count());
+
+    std::vector<Configuration> configurations;
+    for (size_t pool_size : options.pool_sizes) {
+        for (const char* policy : options.policies) {
+            configurations.push_back({ pool_size, policy, {}, {} });
+        }
+        configurations.push_back({ pool_size, nullptr, {}, {} });
+    }
+
+    // Every configuration owns its manager, so they replay independently
+    unsigned thread_count = options.thread_count ? options.thread_count : std::thread::hardware_concurrency();
+    thread_count = std::max(1u, std::min<unsigned>(thread_count, static_cast<unsigned>(configurations.size())));
+
+    std::atomic<size_t> next_configuration { 0 };
+    auto worker = [&]() {
+        for (size_t index = next_configuration++; index < configurations.size(); index = next_configuration++) {
+            simulate(trace_replay, configurations[index], options.fragmentation_interval);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned i = 1; i < thread_count; ++i) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    print_results(configurations);
+    return 0;
+}